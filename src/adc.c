@@ -6,12 +6,32 @@
  * This file contains functions that handle data collection from the ADC using
  * interrupts. The ADC will be run at set intervals and generate an interrupt
  * every time it has a new data point. Functions in this file will record the
- * data point and disable further interrupts once the buffer is full. Once the
- * buffer is no longer in use, interrupts can be re-enabled when needed.
+ * data point and disable further interrupts once the buffer is full. There are
+ * several buffers, so that a new recording can be made into one buffer while
+ * the main loop is still working on another. Buffers are handed to the main
+ * loop with 'adc_acquire' and given back with 'adc_release'.
+ *
+ * If built with 'ADC_STREAM', the ADC instead runs all the time, recording
+ * into a ring buffer. Every 'HOP_SIZE' samples, the last 'SAMPLE_SIZE' samples
+ * make up a window that can be analyzed. The external trigger just marks which
+ * of the windows around it are worth looking at; they are handed to the main
+ * loop with 'adc_acquire_window' and are read straight out of the ring.
+ *
+ * If built with 'USE_GOERTZEL', the samples are not stored at all. Instead,
+ * each one is passed to the Goertzel matcher as it comes in, which has the
+ * result ready by the time the recording is done.
+ *
+ * If built with 'USE_PREPROCESS', each sample is run through the front end
+ * (see 'preprocess.h') before it is stored or passed on.
+ *
+ * The registers are set up in the hardware abstraction layer (see 'hal.h'),
+ * which calls 'adc_sample_ready' for each sample and 'adc_trigger' for each
+ * trigger.
  *
  * Peripherals Used:
  *      ADC
  *      External interrupts
+ *      Timer1 (with 'ADC_TIMER')
  *
  * Pins Used:
  *      PF0
@@ -21,35 +41,80 @@
  *      05 Jun 2015     Brian Kubisiak      Initial revision.
  *      06 Jun 2015     Brian Kubisiak      Added external trigger.
  *      08 Jun 2015     Brian Kubisiak      Added pullup resistor to INT0.
+ *      16 Oct 2026     agent               Added Q15 samples.
+ *      16 Oct 2026     agent               Pack real samples two per point.
+ *      16 Oct 2026     agent               Multiple buffers with acquire and
+ *                                          release.
+ *      16 Oct 2026     agent               Added continuous ring buffer mode.
+ *      16 Oct 2026     agent               Feed samples to the Goertzel
+ *                                          matcher.
+ *      16 Oct 2026     agent               Moved the registers to the HAL.
+ *      16 Oct 2026     agent               Post events for the main loop.
+ *      16 Oct 2026     agent               Noted the timer that paces the ADC.
+ *      16 Oct 2026     agent               Run samples through the front end.
+ *      16 Oct 2026     agent               Give out the position of a window,
+ *                                          not its index in the ring.
+ *      16 Oct 2026     agent               Take 16-bit samples.
+ *      16 Oct 2026     agent               Take the bias off the samples.
+ *      16 Oct 2026     agent               Keep all 16 bits through the front
+ *                                          end and in the Q15 ring.
+ *      16 Oct 2026     agent               Added 'adc_idle'.
  */
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
+#include <stddef.h>
 
 #include "adc.h"
+#include "events.h"
+#include "goertzel.h"
+#include "hal.h"
+#include "preprocess.h"
+
+#if defined(ADC_STREAM) && defined(USE_GOERTZEL)
+#error "The Goertzel matcher only works with triggered recordings"
+#endif
+
+#ifdef ADC_STREAM
 
-/* Initial values for the ADC configuration registers. */
-#define ADMUX_VAL   0x60
-#define ADCSRA_VAL  0x8F
-#define ADCSRB_VAL  0x00
-#define DIDR0_VAL   0x01
-#define DIDR2_VAL   0x00
+#if RING_SIZE < SAMPLE_SIZE + HOP_SIZE
+#error "RING_SIZE must leave at least HOP_SIZE samples of slack past a window"
+#endif
 
-/* Initial values for external interrupt configuration. */
-#define EICRA_VAL   0x03
-#define EIMSK_VAL   0x01
+/* The ring of samples, and the total number of samples written to it. Only the
+ * low bits of the count are used to index the ring, so it can wrap. */
+static ring_sample ring[RING_SIZE];
+static volatile unsigned int writepos = 0;
+static unsigned int hopcount = 0;       /* Samples since the last window. */
+static unsigned int primed = 0;         /* Samples in the ring, up to a
+                                         * window. */
+static volatile unsigned char marks = 0; /* Windows left to queue. */
 
-/* Add pullup resistor to interrupt pin. */
-#define PORTD_VAL   0xFF
+/* Queue of windows waiting for the main loop, as their start positions. The
+ * indices run freely and are taken modulo 'NUM_WINDOWS'. */
+static volatile unsigned int winstart[NUM_WINDOWS];
+static unsigned char winhead = 0;       /* Next window to acquire. */
+static volatile unsigned char wintail = 0;  /* Next slot to queue into. */
 
-/* ORing this with ADCSRA will begin the data collection process. */
-#define ADCSTART    0x60
+#else
 
-static complex databuf[SAMPLE_SIZE];
+/* States that each of the buffers can be in. */
+#define BUF_FREE    0       /* Available for recording. */
+#define BUF_FILLING 1       /* Being filled by the ADC. */
+#define BUF_FULL    2       /* Filled and waiting to be acquired. */
+#define BUF_IN_USE  3       /* Acquired by the main loop. */
+
+/* The buffers are filled and acquired in round-robin order. */
+static sample databuf[NUM_BUFFERS][SAMPLE_POINTS];
+static volatile unsigned char bufstate[NUM_BUFFERS];
+static unsigned char fillbuf = 0;       /* Buffer that the ADC fills next. */
+static unsigned char readbuf = 0;       /* Buffer that is acquired next. */
 static unsigned int bufidx = 0;
-static unsigned char buffull = 0;
-static unsigned char collecting = 0;
+static volatile unsigned char collecting = 0;
+
+#endif
+
+static volatile unsigned int overruns = 0;
 
+#ifndef ADC_STREAM
 /*
  * adc_start_collection
  *
@@ -59,24 +124,34 @@ static unsigned char collecting = 0;
  *              buffer is full, the interrupt vector will disable the
  *              autotriggering automatically.
  *
- * Notes:       This function should not be called until the buffer is filled
- *              and data collection halts. This can be checked with the
- *              'is_data_collected' function.
+ * Notes:       This function should only be called while no data is being
+ *              collected, and when the next buffer to fill is free.
  */
 static void adc_start_collection(void)
 {
     /* Reset the index to load values into the start of the buffer. */
     bufidx = 0;
 
-    /* Buffer is no longer full. */
-    buffull = 0;
+#ifdef USE_PREPROCESS
+    /* Start the window over for the new recording. */
+    preprocess_start();
+#endif
+
+#ifdef USE_GOERTZEL
+    /* The samples go straight to the matcher, so no buffer is used. */
+    goertzel_start();
+#else
+    /* The next buffer is now being filled. */
+    bufstate[fillbuf] = BUF_FILLING;
+#endif
 
     /* Set the flag signaling that collection is in progress. */
     collecting = 1;
 
     /* Enable autotriggering and start the first conversion. */
-    ADCSRA |= ADCSTART;
+    hal_adc_start();
 }
+#endif
 
 /*
  * init_adc
@@ -84,15 +159,9 @@ static void adc_start_collection(void)
  * Description: This function initializes the ADC peripheral so that the proper
  *              pins are allocated for use. After this function, the ADC will
  *              *not* be running; the 'adc_start_collection' function should be
- *              called before data will be collected. This initialization
- *              involves:
- *               - Writing to ADMUX and ADCSRB to select the input channel.
- *               - Enable ADC by writing to ADCSRA.
- *               - Left-adjust the data input by writing to ADMUX.
- *               - Set the trigger source using ADCSRB.
- *               - Enable the ADC interrupt.
- *               - Setting up interrupts for autotriggering.
- *               - Setting up external interrupt.
+ *              called before data will be collected. In the ring buffer mode,
+ *              the ADC is started right away and runs all the time instead.
+ *              The registers are set up by 'hal_adc_init'.
  *
  * Notes:       This function will initialize the ADC and external interrupt to
  *              use PF0 and PD0. If these pins are used for another purpose,
@@ -100,110 +169,361 @@ static void adc_start_collection(void)
  */
 void init_adc(void)
 {
-    /* Set all the configuration registers to their initial values. */
-    ADMUX   = ADMUX_VAL;
-    ADCSRA  = ADCSRA_VAL;
-    ADCSRB  = ADCSRB_VAL;
-    DIDR0   = DIDR0_VAL;
-    DIDR2   = DIDR2_VAL;
-
-    /* Reset the buffer collection. */
-    adc_reset_buffer();
-
-    /* Add pullup resistor to the INT0 pin. */
-    PORTD = PORTD_VAL;
-
-    /* Activate the external interrupt for triggering a recording. */
-    EICRA = EICRA_VAL;
-    EIMSK = EIMSK_VAL;
+#ifndef ADC_STREAM
+    unsigned char i;
+#endif
+
+    /* Set up the ADC and the external trigger. */
+    hal_adc_init();
+
+#ifdef ADC_STREAM
+    /* The ring starts out empty, with no windows marked. */
+    writepos = 0;
+    hopcount = 0;
+    primed = 0;
+    marks = 0;
+    winhead = 0;
+    wintail = 0;
+#else
+    /* All of the buffers start out free. */
+    for (i = 0; i < NUM_BUFFERS; i++)
+    {
+        bufstate[i] = BUF_FREE;
+    }
+    fillbuf = 0;
+    readbuf = 0;
+    bufidx = 0;
+    collecting = 0;
+#endif
+    overruns = 0;
+
+#ifdef USE_PREPROCESS
+    /* No DC level has been seen yet. */
+    preprocess_init();
+#endif
+
+#ifdef ADC_STREAM
+    /* Start the ADC running; it never stops in this mode. */
+    hal_adc_start();
+#endif
+}
+
+#ifdef ADC_STREAM
+/*
+ * adc_acquire_window
+ *
+ * Description: Gets the oldest window that was marked by a trigger and not yet
+ *              acquired. The window is left in the ring, so the caller should
+ *              read it right away (with 'rfft_ring' or 'fft_q15_ring'), before
+ *              the ADC writes over it.
+ *
+ * Arguments:   start  Filled in with the position of the first sample of the
+ *                     window, counted from when the ADC started and wrapping
+ *                     around with an unsigned int. Its index in the ring is
+ *                     the position masked with 'RING_SIZE - 1', and the next
+ *                     window is 'HOP_SIZE' further on.
+ *
+ * Returns:     Returns a pointer to the ring buffer, or NULL if no window is
+ *              ready yet. The ring holds 'RING_SIZE' samples (see
+ *              'ring_sample'), and the window wraps around the end of it.
+ *
+ * Notes:       A window that the ADC has almost caught up with is dropped and
+ *              counted as an overrun, so there is always at least 'HOP_SIZE'
+ *              samples of time to read the window.
+ */
+const ring_sample *adc_acquire_window(unsigned int *start)
+{
+    unsigned char sreg;
+    unsigned int pos;           /* Write position when the window was taken. */
+
+    /* Keep going until a window is found that is still in the ring. */
+    while (winhead != wintail)
+    {
+        /* The queue and the write position are changed by the interrupt, so
+         * read them with interrupts off. */
+        sreg = hal_irq_save();
+        *start = winstart[winhead % NUM_WINDOWS];
+        pos = writepos;
+
+        /* Done with this slot in the queue. */
+        winhead++;
+
+        /* If the ADC is close to writing over the window, it is no good. */
+        if (pos - *start > RING_SIZE - HOP_SIZE) {
+            overruns++;
+            hal_irq_restore(sreg);
+            continue;
+        }
+        hal_irq_restore(sreg);
+
+        /* The position is left as it is; the transforms mask it. */
+        return ring;
+    }
+
+    /* Nothing is ready. */
+    return NULL;
 }
+#else
 
 /*
- * adc_get_buffer
+ * adc_acquire
  *
- * Description: Get a pointer to the buffer of data that has been filled by the
- *              ADC. Note that this buffer should be retrieved each time that
- *              the data collection completes and should not be used globally.
+ * Description: Gets the oldest buffer that has been filled by the ADC and not
+ *              yet acquired. The buffer belongs to the caller until it is given
+ *              back with 'adc_release'; the ADC will not write to it until
+ *              then.
  *
- * Returns:     Returns a pointer to the buffer containing the data collected by
- *              the ADC.
+ * Returns:     Returns a pointer to the filled buffer, or NULL if no buffer is
+ *              ready yet.
  *
- * Notes:       This kind of makes the buffer into a global variable, so be
- *              careful where this is used.
+ * Notes:       Buffers are acquired in the order that they were filled.
  */
-complex *adc_get_buffer(void)
+sample *adc_acquire(void)
 {
-    /* Return the current buffer. */
-    return databuf;
+    sample *buf;
+
+    /* If the next buffer has not been filled yet, there is nothing to get. */
+    if (bufstate[readbuf] != BUF_FULL) {
+        return NULL;
+    }
+
+    /* Hand the buffer over to the caller, then move on to the next one. */
+    bufstate[readbuf] = BUF_IN_USE;
+    buf = databuf[readbuf];
+    readbuf = (readbuf + 1) % NUM_BUFFERS;
+
+    return buf;
 }
 
+/*
+ * adc_release
+ *
+ * Description: Gives a buffer that was gotten from 'adc_acquire' back to the
+ *              ADC, so that it can be used for another recording.
+ *
+ * Arguments:   buf  The buffer to release.
+ *
+ * Notes:       The buffer must not be used after it has been released.
+ */
+void adc_release(sample *buf)
+{
+    /* Find which buffer this is, and mark it as free. */
+    bufstate[(buf - databuf[0]) / SAMPLE_POINTS] = BUF_FREE;
+}
+
+#endif
+
 /*
  * is_data_collected
  *
- * Description: Determines whether or not the data has been fully collected. If
- *              the buffer is full of new data, this function returns nonzero.
- *              If the ADC is still collecting data for the buffer, returns 0.
- *              This is used to find if the data is ready to run through the
- *              FFT.
+ * Description: Determines whether or not there is a buffer of data that has
+ *              been fully collected but not yet acquired. This is used to find
+ *              if there is data that is ready to run through the FFT.
  *
- * Returns:     If the buffer is full of new data, return nonzero. Else, return
+ * Returns:     If a buffer is full of new data, return nonzero. Else, return
  *              zero.
  *
- * Notes:       The data collection is reset when the 'adc_start_collection'
- *              function is called.
+ * Notes:       Once the buffer is acquired with 'adc_acquire', this will return
+ *              zero until another buffer is filled.
  */
 unsigned char is_data_collected(void)
 {
-    /* Data is collected once the buffer is full. */
-    return buffull;
+#ifdef ADC_STREAM
+    /* Data is collected once a marked window is waiting. */
+    return winhead != wintail;
+#else
+    /* Data is collected once the next buffer to acquire is full. */
+    return bufstate[readbuf] == BUF_FULL;
+#endif
 }
 
+/*
+ * adc_idle
+ *
+ * Description: Determines whether the ADC has nothing for the main loop to
+ *              analyze, either waiting or on the way: no buffer is being
+ *              filled or waiting to be acquired, or, in the ring buffer mode,
+ *              no window is marked or queued.
+ *
+ * Returns:     Returns nonzero if the ADC is idle, or zero if a recording is
+ *              waiting or being made.
+ *
+ * Notes:       A trigger can still start a recording right after this returns
+ *              nonzero, so anything done while idle should be short.
+ */
+unsigned char adc_idle(void)
+{
+#ifdef ADC_STREAM
+    /* Idle once every window marked by the last trigger has been taken. */
+    return marks == 0 && winhead == wintail;
+#else
+    /* Idle when not recording and no full buffer is waiting. */
+    return !collecting && bufstate[readbuf] != BUF_FULL;
+#endif
+}
 
 /*
- * adc_reset_buffer
+ * adc_overruns
  *
- * Description: Resets the data buffer that is filled by the ADC. This function
- *              will clear empty the buffer and cause the ADC to begin filling
- *              from the beginning. Note that this function does not start the
- *              ADC data collection; the buffer will be refilled from the
- *              beginning once the 'adc_start_collection' function is called.
+ * Description: Gets the number of recordings that have been dropped because
+ *              every buffer was either full or in use when the recording was
+ *              triggered. In the ring buffer mode, this is the number of marked
+ *              windows that were dropped because the queue was full or the ADC
+ *              wrote over them before they were acquired.
  *
- * Notes:       This function should not be called while the buffer is in the
- *              process of being filled. This may cause unexpected race
- *              conditions.
+ * Returns:     Returns the number of dropped recordings since 'init_adc'. This
+ *              wraps around once it overflows.
  */
-void adc_reset_buffer(void)
+unsigned int adc_overruns(void)
 {
-    /* Start buffer collection from the beginning. */
-    bufidx = 0;
+    unsigned char sreg;
+    unsigned int count;
 
-    /* Buffer is no longer full. */
-    buffull = 0;
+    /* The count is changed by an interrupt, so read both bytes of it with
+     * interrupts off. */
+    sreg = hal_irq_save();
+    count = overruns;
+    hal_irq_restore(sreg);
 
-    /* No longer collecting data. */
-    collecting = 0;
+    return count;
 }
 
+#ifdef ADC_STREAM
 /*
- * ADC_vect
+ * adc_sample_ready
+ *
+ * Description: Called by the ADC interrupt with each new sample. The function
+ *              stores the new data point in the ring. Every 'HOP_SIZE' samples,
+ *              if the trigger marked any windows to look at, the window ending
+ *              with this sample is queued for the main loop.
  *
- * Description: Interrupt vector for the ADC interrupt. When this interrupt
- *              occurs, the function will store the new data point if the buffer
- *              is not yet full. Then, the function will check to see if the
- *              buffer is now full, updating the flag accordingly. Once the
- *              buffer is full, data collection is disabled.
+ * Arguments:   value  The sample, left-adjusted to 16 bits.
  *
- * Notes:       The interrupt should be automatically reset in hardware.
+ * Notes:       The ADC is never stopped in this mode.
  */
-ISR(ADC_vect)
+void adc_sample_ready(unsigned int value)
 {
+    int x;                      /* The sample as a signed 16-bit fraction. */
+
+#ifdef USE_PREPROCESS
+    /* Clean up the sample. */
+    x = preprocess_sample(value);
+#else
+    /* Take the ADC, less the bias, as the signal. */
+    x = ADC_SIGNED(value);
+#endif
+
+#ifdef USE_Q15
+    /* Keep all 16 bits, so that the bits from oversampling are kept. */
+    ring[writepos & (RING_SIZE - 1)] = x;
+#else
+    ring[writepos & (RING_SIZE - 1)] = x >> 8;
+#endif
+    writepos++;
+
+    /* Don't queue any windows until there is a full window in the ring. */
+    if (primed < SAMPLE_SIZE) {
+        primed++;
+    }
+
+    /* Check whether a window ends here. */
+    hopcount++;
+    if (hopcount == HOP_SIZE)
+    {
+        hopcount = 0;
+
+        if (marks != 0 && primed == SAMPLE_SIZE)
+        {
+            marks--;
+
+            /* Queue the window if there is room; else it is dropped. */
+            if ((unsigned char)(wintail - winhead) < NUM_WINDOWS) {
+                winstart[wintail % NUM_WINDOWS] = writepos - SAMPLE_SIZE;
+                wintail++;
+                event_post(EV_RECORDING);
+            }
+            else {
+                overruns++;
+            }
+        }
+    }
+}
+
+/*
+ * adc_trigger
+ *
+ * Description: Marks the windows around an external trigger for analysis. Once
+ *              the amplitude of the audio input goes above a certain level,
+ *              the external interrupt will fire and call this function. The
+ *              window that is being recorded when it fires (which holds the
+ *              samples just before the trigger) and the ones after it, up to a
+ *              full window past the trigger, are queued as they finish. Another
+ *              trigger while these are still being queued extends the run.
+ */
+void adc_trigger(void)
+{
+    /* Look at every window that overlaps the next 'SAMPLE_SIZE' samples. */
+    marks = WINDOWS_PER_TRIGGER;
+    event_post(EV_TRIGGER);
+}
+#else
+/*
+ * adc_sample_ready
+ *
+ * Description: Called by the ADC interrupt with each new sample. The function
+ *              will store the new data point if a buffer is being filled. Then,
+ *              the function will check to see if the buffer is now full,
+ *              updating its state accordingly. Once the buffer is full, data
+ *              collection is disabled until the next trigger.
+ *
+ * Arguments:   value  The sample, left-adjusted to 16 bits.
+ */
+void adc_sample_ready(unsigned int value)
+{
+#ifndef USE_GOERTZEL
+    sample *buf = databuf[fillbuf];     /* Buffer being filled. */
+#endif
+
     /* If the buffer is not yet full, record the data. */
-    if (!buffull)
+    if (collecting)
     {
-        /* Take the upper 8 bits of the ADC as the real part of the signal. The
+#if defined(USE_GOERTZEL)
+        /* Update the bins that the matcher is looking at. */
+#ifdef USE_PREPROCESS
+        goertzel_update(preprocess_sample(value) >> 8);
+#else
+        goertzel_update(ADC_SIGNED(value) >> 8);
+#endif
+#elif defined(USE_Q15)
+        /* Take all 16 bits of the ADC, less the bias, as a fraction for the
+         * real part of the signal, so that the bits from oversampling are
+         * kept, or all 16 bits of the result from the front end. The
          * imaginary part is zero. */
-        databuf[bufidx].real = ADCH;
-        databuf[bufidx].imag = 0;
+#ifdef USE_PREPROCESS
+        buf[bufidx].real = preprocess_sample(value);
+#else
+        buf[bufidx].real = ADC_SIGNED(value);
+#endif
+        buf[bufidx].imag = 0;
+#else
+#ifdef USE_PREPROCESS
+        /* Clean up the sample, which comes back scaled to 16 bits too. */
+        value = preprocess_sample(value);
+#else
+        value = ADC_SIGNED(value);
+#endif
+
+        /* Take the upper 8 bits of the sample as the signal. The signal is
+         * purely real, so two samples are packed into each point for the
+         * real-input FFT: even samples in the real part and odd in the
+         * imaginary. */
+        if (bufidx & 1) {
+            buf[bufidx / 2].imag = value >> 8;
+        }
+        else {
+            buf[bufidx / 2].real = value >> 8;
+        }
+#endif
 
         /* Next data point should be stored in the next slot. */
         bufidx++;
@@ -211,37 +531,49 @@ ISR(ADC_vect)
         /* Check to see if the buffer is full. */
         if (bufidx == SAMPLE_SIZE)
         {
-            /* When full, set the flag. */
-            buffull = 1;
+#ifdef USE_GOERTZEL
+            /* When done, the matcher can make its decision. */
+            goertzel_finish();
+#else
+            /* When full, hand the buffer off and move to the next one. */
+            bufstate[fillbuf] = BUF_FULL;
+            fillbuf = (fillbuf + 1) % NUM_BUFFERS;
+#endif
+            collecting = 0;
 
-            /* Disable further data collection. */
-            ADCSRA = ADCSRA_VAL;
+            /* Disable further data collection, and wake up the main loop. */
+            hal_adc_stop();
+            event_post(EV_RECORDING);
         }
     }
     /* If the buffer is already full, then we triggered once too many
-     * conversions. This interrupt can be ignored. */
-
-    /* Interrupt flag is automatically turned off in hardware. */
+     * conversions. This sample can be ignored. */
 }
 
 /*
- * INT0_vect
+ * adc_trigger
  *
  * Description: Triggers the ADC data collection on an external interrupt. Once
  *              the amplitude of the audio input goes above a certain level,
- *              this interrupt will fire and begin recording data. If data is
- *              already being collected, or the buffer is already full, then the
- *              interrupt will be ignored.
- *
- * Notes:       The interrupt should be automatically reset in hardware.
+ *              the external interrupt will fire and call this function to begin
+ *              recording data into the next buffer. If data is already being
+ *              collected, then the trigger will be ignored. If there is no free
+ *              buffer to record into, the recording is dropped and counted as
+ *              an overrun.
  */
-ISR(INT0_vect)
+void adc_trigger(void)
 {
     /* If we aren't already collecting, start the collection. */
     if (!collecting) {
-        adc_start_collection();
+        if (bufstate[fillbuf] == BUF_FREE) {
+            adc_start_collection();
+            event_post(EV_TRIGGER);
+        }
+        else {
+            /* Every buffer is still waiting on the main loop. */
+            overruns++;
+        }
     }
-    /* Else, just ignore this interrupt. */
-
-    /* The interrupt flag is cleared automatically in hardware. */
+    /* Else, just ignore this trigger. */
 }
+#endif
@@ -6,12 +6,25 @@
  * This file contains functions that handle data collection from the ADC using
  * interrupts. The ADC will be run at set intervals and generate an interrupt
  * every time it has a new data point. Functions in this file will record the
- * data point and disable further interrupts once the buffer is full. Once the
- * buffer is no longer in use, interrupts can be re-enabled when needed.
+ * data point and disable further interrupts once the buffer is full. There are
+ * several buffers, so that a new recording can be made into one buffer while
+ * the main loop is still working on another. Buffers are handed to the main
+ * loop with 'adc_acquire' and given back with 'adc_release'.
+ *
+ * If built with 'ADC_STREAM', the ADC instead runs all the time, recording
+ * into a ring buffer. Every 'HOP_SIZE' samples, the last 'SAMPLE_SIZE' samples
+ * make up a window that can be analyzed. The external trigger just marks which
+ * of the windows around it are worth looking at; they are handed to the main
+ * loop with 'adc_acquire_window' and are read straight out of the ring.
+ *
+ * The registers are set up in the hardware abstraction layer (see 'hal.h'),
+ * which calls 'adc_sample_ready' for each sample and 'adc_trigger' for each
+ * trigger.
  *
  * Peripherals Used:
  *      ADC
  *      External interrupts
+ *      Timer1 (with 'ADC_TIMER')
  *
  * Pins Used:
  *      PF0
@@ -20,6 +33,17 @@
  * Revision History:
  *      05 Jun 2015     Brian Kubisiak      Initial revision.
  *      06 Jun 2015     Brian Kubisiak      Added external trigger.
+ *      16 Oct 2026     agent               Multiple buffers with acquire and
+ *                                          release.
+ *      16 Oct 2026     agent               Added continuous ring buffer mode.
+ *      16 Oct 2026     agent               Moved the registers to the HAL.
+ *      16 Oct 2026     agent               Give out the position of a window.
+ *      16 Oct 2026     agent               One buffer for the largest Q15
+ *                                          windows.
+ *      16 Oct 2026     agent               Take 16-bit samples.
+ *      16 Oct 2026     agent               Samples are offset binary.
+ *      16 Oct 2026     agent               Keep 16 bits in the Q15 ring.
+ *      16 Oct 2026     agent               Added 'adc_idle'.
  */
 
 #ifndef _ADC_H_
@@ -28,20 +52,43 @@
 
 #include "data.h"
 
+
+#ifndef NUM_BUFFERS
+#if defined(USE_Q15) && SAMPLE_SIZE > 512
+#define NUM_BUFFERS         1       /* Two Q15 buffers do not fit in SRAM. */
+#else
+#define NUM_BUFFERS         2       /* Number of buffers to record into. */
+#endif
+#endif
+
+/* Settings for the ring buffer mode. The ring size must be a power of two. */
+#ifndef RING_SIZE
+#define RING_SIZE           (2 * SAMPLE_SIZE)   /* Samples in the ring. */
+#endif
+#ifndef HOP_SIZE
+#define HOP_SIZE            (SAMPLE_SIZE / 2)   /* Samples between windows. */
+#endif
+#ifndef NUM_WINDOWS
+#define NUM_WINDOWS         4       /* Windows that can wait to be acquired. */
+#endif
+
+/* Number of windows marked by a trigger: enough to cover a full window of
+ * samples after the trigger, plus the window that is open when it fires. */
+#define WINDOWS_PER_TRIGGER (SAMPLE_SIZE / HOP_SIZE + 1)
+
+/* A sample from the ADC as a signed 16-bit fraction. The ADC gives offset
+ * binary, with the microphone's mid-rail bias at 0x8000, so the bias is taken
+ * off as an unsigned value before the sample is treated as signed. */
+#define ADC_SIGNED(value)   ((int)((value) - 0x8000U))
+
 /*
  * init_adc
  *
  * Description: This function initializes the ADC peripheral so that the proper
  *              pins are allocated for use. After this function, the ADC will
  *              *not* be running; the 'adc_start_collection' function should be
- *              called before data will be collected. This initialization
- *              involves:
- *               - Writing to ADMUX and ADCSRB to select the input channel.
- *               - Enable ADC by writing to ADCSRA.
- *               - Left-adjust the data input by writing to ADMUX.
- *               - Set the trigger source using ADCSRB.
- *               - Setting up interrupts for autotriggering.
- *               - Setting up external interrupt.
+ *              called before data will be collected. The registers are set up
+ *              by 'hal_adc_init'.
  *
  * Notes:       This function will initialize the ADC to use PF0. If this pin is
  *              used for another purpose, these functions will not work
@@ -50,53 +97,138 @@
 void init_adc(void);
 
 
+#ifdef ADC_STREAM
+/*
+ * adc_acquire_window
+ *
+ * Description: Gets the oldest window that was marked by a trigger and not yet
+ *              acquired. The window is left in the ring, so the caller should
+ *              read it right away (with 'rfft_ring' or 'fft_q15_ring'), before
+ *              the ADC writes over it.
+ *
+ * Arguments:   start  Filled in with the position of the first sample of the
+ *                     window, counted from when the ADC started and wrapping
+ *                     around with an unsigned int. Its index in the ring is
+ *                     the position masked with 'RING_SIZE - 1', and the next
+ *                     window is 'HOP_SIZE' further on.
+ *
+ * Returns:     Returns a pointer to the ring buffer, or NULL if no window is
+ *              ready yet. The ring holds 'RING_SIZE' samples (see
+ *              'ring_sample'), and the window wraps around the end of it.
+ *
+ * Notes:       A window that the ADC has almost caught up with is dropped and
+ *              counted as an overrun, so there is always at least 'HOP_SIZE'
+ *              samples of time to read the window.
+ */
+const ring_sample *adc_acquire_window(unsigned int *start);
+#else
+/*
+ * adc_acquire
+ *
+ * Description: Gets the oldest buffer that has been filled by the ADC and not
+ *              yet acquired. The buffer belongs to the caller until it is given
+ *              back with 'adc_release'; the ADC will not write to it until
+ *              then.
+ *
+ * Returns:     Returns a pointer to the filled buffer, or NULL if no buffer is
+ *              ready yet. The buffer holds 'SAMPLE_POINTS' points; see 'data.h'
+ *              for how the samples are packed.
+ *
+ * Notes:       Buffers are acquired in the order that they were filled.
+ */
+sample *adc_acquire(void);
+
 /*
- * adc_get_buffer
+ * adc_release
  *
- * Description: Get a pointer to the buffer of data that has been filled by the
- *              ADC. Note that this buffer should be retrieved each time that
- *              the data collection completes and should not be used globally.
+ * Description: Gives a buffer that was gotten from 'adc_acquire' back to the
+ *              ADC, so that it can be used for another recording.
  *
- * Returns:     Returns a pointer to the buffer containing the data collected by
- *              the ADC.
+ * Arguments:   buf  The buffer to release.
  *
- * Notes:       This kind of makes the buffer into a global variable, so be
- *              careful where this is used. Also note that the buffer should
- *              only be used once it is filled.
+ * Notes:       The buffer must not be used after it has been released.
  */
-complex *adc_get_buffer(void);
+void adc_release(sample *buf);
+#endif
 
 /*
  * is_data_collected
  *
- * Description: Determines whether or not the data has been fully collected. If
- *              the buffer is full of new data, this function returns nonzero.
- *              If the ADC is still collecting data for the buffer, returns 0.
- *              This is used to find if the data is ready to run through the
- *              FFT.
+ * Description: Determines whether or not there is a buffer of data that has
+ *              been fully collected but not yet acquired. This is used to find
+ *              if there is data that is ready to run through the FFT.
  *
- * Returns:     If the buffer is full of new data, return nonzero. Else, return
+ * Returns:     If a buffer is full of new data, return nonzero. Else, return
  *              zero.
  *
- * Notes:       The data collection is reset when the 'adc_start_collection'
- *              function is called.
+ * Notes:       Once the buffer is acquired with 'adc_acquire', this will return
+ *              zero until another buffer is filled.
  */
 unsigned char is_data_collected(void);
 
 /*
- * adc_reset_buffer
+ * adc_idle
+ *
+ * Description: Determines whether the ADC has nothing for the main loop to
+ *              analyze, either waiting or on the way: no buffer is being
+ *              filled or waiting to be acquired, or, in the ring buffer mode,
+ *              no window is marked or queued.
+ *
+ * Returns:     Returns nonzero if the ADC is idle, or zero if a recording is
+ *              waiting or being made.
+ *
+ * Notes:       A trigger can still start a recording right after this returns
+ *              nonzero, so anything done while idle should be short.
+ */
+unsigned char adc_idle(void);
+
+/*
+ * adc_overruns
+ *
+ * Description: Gets the number of recordings that have been dropped because
+ *              every buffer was either full or in use when the recording was
+ *              triggered. In the ring buffer mode, this is the number of marked
+ *              windows that were dropped because the queue was full or the ADC
+ *              wrote over them before they were acquired.
+ *
+ * Returns:     Returns the number of dropped recordings since 'init_adc'. This
+ *              wraps around once it overflows.
+ */
+unsigned int adc_overruns(void);
+
+
+/*
+ * adc_sample_ready
+ *
+ * Description: Called by the ADC interrupt with each new sample. The sample is
+ *              recorded into the buffer being filled (or the ring, or passed to
+ *              the Goertzel matcher), if a recording is in progress.
+ *
+ * Arguments:   value  The sample, left-adjusted to 16 bits, so that the upper 8
+ *                     bits are the same whatever the ADC's resolution. It is
+ *                     in offset binary, as the ADC gives it (see
+ *                     'ADC_SIGNED'). All 16 bits go through the front end;
+ *                     the 8-bit datapath and the Goertzel matcher keep the
+ *                     upper 8 bits of the result, and the Q15 datapath keeps
+ *                     all 16, in the buffers and in the ring.
+ *
+ * Notes:       This is only called from the hardware abstraction layer. An
+ *              'EV_RECORDING' event is posted whenever a recording is ready.
+ */
+void adc_sample_ready(unsigned int value);
+
+/*
+ * adc_trigger
  *
- * Description: Resets the data buffer that is filled by the ADC. This function
- *              will clear empty the buffer and cause the ADC to begin filling
- *              from the beginning. Note that this function does not start the
- *              ADC data collection; the buffer will be refilled from the
- *              beginning once the 'adc_start_collection' function is called.
+ * Description: Called by the external interrupt when the amplitude of the audio
+ *              input goes above a certain level. This starts a recording into
+ *              the next free buffer, or marks the windows around the trigger in
+ *              the ring buffer mode.
  *
- * Notes:       This function should not be called while the buffer is in the
- *              process of being filled. This may cause unexpected race
- *              conditions.
+ * Notes:       This is only called from the hardware abstraction layer. An
+ *              'EV_TRIGGER' event is posted if the trigger is acted on.
  */
-void adc_reset_buffer(void);
+void adc_trigger(void);
 
 
 #endif /* end of include guard: _ADC_H_ */
@@ -0,0 +1,231 @@
+/*
+ * arith.h
+ *
+ * Inline arithmetic on complex numbers for the FFT.
+ *
+ * This file contains the complex arithmetic used by the butterflies of the
+ * FFT. Everything is defined here as 'static inline', so each butterfly is
+ * compiled right into the loop that uses it, with no calls, no copying of the
+ * arguments and results, and no branches. A butterfly is also given as one
+ * operation, so the shared input is only loaded once, and the Q15 butterfly
+ * only needs one multiply for both of its outputs.
+ *
+ * The adds and subtracts do not saturate. The block floating point scaling of
+ * the FFT (see 'fft.c') already makes sure that no output of a butterfly can
+ * overflow its part, so each add is just one 8-bit (or 16-bit) add.
+ *
+ * If built with 'ARITH_CALLS', the primitives are instead real functions, like
+ * the out-of-line versions that used to be in 'data.c'. This is only for the
+ * benchmark (see 'bench-fft.c'), to measure what inlining saves.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#ifndef _ARITH_H_
+#define _ARITH_H_
+
+
+#include "data.h"
+
+
+/* How the primitives are compiled: inline, or as calls for the benchmark. */
+#ifdef ARITH_CALLS
+#define ARITH_FUNC          static __attribute__((noipa, unused))
+#else
+#define ARITH_FUNC          static inline
+#endif
+
+/* Signed fractional multiply of two 8-bit numbers: the 16-bit product shifted
+ * up by one bit, so that the result is in the high byte. On the AVR this is a
+ * single 'FMULS' instruction. */
+#ifdef __AVR__
+#define FMULS(a, b)         __builtin_avr_fmuls((a), (b))
+#else
+#define FMULS(a, b)         ((int)(a) * (b) * 2)
+#endif
+
+
+/*
+ * add
+ *
+ * Description: Adds together two complex numbers in the Cartesian plane.
+ *
+ * Arguments:   a  The first number to add.
+ *              b  The second number to add.
+ *
+ * Returns:     Returns the complex number that is the sum of the two inputs.
+ */
+ARITH_FUNC complex add(complex a, complex b)
+{
+    complex res;
+
+    res.real = a.real + b.real;
+    res.imag = a.imag + b.imag;
+
+    return res;
+}
+
+
+/*
+ * sub
+ *
+ * Description: Subtracts one complex number from another in the Cartesian
+ *              plane.
+ *
+ * Arguments:   a  The number to subtract from.
+ *              b  The number to subtract.
+ *
+ * Returns:     Returns the complex number that is the difference of the two
+ *              inputs.
+ */
+ARITH_FUNC complex sub(complex a, complex b)
+{
+    complex res;
+
+    res.real = a.real - b.real;
+    res.imag = a.imag - b.imag;
+
+    return res;
+}
+
+
+/*
+ * mul
+ *
+ * Description: Computes the product of two complex numbers in the Cartesian
+ *              plane. The second number is treated as a fixed-point fraction
+ *              with 7 bits after the binary point (so 127 is just under 1.0),
+ *              which is how the roots of unity are stored.
+ *
+ * Arguments:   a  First number to multiply.
+ *              b  Second number to multiply, scaled by 128.
+ *
+ * Returns:     Returns the complex number that is the product of the two
+ *              inputs, scaled back down into the range of 'a'.
+ *
+ * Notes:       Each part is two 'FMULS' products, which are already shifted up
+ *              by one bit, so rounding and taking the high byte gives the same
+ *              result as rounding the sum of the plain products and shifting
+ *              it down by 7 bits. The sum has to fit in 16 bits, so the parts
+ *              of 'a' must be within +/-90; the block floating point limits
+ *              keep them well inside that.
+ */
+ARITH_FUNC complex mul(complex a, complex b)
+{
+    complex res;
+
+    /* (a + jb)(c + jd) = (ac - bd) + j(ad + bc) */
+    res.real = (FMULS(a.real, b.real) - FMULS(a.imag, b.imag) + 128) >> 8;
+    res.imag = (FMULS(a.real, b.imag) + FMULS(a.imag, b.real) + 128) >> 8;
+
+    return res;
+}
+
+
+/*
+ * add_q15
+ *
+ * Description: Adds together two Q15 complex numbers in the Cartesian plane.
+ *
+ * Arguments:   a  The first number to add.
+ *              b  The second number to add.
+ *
+ * Returns:     Returns the complex number that is the sum of the two inputs.
+ */
+ARITH_FUNC complex_q15 add_q15(complex_q15 a, complex_q15 b)
+{
+    complex_q15 res;
+
+    res.real = a.real + b.real;
+    res.imag = a.imag + b.imag;
+
+    return res;
+}
+
+
+/*
+ * mul_q15
+ *
+ * Description: Computes the product of two Q15 complex numbers in the
+ *              Cartesian plane. The products are computed in 32 bits, then
+ *              rounded back down to Q15.
+ *
+ * Arguments:   a  First number to multiply.
+ *              b  Second number to multiply.
+ *
+ * Returns:     Returns the complex number that is the product of the two
+ *              inputs.
+ */
+ARITH_FUNC complex_q15 mul_q15(complex_q15 a, complex_q15 b)
+{
+    complex_q15 res;
+
+    /* Add half an LSB before shifting to round to nearest. */
+    res.real = ((long)a.real * b.real - (long)a.imag * b.imag + 0x4000L) >> 15;
+    res.imag = ((long)a.real * b.imag + (long)a.imag * b.real + 0x4000L) >> 15;
+
+    return res;
+}
+
+
+/*
+ * butterfly
+ *
+ * Description: Does one radix-2 butterfly in place: a and b are replaced with
+ *              a + t and a - t, where t is b already multiplied by the root.
+ *
+ * Arguments:   a  The first point, which is replaced with a + t.
+ *              b  The second point, which is replaced with a - t.
+ *              t  The second point times the root of the butterfly.
+ *
+ * Notes:       The caller works out t, so that the trivial roots (1 and j) can
+ *              skip the multiply.
+ */
+static inline void butterfly(complex *a, complex *b, complex t)
+{
+    complex x = *a;
+
+    *a = add(x, t);
+    *b = sub(x, t);
+}
+
+
+/*
+ * butterfly_q15
+ *
+ * Description: Does one radix-2 butterfly on Q15 points in place: a and b are
+ *              replaced with a + bw and a + b(-w).
+ *
+ * Arguments:   a  The first point, which is replaced with a + bw.
+ *              b  The second point, which is replaced with a - bw.
+ *              w  The root of the butterfly.
+ *
+ * Notes:       The product bw is only computed once. The second output rounds
+ *              the negated product, so the result is exactly what multiplying
+ *              by the negated root would give.
+ */
+static inline void butterfly_q15(complex_q15 *a, complex_q15 *b, complex_q15 w)
+{
+    complex_q15 x = *a;
+#ifdef ARITH_CALLS
+    complex_q15 y = *b;
+    complex_q15 neg_w;
+
+    neg_w.real = -w.real;
+    neg_w.imag = -w.imag;
+    *a = add_q15(x, mul_q15(y, w));
+    *b = add_q15(x, mul_q15(y, neg_w));
+#else
+    long pr = (long)b->real * w.real - (long)b->imag * w.imag;
+    long pi = (long)b->real * w.imag + (long)b->imag * w.real;
+
+    a->real = x.real + ((pr + 0x4000L) >> 15);
+    a->imag = x.imag + ((pi + 0x4000L) >> 15);
+    b->real = x.real + ((0x4000L - pr) >> 15);
+    b->imag = x.imag + ((0x4000L - pi) >> 15);
+#endif
+}
+
+
+#endif /* end of include guard: _ARITH_H_ */
@@ -0,0 +1,311 @@
+/*
+ * bands.c
+ *
+ * Matching on the levels of log-spaced frequency bands.
+ *
+ * This file contains code for folding the bins of a spectrum into a few bands
+ * and matching the band levels against a table of dogs. The bands are given by
+ * a table of their first bins, worked out by the compiler, so each band is a
+ * run of bins of the spectrum in natural order. Nothing in here is used without
+ * 'USE_BANDS'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Only build the band keys for the
+ *                                          window size they were made at.
+ *      16 Oct 2026     agent               Added the second dog.
+ */
+
+#include <stdlib.h>
+
+#include "bands.h"
+#include "fft.h"
+#include "key.h"
+#include "progmem.h"
+
+#if LOG2_SAMPLE_SIZE < 4 || LOG2_SAMPLE_SIZE > 10
+#error "The bands need a SAMPLE_SIZE from 16 to 1024"
+#endif
+
+/* The Q15 power of each bin is scaled down by this many bits before it is
+ * added to its band, so that a band of up to 'SAMPLE_SIZE / 4' bins still
+ * fits in 32 bits. */
+#define Q15_BIN_SHIFT   8
+
+/* Bin at half octave 'b' above bin 1, rounded; 181 / 128 is the square root
+ * of 2. */
+#define HALF_OCTAVE(b)  (((1U << ((b) / 2)) * (((b) & 1) ? 181 : 128) + 64) \
+                         >> 7)
+
+/* First bin of band 'b'. A band is at least one bin wide, so the low bands
+ * step one bin at a time until the half octaves are more than a bin apart. */
+#define BAND_EDGE(b)    ((HALF_OCTAVE(b) > (b) + 1) ? HALF_OCTAVE(b) : (b) + 1)
+
+/* Writes out the edges of the bands for each size of transform. There are two
+ * more bands each time 'SAMPLE_SIZE' doubles. */
+#define EDGES4          BAND_EDGE(0), BAND_EDGE(1), BAND_EDGE(2), \
+                        BAND_EDGE(3), BAND_EDGE(4), BAND_EDGE(5), BAND_EDGE(6)
+#define EDGES5          EDGES4, BAND_EDGE(7), BAND_EDGE(8)
+#define EDGES6          EDGES5, BAND_EDGE(9), BAND_EDGE(10)
+#define EDGES7          EDGES6, BAND_EDGE(11), BAND_EDGE(12)
+#define EDGES8          EDGES7, BAND_EDGE(13), BAND_EDGE(14)
+#define EDGES9          EDGES8, BAND_EDGE(15), BAND_EDGE(16)
+#define EDGES10         EDGES9, BAND_EDGE(17), BAND_EDGE(18)
+
+#if LOG2_SAMPLE_SIZE == 4
+#define EDGES           EDGES4
+#elif LOG2_SAMPLE_SIZE == 5
+#define EDGES           EDGES5
+#elif LOG2_SAMPLE_SIZE == 6
+#define EDGES           EDGES6
+#elif LOG2_SAMPLE_SIZE == 7
+#define EDGES           EDGES7
+#elif LOG2_SAMPLE_SIZE == 8
+#define EDGES           EDGES8
+#elif LOG2_SAMPLE_SIZE == 9
+#define EDGES           EDGES9
+#else
+#define EDGES           EDGES10
+#endif
+
+
+/*
+ * band_edge
+ *
+ * Description: This array holds the first bin of each band, and then bin
+ *              SAMPLE_SIZE/2, which is the last bin of the last band. Band b
+ *              is bins 'band_edge[b]' up to (but not including)
+ *              'band_edge[b + 1]', except that the last band takes in bin
+ *              SAMPLE_SIZE/2 as well.
+ */
+static const unsigned short band_edge[NUM_BANDS + 1] PROGMEM = {
+    EDGES
+};
+
+
+#ifdef USE_BANDS
+
+#if SAMPLE_SIZE != 64
+#error "The band keys are only for a SAMPLE_SIZE of 64"
+#endif
+
+/* Levels of the bands of each dog's bark, and how steady each band is. These
+ * come from the bark that the keys in 'key.c' were made from, at the levels
+ * and with the noise that 'replay-fft' adds to it, run through the same front
+ * end. The weights and threshold are worked out by the rule used for enrolling
+ * on the board (see 'enroll.h'): a band with variance v gets a weight of
+ * BAND_WEIGHT_ONE / (1 + v), and the threshold lets each band be off by twice
+ * its standard deviation, plus one, at its weight. The bands are only right for
+ * a 'SAMPLE_SIZE' of 64, so the band matcher cannot be built at any other
+ * size. */
+const band_key band_keys[] PROGMEM = {
+#if defined(USE_PREPROCESS) && defined(PREPROCESS_HAMMING)
+    {   1, 11,
+        { 18, 17, 13, 20, 16,  8,  3,  0,  1,  2 },
+        {  0,  1,  3,  0,  1,  4,  5,  7,  4,  5 } },
+    {   2,  7,
+        { 16, 19, 22, 23, 23, 19, 17,  1, 13,  0 },
+        {  1,  0,  0,  0,  0,  1,  2,  6,  1,  8 } },
+#elif defined(USE_PREPROCESS)
+    {   1, 13,
+        { 17, 17, 14, 19, 16,  9,  2,  0,  1,  2 },
+        {  1,  1,  3,  1,  1,  4,  5,  6,  5,  5 } },
+    {   2,  7,
+        { 18, 21, 24, 24, 21, 21, 17,  1, 14,  0 },
+        {  1,  0,  0,  0,  1,  0,  2,  6,  1,  8 } },
+#else
+    {   1, 14,
+        {  8,  8,  7, 15,  8,  4,  1,  0,  3,  4 },
+        {  3,  4,  3,  1,  4,  5,  6,  8,  4,  5 } },
+    {   2, 13,
+        {  8, 10, 12, 13, 13, 12, 10,  0, 11,  2 },
+        {  4,  3,  3,  2,  3,  1,  3,  8,  2,  6 } },
+#endif
+};
+
+const unsigned char num_band_keys = sizeof(band_keys) / sizeof(band_keys[0]);
+
+#endif
+
+
+/*
+ * band_normalize
+ *
+ * Description: Turns the levels of the bands into how far each one is below
+ *              the loudest band, so that the same bark gives the same levels
+ *              however loud it is.
+ *
+ * Arguments:   levels  The 'NUM_BANDS' levels to normalize, in place.
+ */
+static void band_normalize(unsigned char *levels)
+{
+    unsigned char b;
+    unsigned char loudest = 0;
+
+    for (b = 0; b < NUM_BANDS; b++)
+    {
+        if (levels[b] > loudest) {
+            loudest = levels[b];
+        }
+    }
+
+    for (b = 0; b < NUM_BANDS; b++)
+    {
+        levels[b] = loudest - levels[b];
+    }
+}
+
+
+/*
+ * band_levels
+ *
+ * Description: Adds up the power of the bins of a frequency spectrum into
+ *              bands and takes the level of each band. The block exponent from
+ *              the FFT is applied first, so the true power is used. Each level
+ *              is then given as how far the band is below the loudest one.
+ *
+ * Arguments:   data      The output of 'rfft'. This is put in natural order in
+ *                        place.
+ *              exponent  The block exponent returned by 'rfft'.
+ *              levels    Filled in with the 'NUM_BANDS' band levels.
+ *
+ * Notes:       The power of a bin is at most 2 * 128^2, and a band holds at
+ *              most 'SAMPLE_SIZE / 4' bins, so the sums fit in 32 bits.
+ */
+void band_levels(complex *data, unsigned char exponent,
+                 unsigned char *levels)
+{
+    unsigned char b;            /* Band being added up. */
+    unsigned int i;             /* Bin being added. */
+    unsigned int end;           /* First bin of the next band. */
+    unsigned long power;        /* Power of the band so far. */
+
+    /* Put the bins in natural order, so each band is a run of points. */
+    rfft_reorder(data);
+
+    i = pgm_read_word(&band_edge[0]);
+    for (b = 0; b < NUM_BANDS; b++)
+    {
+        end = pgm_read_word(&band_edge[b + 1]);
+        power = 0;
+        for (; i < end; i++)
+        {
+            power += (long)data[i].real * data[i].real
+                   + (long)data[i].imag * data[i].imag;
+        }
+
+        /* Bin SAMPLE_SIZE/2 is the imaginary part of the first point, and
+         * goes in the last band. */
+        if (b == NUM_BANDS - 1) {
+            power += (long)data[0].imag * data[0].imag;
+        }
+
+        levels[b] = ilog2_half(power, 2 * exponent);
+    }
+
+    band_normalize(levels);
+}
+
+
+/*
+ * band_levels_q15
+ *
+ * Description: Takes the band levels of a Q15 frequency spectrum. This works
+ *              just like 'band_levels', but the power is scaled back down to
+ *              the units of the 8-bit datapath, so the same keys can be used.
+ *
+ * Arguments:   data      The output of 'fft_q15'. This is put in natural order
+ *                        in place.
+ *              exponent  The block exponent returned by 'fft_q15'.
+ *              levels    Filled in with the 'NUM_BANDS' band levels.
+ *
+ * Notes:       The samples were shifted up by 8 bits, so the power is 16 bits
+ *              too large; 'Q15_BIN_SHIFT' of those bits are taken off of each
+ *              bin as it is added, and the rest with the shift of the log.
+ */
+void band_levels_q15(complex_q15 *data, unsigned char exponent,
+                     unsigned char *levels)
+{
+    unsigned char b;            /* Band being added up. */
+    unsigned int i;             /* Bin being added. */
+    unsigned int end;           /* Last bin of the band, plus one. */
+    unsigned long power;        /* Power of the band so far. */
+    signed char shift = 2 * exponent - (16 - Q15_BIN_SHIFT);
+
+    /* Put the bins in natural order, so each band is a run of points. */
+    fft_q15_reorder(data);
+
+    i = pgm_read_word(&band_edge[0]);
+    for (b = 0; b < NUM_BANDS; b++)
+    {
+        /* The full transform has bin SAMPLE_SIZE/2 in its own point, so it is
+         * just one more bin of the last band. */
+        end = pgm_read_word(&band_edge[b + 1]) + (b == NUM_BANDS - 1);
+        power = 0;
+        for (; i < end; i++)
+        {
+            power += ((unsigned long)((long)data[i].real * data[i].real) +
+                      (unsigned long)((long)data[i].imag * data[i].imag))
+                     >> Q15_BIN_SHIFT;
+        }
+
+        levels[b] = ilog2_half(power, shift);
+    }
+
+    band_normalize(levels);
+}
+
+
+#ifdef USE_BANDS
+/*
+ * band_search
+ *
+ * Description: Finds the dog whose band key is the best match for the levels
+ *              of a recording. The error for a dog is the sum over the bands of
+ *              the absolute difference in level times the weight of the band.
+ *              The dog with the smallest error wins, as long as the error is
+ *              below its threshold.
+ *
+ * Arguments:   levels  The 'NUM_BANDS' levels of the recording.
+ *
+ * Returns:     Returns the ID of the best matching dog, or 'NO_DOG' if no dog
+ *              matches.
+ *
+ * Notes:       Once the error for a dog reaches the best error so far (or its
+ *              threshold), the rest of its bands are skipped. If two dogs have
+ *              the same error, the first one in the table wins.
+ */
+unsigned char band_search(const unsigned char *levels)
+{
+    unsigned char d;                    /* Dog being checked. */
+    unsigned char b;                    /* Band being checked. */
+    unsigned int err;                   /* Error for this dog so far. */
+    unsigned int limit;                 /* Error this dog has to stay under. */
+    unsigned int best = 0xFFFF;         /* Error of the best dog so far. */
+    unsigned char bestid = NO_DOG;
+
+    for (d = 0; d < num_band_keys; d++)
+    {
+        /* The dog has to be under its threshold, and better than the best. */
+        limit = BAND_WEIGHT_ONE * pgm_read_byte(&band_keys[d].threshold);
+        if (best < limit) {
+            limit = best;
+        }
+
+        /* Add up the error, giving up as soon as the dog cannot win. */
+        err = 0;
+        for (b = 0; b < NUM_BANDS && err < limit; b++)
+        {
+            err += abs(levels[b] - pgm_read_byte(&band_keys[d].level[b])) *
+                   pgm_read_byte(&band_keys[d].weight[b]);
+        }
+
+        if (err < limit) {
+            best = err;
+            bestid = pgm_read_byte(&band_keys[d].id);
+        }
+    }
+
+    return bestid;
+}
+#endif
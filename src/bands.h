@@ -0,0 +1,125 @@
+/*
+ * bands.h
+ *
+ * Matching on the levels of log-spaced frequency bands.
+ *
+ * This file contains an interface for a matcher that works on a few bands of
+ * the spectrum instead of every bin. After the FFT, the power of the bins is
+ * added up into 'NUM_BANDS' bands. Like the mel scale, the bands are one bin
+ * wide at the bottom of the spectrum and half an octave wide above that, so
+ * the low bins, where a bark has most of its pitch, are kept apart, while the
+ * noisy high bins are pooled. The DC bin is left out, since it only holds the
+ * offset of the microphone. Each band is turned into a level in steps of half
+ * an octave of power (3 dB) with 'ilog2_half', which is much finer than the
+ * decades of 'ilog10'. The levels are then taken relative to the loudest band,
+ * so only the shape of the spectrum is matched, and a bark matches however
+ * close the dog is to the microphone.
+ *
+ * Each dog has a level and a weight for each band. The distance to a dog is
+ * the sum over the bands of the weight times the difference in level, so the
+ * bands that vary from bark to bark count for less. A match costs a few
+ * operations per band for each dog, rather than per bin, so many dogs can be
+ * checked in each window.
+ *
+ * This is only used if built with 'USE_BANDS' (see the 'MATCHER' variable in
+ * the Makefile).
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#ifndef _BANDS_H_
+#define _BANDS_H_
+
+
+#include "data.h"
+#include "progmem.h"
+
+
+/* Number of bands: two per octave from bin 1 up to bin SAMPLE_SIZE/2. Where
+ * half an octave is less than a bin, the bands are one bin wide instead. */
+#define NUM_BANDS           (2 * (LOG2_SAMPLE_SIZE - 1))
+
+/* Weight of a band that counts fully. The errors in 'band_search' are counted
+ * in units of 1 / BAND_WEIGHT_ONE. */
+#define BAND_WEIGHT_ONE     8
+
+
+/*
+ * band_key
+ *
+ * Description: Data type for one dog in the table of band keys.
+ *
+ * Members:     id         The ID of the dog; never 'NO_DOG'.
+ *              threshold  A recording matches this dog only if the weighted
+ *                         error over all of the bands is less than this, in
+ *                         half octaves.
+ *              level      How far each band of the bark is below the loudest
+ *                         band, in half octaves.
+ *              weight     How much each band counts toward the error, from 0 to
+ *                         'BAND_WEIGHT_ONE'.
+ */
+typedef struct _band_key {
+    unsigned char id;
+    unsigned char threshold;
+    unsigned char level[NUM_BANDS];
+    unsigned char weight[NUM_BANDS];
+} band_key;
+
+
+extern const band_key band_keys[] PROGMEM;  /* The enrolled dogs. */
+extern const unsigned char num_band_keys;   /* Number of entries. */
+
+
+/*
+ * band_levels
+ *
+ * Description: Adds up the power of the bins of a frequency spectrum into
+ *              bands and takes the level of each band. The block exponent from
+ *              the FFT is applied first, so the true power is used. Each level
+ *              is then given as how far the band is below the loudest one.
+ *
+ * Arguments:   data      The output of 'rfft'. This is put in natural order in
+ *                        place.
+ *              exponent  The block exponent returned by 'rfft'.
+ *              levels    Filled in with the 'NUM_BANDS' band levels.
+ */
+void band_levels(complex *data, unsigned char exponent,
+                 unsigned char *levels);
+
+/*
+ * band_levels_q15
+ *
+ * Description: Takes the band levels of a Q15 frequency spectrum. This works
+ *              just like 'band_levels', but the power is scaled back down to
+ *              the units of the 8-bit datapath, so the same keys can be used.
+ *
+ * Arguments:   data      The output of 'fft_q15'. This is put in natural order
+ *                        in place.
+ *              exponent  The block exponent returned by 'fft_q15'.
+ *              levels    Filled in with the 'NUM_BANDS' band levels.
+ */
+void band_levels_q15(complex_q15 *data, unsigned char exponent,
+                     unsigned char *levels);
+
+/*
+ * band_search
+ *
+ * Description: Finds the dog whose band key is the best match for the levels
+ *              of a recording. The error for a dog is the sum over the bands of
+ *              the absolute difference in level times the weight of the band.
+ *              The dog with the smallest error wins, as long as the error is
+ *              below its threshold.
+ *
+ * Arguments:   levels  The 'NUM_BANDS' levels of the recording.
+ *
+ * Returns:     Returns the ID of the best matching dog, or 'NO_DOG' if no dog
+ *              matches.
+ *
+ * Notes:       Once the error for a dog reaches the best error so far (or its
+ *              threshold), the rest of its bands are skipped.
+ */
+unsigned char band_search(const unsigned char *levels);
+
+
+#endif /* end of include guard: _BANDS_H_ */
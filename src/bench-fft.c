@@ -0,0 +1,491 @@
+/*
+ * bench-fft.c
+ *
+ * Benchmark for comparing the FFT datapaths.
+ *
+ * This file contains a host-side benchmark that runs the same input data
+ * through each of the FFTs: the 8-bit complex FFT with radix-2 and radix-4
+ * kernels, the 8-bit real-input FFT, and the Q15 FFT. For each one, it reports
+ * the average number of cycles taken per transform, and the signal-to-noise
+ * ratio of the output compared to a double-precision DFT of the same input.
+ * This can be used to decide whether the extra accuracy of the Q15 datapath is
+ * worth the extra memory and clocks for a given deployment.
+ *
+ * Usage:
+ *      bench-fft [-w timings | -r timings]
+ * With '-w', the times are also written to a file. With '-r', they are compared
+ * against the times in the file, and the cycles saved per FFT are printed. The
+ * Makefile uses this to compare against a build with the complex arithmetic
+ * as calls (see 'arith.h'), to show what inlining it saves.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Added the real-input FFT.
+ *      16 Oct 2026     agent               Compare radix-2 and radix-4.
+ *      16 Oct 2026     agent               Report the time saved against a
+ *                                          reference build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "data.h"
+#include "fft.h"
+
+
+/* Number of times each transform is run when timing it. */
+#define REPEAT      1000
+
+/* Number of different input data sets. */
+#define NUM_SETS    4
+
+/* Number of transforms being compared. */
+#define NUM_FFTS    4
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+
+/*
+ * now
+ *
+ * Description: Reads a free-running counter for timing the transforms. On x86
+ *              hosts this is the timestamp counter, so the result is in clock
+ *              cycles; elsewhere it falls back to a monotonic clock in
+ *              nanoseconds.
+ *
+ * Returns:     Returns the current value of the counter.
+ */
+static unsigned long long now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/*
+ * bitrev
+ *
+ * Description: Reverses the order of the low bits of an index. The FFT leaves
+ *              its output in bit-reversed order, so this is used to find where
+ *              each frequency bin ended up.
+ *
+ * Arguments:   i     The index to reverse.
+ *              bits  The number of bits to reverse.
+ *
+ * Returns:     Returns the bit-reversed index.
+ */
+static unsigned int bitrev(unsigned int i, unsigned int bits)
+{
+    unsigned int r = 0;
+    unsigned int b;
+
+    for (b = 0; b < bits; b++)
+    {
+        r = (r << 1) | (i & 1);
+        i >>= 1;
+    }
+
+    return r;
+}
+
+/*
+ * make_input
+ *
+ * Description: Fills in one of the test data sets. All of the sets fit in the
+ *              range of a signed char, so exactly the same input can be given
+ *              to every datapath.
+ *
+ * Arguments:   set  Which data set to generate.
+ *              x    Array of 'SAMPLE_SIZE' values to fill in.
+ *
+ * Returns:     Returns the name of the data set.
+ */
+static const char *make_input(int set, double *x)
+{
+    unsigned long seed = 12345;
+    unsigned int i;
+
+    for (i = 0; i < SAMPLE_SIZE; i++)
+    {
+        double t = (double)i / SAMPLE_SIZE;
+
+        switch (set)
+        {
+        case 0:
+            /* Two tones at different amplitudes. */
+            x[i] = floor(80 * cos(2 * M_PI * 5 * t)
+                       + 30 * sin(2 * M_PI * 13 * t) + 0.5);
+            break;
+        case 1:
+            /* Full-scale pseudo-random noise. */
+            seed = seed * 1103515245UL + 12345UL;
+            x[i] = (double)((int)((seed >> 16) & 0xFF) - 128);
+            break;
+        case 2:
+            /* A decaying harmonic burst, something like a bark. */
+            x[i] = floor(100 * exp(-4 * t) * (sin(2 * M_PI * 3 * t)
+                       + 0.5 * sin(2 * M_PI * 6 * t)
+                       + 0.25 * sin(2 * M_PI * 9 * t)) + 0.5);
+            break;
+        default:
+            /* A single quiet tone, to show what happens with small inputs. */
+            x[i] = floor(8 * cos(2 * M_PI * 7 * t) + 0.5);
+            break;
+        }
+    }
+
+    switch (set)
+    {
+    case 0:
+        return "tones";
+    case 1:
+        return "noise";
+    case 2:
+        return "burst";
+    default:
+        return "quiet";
+    }
+}
+
+/*
+ * dft
+ *
+ * Description: Computes the reference transform of the input in double
+ *              precision, using the same sign convention as 'fft'.
+ *
+ * Arguments:   x   The 'SAMPLE_SIZE' input values.
+ *              re  Array to fill in with the real part of each bin.
+ *              im  Array to fill in with the imaginary part of each bin.
+ */
+static void dft(const double *x, double *re, double *im)
+{
+    unsigned int k, n;
+
+    for (k = 0; k < SAMPLE_SIZE; k++)
+    {
+        re[k] = 0;
+        im[k] = 0;
+
+        for (n = 0; n < SAMPLE_SIZE; n++)
+        {
+            double a = 2 * M_PI * (double)((k * n) % SAMPLE_SIZE) / SAMPLE_SIZE;
+
+            re[k] += x[n] * cos(a);
+            im[k] += x[n] * sin(a);
+        }
+    }
+}
+
+/*
+ * snr
+ *
+ * Description: Computes the signal-to-noise ratio of a transform against the
+ *              reference.
+ *
+ * Arguments:   re, im      The reference transform, in natural order.
+ *              outre, outim The transform to check, in natural order and
+ *                          already scaled back to the units of the input.
+ *              bins        The number of bins to compare.
+ *
+ * Returns:     Returns the SNR in dB.
+ */
+static double snr(const double *re, const double *im,
+                  const double *outre, const double *outim, unsigned int bins)
+{
+    double sig = 0, err = 0;
+    unsigned int k;
+
+    for (k = 0; k < bins; k++)
+    {
+        sig += re[k] * re[k] + im[k] * im[k];
+        err += (re[k] - outre[k]) * (re[k] - outre[k])
+             + (im[k] - outim[k]) * (im[k] - outim[k]);
+    }
+
+    /* A perfect match would divide by zero; report something large. */
+    if (err == 0) {
+        return 999.0;
+    }
+
+    return 10 * log10(sig / err);
+}
+
+
+/*
+ * bench_complex
+ *
+ * Description: Times one of the 8-bit complex transforms on an input data set
+ *              and checks its accuracy.
+ *
+ * Arguments:   kernel  The transform to run.
+ *              x       The 'SAMPLE_SIZE' input values.
+ *              re, im  The reference transform of the input.
+ *              db      Filled in with the SNR of the output, in dB.
+ *
+ * Returns:     Returns the average time per transform.
+ */
+static unsigned long long bench_complex(unsigned char (*kernel)(complex *),
+                                        const double *x, const double *re,
+                                        const double *im, double *db)
+{
+    static complex buf[SAMPLE_SIZE];
+    static double outre[SAMPLE_SIZE], outim[SAMPLE_SIZE];
+    unsigned long long start, total = 0;
+    unsigned char exponent = 0;
+    unsigned int i, k;
+    int r;
+
+    /* Time the transform, restoring the input each time. */
+    for (r = 0; r < REPEAT; r++)
+    {
+        for (i = 0; i < SAMPLE_SIZE; i++)
+        {
+            buf[i].real = (char)x[i];
+            buf[i].imag = 0;
+        }
+
+        start = now();
+        exponent = kernel(buf);
+        total += now() - start;
+    }
+
+    /* Put the output back in order and check it. */
+    for (k = 0; k < SAMPLE_SIZE; k++)
+    {
+        outre[k] = ldexp(buf[bitrev(k, LOG2_SAMPLE_SIZE)].real, exponent);
+        outim[k] = ldexp(buf[bitrev(k, LOG2_SAMPLE_SIZE)].imag, exponent);
+    }
+    *db = snr(re, im, outre, outim, SAMPLE_SIZE);
+
+    return total / REPEAT;
+}
+
+/*
+ * bench_real
+ *
+ * Description: Times the 8-bit real-input transform on an input data set and
+ *              checks its accuracy. Only the unique half of the spectrum is
+ *              checked.
+ *
+ * Arguments:   x       The 'SAMPLE_SIZE' input values.
+ *              re, im  The reference transform of the input.
+ *              db      Filled in with the SNR of the output, in dB.
+ *
+ * Returns:     Returns the average time per transform.
+ */
+static unsigned long long bench_real(const double *x, const double *re,
+                                     const double *im, double *db)
+{
+    static complex buf[SAMPLE_SIZE / 2];
+    static double outre[SAMPLE_SIZE], outim[SAMPLE_SIZE];
+    unsigned long long start, total = 0;
+    unsigned char exponent = 0;
+    unsigned int i, k;
+    int r;
+
+    /* Time the transform on the same input, packed two samples per point. */
+    for (r = 0; r < REPEAT; r++)
+    {
+        for (i = 0; i < SAMPLE_SIZE / 2; i++)
+        {
+            buf[i].real = (char)x[2*i];
+            buf[i].imag = (char)x[2*i + 1];
+        }
+
+        start = now();
+        exponent = rfft(buf);
+        total += now() - start;
+    }
+
+    /* The last bin is packed into the first point. */
+    outre[0] = ldexp(buf[0].real, exponent);
+    outim[0] = 0;
+    outre[SAMPLE_SIZE / 2] = ldexp(buf[0].imag, exponent);
+    outim[SAMPLE_SIZE / 2] = 0;
+    for (k = 1; k < SAMPLE_SIZE / 2; k++)
+    {
+        outre[k] = ldexp(buf[bitrev(k, LOG2_SAMPLE_SIZE - 1)].real, exponent);
+        outim[k] = ldexp(buf[bitrev(k, LOG2_SAMPLE_SIZE - 1)].imag, exponent);
+    }
+    *db = snr(re, im, outre, outim, SAMPLE_SIZE / 2 + 1);
+
+    return total / REPEAT;
+}
+
+/*
+ * bench_q15
+ *
+ * Description: Times the Q15 transform on an input data set and checks its
+ *              accuracy.
+ *
+ * Arguments:   x       The 'SAMPLE_SIZE' input values.
+ *              re, im  The reference transform of the input.
+ *              db      Filled in with the SNR of the output, in dB.
+ *
+ * Returns:     Returns the average time per transform.
+ */
+static unsigned long long bench_q15(const double *x, const double *re,
+                                    const double *im, double *db)
+{
+    static complex_q15 buf[SAMPLE_SIZE];
+    static double outre[SAMPLE_SIZE], outim[SAMPLE_SIZE];
+    unsigned long long start, total = 0;
+    unsigned char exponent = 0;
+    unsigned int i, k;
+    int r;
+
+    /* Time the transform on the same input, shifted up by 8 bits. */
+    for (r = 0; r < REPEAT; r++)
+    {
+        for (i = 0; i < SAMPLE_SIZE; i++)
+        {
+            buf[i].real = (short)x[i] * 256;
+            buf[i].imag = 0;
+        }
+
+        start = now();
+        exponent = fft_q15(buf);
+        total += now() - start;
+    }
+
+    /* Undo the shift while putting the output back in order. */
+    for (k = 0; k < SAMPLE_SIZE; k++)
+    {
+        outre[k] = ldexp(buf[bitrev(k, LOG2_SAMPLE_SIZE)].real, exponent - 8);
+        outim[k] = ldexp(buf[bitrev(k, LOG2_SAMPLE_SIZE)].imag, exponent - 8);
+    }
+    *db = snr(re, im, outre, outim, SAMPLE_SIZE);
+
+    return total / REPEAT;
+}
+
+
+/*
+ * main
+ *
+ * Description: Runs each data set through each transform, timing them and
+ *              checking their accuracy. The results are printed to stdout as a
+ *              table. The times can also be written out, or compared with the
+ *              times written out by another build.
+ *
+ * Returns:     Returns 0 on successful completion, or -1 if an error occurs.
+ */
+int main(int argc, char *argv[])
+{
+    static double x[SAMPLE_SIZE];
+    static double re[SAMPLE_SIZE], im[SAMPLE_SIZE];
+    unsigned long long t[NUM_SETS][NUM_FFTS];
+    unsigned long long ref[NUM_SETS][NUM_FFTS];
+    double db[NUM_FFTS];
+    const char *names[NUM_SETS];
+    const char *write = NULL, *compare = NULL;
+    FILE *file;
+    int set, f;
+
+
+    /* Read the options. */
+    if (argc == 3 && strcmp(argv[1], "-w") == 0) {
+        write = argv[2];
+    }
+    else if (argc == 3 && strcmp(argv[1], "-r") == 0) {
+        compare = argv[2];
+    }
+    else if (argc != 1) {
+        fprintf(stderr, "usage: %s [-w timings | -r timings]\n", argv[0]);
+        return -1;
+    }
+
+    printf("%d-point FFT, %d runs per set (%s per FFT, SNR in dB)\n",
+           SAMPLE_SIZE, REPEAT,
+#if defined(__x86_64__) || defined(__i386__)
+           "cycles"
+#else
+           "ns"
+#endif
+           );
+    printf("%-8s %10s %10s %10s %10s %7s %7s %7s %7s\n", "set", "radix-2",
+           "radix-4", "real", "q15", "r2 dB", "r4 dB", "real dB", "q15 dB");
+
+    for (set = 0; set < NUM_SETS; set++)
+    {
+        names[set] = make_input(set, x);
+        dft(x, re, im);
+
+        t[set][0] = bench_complex(fft_radix2, x, re, im, &db[0]);
+        t[set][1] = bench_complex(fft, x, re, im, &db[1]);
+        t[set][2] = bench_real(x, re, im, &db[2]);
+        t[set][3] = bench_q15(x, re, im, &db[3]);
+
+        printf("%-8s", names[set]);
+        for (f = 0; f < NUM_FFTS; f++) {
+            printf(" %10llu", t[set][f]);
+        }
+        for (f = 0; f < NUM_FFTS; f++) {
+            printf(" %7.1f", db[f]);
+        }
+        printf("\n");
+    }
+
+    /* Save the times, one line per set. */
+    if (write != NULL) {
+        file = fopen(write, "w");
+        if (file == NULL) {
+            perror(write);
+            return -1;
+        }
+        for (set = 0; set < NUM_SETS; set++)
+        {
+            fprintf(file, "%s %llu %llu %llu %llu\n", names[set], t[set][0],
+                    t[set][1], t[set][2], t[set][3]);
+        }
+        fclose(file);
+    }
+
+    /* Print how much faster each transform is than in the other build. */
+    if (compare != NULL) {
+        file = fopen(compare, "r");
+        if (file == NULL) {
+            perror(compare);
+            return -1;
+        }
+        for (set = 0; set < NUM_SETS; set++)
+        {
+            if (fscanf(file, "%*s %llu %llu %llu %llu", &ref[set][0],
+                       &ref[set][1], &ref[set][2], &ref[set][3]) != 4) {
+                fprintf(stderr, "%s: missing times\n", compare);
+                fclose(file);
+                return -1;
+            }
+        }
+        fclose(file);
+
+        printf("\nsaved per FFT against %s\n", compare);
+        for (set = 0; set < NUM_SETS; set++)
+        {
+            printf("%-8s", names[set]);
+            for (f = 0; f < NUM_FFTS; f++) {
+                printf(" %10lld", (long long)(ref[set][f] - t[set][f]));
+            }
+            for (f = 0; f < NUM_FFTS; f++) {
+                printf(" %6.1f%%", 100.0 * ((double)ref[set][f] - t[set][f]) /
+                                   ref[set][f]);
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
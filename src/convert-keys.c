@@ -0,0 +1,176 @@
+/*
+ * convert-keys.c
+ *
+ * This file contains a tool for converting a table of keys recorded in the old
+ * order, the bit-reversed order that 'rfft' leaves its output in, to natural
+ * order, which is what the matchers use now. It reads a copy of 'key.c' on the
+ * standard input and writes it back out to the standard output with the
+ * values in every 'KEY_PAIR' put in the new order. Everything else in the file
+ * is copied as it is, so the result can go straight back into 'key.c':
+ *
+ *      ./convert-keys < old-key.c > key.c
+ *
+ * This only needs to be run once on any table of keys, and must be built with
+ * the same 'SAMPLE_SIZE' that the keys were recorded with. Swapping the bins
+ * into bit-reversed positions undoes itself, so running it again on keys that
+ * are already in natural order puts them back in the old order.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "key.h"
+
+
+/* Values in the pairs of one key, including the padding after an odd bin. */
+#define KEY_VALUES  (2 * ((KEY_BINS + 1) / 2))
+
+/* Where the pairs of bins start in the file. */
+#define PAIR_NAME   "KEY_PAIR("
+
+
+/*
+ * bitreverse
+ *
+ * Description: Reverses the order of the low bits of a number.
+ *
+ * Arguments:   x     The number to reverse.
+ *              bits  The number of low bits to reverse.
+ *
+ * Returns:     Returns the low 'bits' bits of 'x' in reverse order.
+ */
+static unsigned int bitreverse(unsigned int x, unsigned int bits)
+{
+    unsigned int out = 0;
+    unsigned int i;
+
+    for (i = 0; i < bits; i++)
+    {
+        out = (out << 1) | ((x >> i) & 1);
+    }
+
+    return out;
+}
+
+
+/*
+ * read_all
+ *
+ * Description: Reads all of the standard input into memory.
+ *
+ * Arguments:   len  Filled in with the number of characters read.
+ *
+ * Returns:     Returns the text, ending with a null character, or NULL if there
+ *              is not enough memory.
+ */
+static char *read_all(size_t *len)
+{
+    size_t size = 4096;
+    char *text = malloc(size);
+    char *bigger;
+    size_t got;
+
+    *len = 0;
+    while (text != NULL)
+    {
+        got = fread(text + *len, 1, size - *len - 1, stdin);
+        *len += got;
+        if (got == 0) {
+            text[*len] = '\0';
+            break;
+        }
+
+        if (*len == size - 1) {
+            size *= 2;
+            bigger = realloc(text, size);
+            if (bigger == NULL) {
+                free(text);
+            }
+            text = bigger;
+        }
+    }
+
+    return text;
+}
+
+
+/*
+ * main
+ *
+ * Description: Reads the old table of keys, puts the values of each key in
+ *              natural order, and writes the table back out. The old value at
+ *              position p is bin p reversed over 'LOG2_SAMPLE_SIZE - 1' bits,
+ *              except for the last bin (SAMPLE_SIZE/2) and the padding, which
+ *              stay where they are.
+ *
+ * Arguments:   None.
+ *
+ * Returns:     Returns 0 if the keys were converted, 1 if the input did not
+ *              hold a whole number of keys.
+ */
+int main(void)
+{
+    char *text;             /* The whole input. */
+    size_t len;
+    char *pos, *end;        /* Position in the input. */
+    long *vals;             /* Every value in every pair, in order. */
+    long *key;              /* Values of the key being converted. */
+    long old[KEY_VALUES];
+    size_t nvals = 0;
+    size_t i;
+    unsigned int k;
+
+
+    text = read_all(&len);
+    vals = malloc((len / 2 + 1) * sizeof(long));
+    if (text == NULL || vals == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* Collect the values of all of the pairs. */
+    for (pos = strstr(text, PAIR_NAME); pos != NULL;
+         pos = strstr(pos, PAIR_NAME))
+    {
+        pos += strlen(PAIR_NAME);
+        vals[nvals++] = strtol(pos, &end, 0);
+        pos = end + strspn(end, ", \t\r\n");
+        vals[nvals++] = strtol(pos, &end, 0);
+        pos = end;
+    }
+
+    if (nvals == 0 || nvals % KEY_VALUES != 0) {
+        fprintf(stderr, "found %lu values, which is not a whole number of "
+                "%u-bin keys\n", (unsigned long)nvals, KEY_BINS);
+        return 1;
+    }
+
+    /* Put each key in natural order. */
+    for (key = vals; key < vals + nvals; key += KEY_VALUES)
+    {
+        memcpy(old, key, sizeof(old));
+        for (k = 0; k < SAMPLE_SIZE / 2; k++) {
+            key[k] = old[bitreverse(k, LOG2_SAMPLE_SIZE - 1)];
+        }
+    }
+
+    /* Write the input back out with the new values in the pairs. */
+    pos = text;
+    for (i = 0; i < nvals; i += 2)
+    {
+        end = strstr(pos, PAIR_NAME);
+        fwrite(pos, 1, end - pos, stdout);
+        printf("%s%ld, %ld)", PAIR_NAME, vals[i], vals[i + 1]);
+        pos = strchr(end, ')') + 1;
+    }
+    fputs(pos, stdout);
+
+    free(vals);
+    free(text);
+
+    return 0;
+}
@@ -3,69 +3,205 @@
  *
  * Data types and constants for analyzing a frequency spectrum.
  *
- * This file describes the complex number data type, as well as functions for
- * adding and multiplying complex numbers. Constants for determining the number
- * of samples to use are also defined here.
+ * This file contains the integer logs used to compare spectra. The arithmetic
+ * on complex numbers is inline, in 'arith.h'.
  *
  * Revision History:
  *      16 Apr 2015     Brian Kubisiak      Initial revision.
+ *      16 Oct 2026     agent               Rescale products in 'mul'.
+ *      16 Oct 2026     agent               Added Q15 arithmetic.
+ *      16 Oct 2026     agent               Added 'sub'.
+ *      16 Oct 2026     agent               Added 'ilog10'.
+ *      16 Oct 2026     agent               Added 'ilog2_half'.
+ *      16 Oct 2026     agent               Moved the complex arithmetic inline
+ *                                          into 'arith.h'.
+ *      16 Oct 2026     agent               Log table in program memory.
  */
 
 #include "data.h"
+#include "progmem.h"
 
 
 
 /*
- * add
+ * Table for 'ilog10'. Entry e covers the numbers v with floor(log2(v)) = e.
+ * 'digits' is floor(log10(2^e)), and 'thresh' is the smallest 32-bit mantissa
+ * (top bit set) for which v reaches the next power of ten, or 0 if there is no
+ * power of ten between 2^e and 2^(e+1). The compiler fills in the entries from
+ * the macros below; (e * 1233) >> 12 is exactly floor(e * log10(2)) for e < 64.
+ */
+#define LOG_TABLE_SIZE  64
+
+#define LOG10_POW2(e)   (((e) * 1233) >> 12)
+
+#define POW10(d)        ((d) ==  0 ? 1ULL :                                    \
+                         (d) ==  1 ? 10ULL :                                   \
+                         (d) ==  2 ? 100ULL :                                  \
+                         (d) ==  3 ? 1000ULL :                                 \
+                         (d) ==  4 ? 10000ULL :                                \
+                         (d) ==  5 ? 100000ULL :                               \
+                         (d) ==  6 ? 1000000ULL :                              \
+                         (d) ==  7 ? 10000000ULL :                             \
+                         (d) ==  8 ? 100000000ULL :                            \
+                         (d) ==  9 ? 1000000000ULL :                           \
+                         (d) == 10 ? 10000000000ULL :                          \
+                         (d) == 11 ? 100000000000ULL :                         \
+                         (d) == 12 ? 1000000000000ULL :                        \
+                         (d) == 13 ? 10000000000000ULL :                       \
+                         (d) == 14 ? 100000000000000ULL :                      \
+                         (d) == 15 ? 1000000000000000ULL :                     \
+                         (d) == 16 ? 10000000000000000ULL :                    \
+                         (d) == 17 ? 100000000000000000ULL :                   \
+                         (d) == 18 ? 1000000000000000000ULL :                  \
+                                     10000000000000000000ULL)
+
+/* The first power of ten above 2^e. */
+#define NEXT_POW10(e)   POW10(LOG10_POW2(e) + 1)
+
+/* The power of ten as a mantissa for 2^e, rounded up (the shift counts are
+ * masked so the branch that is not taken still has a legal shift). */
+#define LOG_THRESH(e)   ((NEXT_POW10(e) >> (e)) > 1 ? 0UL :                    \
+                         (e) <= 31 ?                                           \
+                         (unsigned long)(NEXT_POW10(e) << ((31 - (e)) & 63)) : \
+                         (unsigned long)((NEXT_POW10(e) +                      \
+                                          (1ULL << (((e) - 31) & 63)) - 1) >>  \
+                                         (((e) - 31) & 63)))
+
+#define LOG_ENTRY(e)    { LOG10_POW2(e), LOG_THRESH(e) }
+#define LOG_ENTRY4(e)   LOG_ENTRY(e), LOG_ENTRY((e) + 1),                      \
+                        LOG_ENTRY((e) + 2), LOG_ENTRY((e) + 3)
+#define LOG_ENTRY16(e)  LOG_ENTRY4(e), LOG_ENTRY4((e) + 4),                    \
+                        LOG_ENTRY4((e) + 8), LOG_ENTRY4((e) + 12)
+
+/* The square root of 2 as a 32-bit mantissa (top bit set), rounded up. A
+ * normalized magnitude at least this large is in the upper half of its
+ * octave. */
+#define SQRT2_MANTISSA  0xB504F334UL
+
+static const struct {
+    unsigned char digits;       /* floor(log10(2^e)) */
+    unsigned long thresh;       /* Mantissa of the next power of ten, or 0. */
+} log_table[LOG_TABLE_SIZE] PROGMEM = {
+    LOG_ENTRY16(0), LOG_ENTRY16(16), LOG_ENTRY16(32), LOG_ENTRY16(48)
+};
+
+
+
+/*
+ * ilog10
+ *
+ * Description: Computes the integer part of the base-10 log of a magnitude
+ *              that has been scaled by a power of two, using only integer
+ *              operations. This gives the same result as
+ *              '(char)log10(ldexp(mag, shift))' without any floating point.
  *
- * Description: Adds together two complex numbers in the Cartesian plane.
+ * Arguments:   mag    The magnitude to take the log of. Only the low 32 bits
+ *                     are used.
+ *              shift  The power of two to scale 'mag' by before taking the
+ *                     log. This may be negative.
  *
- * Arguments:   a  The first number to add.
- *              b  The second number to add.
+ * Returns:     Returns floor(log10(mag * 2^shift)). If the scaled magnitude is
+ *              less than 1 (including when 'mag' is 0), returns 0, and if it
+ *              is 2^64 or more, returns 19, which is floor(log10(2^64)).
  *
- * Returns:     Returns the complex number that is the sum of the two inputs.
+ * Notes:       The leading zero count gives floor(log2()) of the value, which
+ *              picks the table entry. Each octave holds at most one power of
+ *              ten, so a single compare of the normalized magnitude against
+ *              the entry's threshold finishes the job.
  */
-complex add(complex a, complex b)
+unsigned char ilog10(unsigned long mag, signed char shift)
 {
-    complex res;
+    unsigned char zeros;        /* Leading zeros in the low 32 bits. */
+    int e;                      /* floor(log2(mag * 2^shift)) */
+    unsigned char digits;       /* Result to return. */
+    unsigned long thresh;       /* Threshold from the table. */
+
+    mag &= 0xFFFFFFFFUL;
+
+    /* The log of 0 is undefined; treat it like any other tiny value. */
+    if (mag == 0) {
+        return 0;
+    }
+
+    /* Count the leading zeros, ignoring any bits above the low 32. */
+    zeros = __builtin_clzl(mag) - (8 * sizeof(unsigned long) - 32);
+
+    /* Values below 1 have a negative log, which is clamped to 0. */
+    e = 31 - zeros + shift;
+    if (e < 0) {
+        return 0;
+    }
 
-    /* Real part of result is sum of real parts of inputs. */
-    res.real = a.real + b.real;
-    /* Imaginary part of result is sum of imaginary parts of inputs. */
-    res.imag = a.imag + b.imag;
+    /* Anything past the table is far larger than any key value, so it is
+     * clamped to the log of the end of the table. */
+    if (e >= LOG_TABLE_SIZE) {
+        return LOG10_POW2(LOG_TABLE_SIZE);
+    }
 
-    return res;
+    digits = pgm_read_byte(&log_table[e].digits);
+    thresh = pgm_read_dword(&log_table[e].thresh);
+
+    /* Normalize the magnitude so the top bit is set, then check whether it is
+     * past the power of ten in this octave. */
+    if (thresh != 0 && ((mag << zeros) & 0xFFFFFFFFUL) >= thresh) {
+        digits++;
+    }
+
+    return digits;
 }
 
 
 /*
- * mul
+ * ilog2_half
  *
- * Description: Computes the product of two complex numbers in the Cartesian
- *              plane.
+ * Description: Computes the base-2 log of a magnitude that has been scaled by
+ *              a power of two, in steps of half an octave (3 dB of power),
+ *              using only integer operations. This gives the same result as
+ *              'floor(2 * log2(ldexp(mag, shift)))' without any floating point.
  *
- * Arguments:   a  First number to multiply.
- *              b  Second number to multiply.
+ * Arguments:   mag    The magnitude to take the log of. Only the low 32 bits
+ *                     are used.
+ *              shift  The power of two to scale 'mag' by before taking the
+ *                     log. This may be negative.
  *
- * Returns:     Returns the complex number that is the product of the two
- *              inputs.
+ * Returns:     Returns floor(2 log2(mag * 2^shift)), clamped to 0 to 255. If
+ *              the scaled magnitude is less than 1 (including when 'mag' is
+ *              0), returns 0.
  *
- * Notes:       The number is stored in rectangular coordinates, so taking the
- *              product will be a bit slow.
+ * Notes:       Just like 'ilog10', the leading zero count gives the octave.
+ *              The half of the octave comes from comparing the normalized
+ *              magnitude against the square root of 2, so no table is needed.
  */
-complex mul(complex a, complex b)
+unsigned char ilog2_half(unsigned long mag, signed char shift)
 {
-    complex res;
+    unsigned char zeros;        /* Leading zeros in the low 32 bits. */
+    int e;                      /* floor(log2(mag * 2^shift)) */
 
-    /* (a + jb)(c + jd) = ac + jad + jbc + j^2 cd = (ac - cd) + j(ad + bc) */
+    mag &= 0xFFFFFFFFUL;
 
-    /* Real part of result comes from product of real parts minus product of
-     * imaginary parts. */
-    res.real = (a.real * b.real) - (a.imag * b.imag);
-    /* Imaginary part is sum of cross products of inputs. */
-    res.imag = (a.real * b.imag) + (a.imag * b.real);
+    /* The log of 0 is undefined; treat it like any other tiny value. */
+    if (mag == 0) {
+        return 0;
+    }
 
-    return res;
-}
+    zeros = __builtin_clzl(mag) - (8 * sizeof(unsigned long) - 32);
 
+    /* Values below 1 have a negative log, which is clamped to 0, and values
+     * past 2^127 do not fit in the result. */
+    e = 31 - zeros + shift;
+    if (e < 0) {
+        return 0;
+    }
+    if (e > 127) {
+        return 255;
+    }
 
+    /* Count whole octaves twice, and add one if the magnitude is past the
+     * middle of its octave. */
+    e *= 2;
+    if (((mag << zeros) & 0xFFFFFFFFUL) >= SQRT2_MANTISSA) {
+        e++;
+    }
+
+    return e;
+}
@@ -3,13 +3,25 @@
  *
  * Data types and constants for analyzing a frequency spectrum.
  *
- * This file describes the complex number data type, as well as functions for
- * adding and multiplying complex numbers. Constants for determining the number
- * of samples to use are also defined here.
+ * This file describes the complex number data type, and functions for taking
+ * integer logs of magnitudes. The arithmetic on complex numbers is in
+ * 'arith.h'. Constants for determining the number of samples to use are also
+ * defined here.
  *
  * Revision History:
  *      16 Apr 2015     Brian Kubisiak      Initial revision.
  *      04 Jun 2015     Brian Kubisiak      Changes to SAMPLE_SIZE macro.
+ *      16 Oct 2026     agent               Rescale products in 'mul'.
+ *      16 Oct 2026     agent               Added Q15 complex data type.
+ *      16 Oct 2026     agent               Added SAMPLE_POINTS.
+ *      16 Oct 2026     agent               Added 'sub'.
+ *      16 Oct 2026     agent               Added 'ilog10'.
+ *      16 Oct 2026     agent               Added 'bitrev_index'.
+ *      16 Oct 2026     agent               Added 'ilog2_half'.
+ *      16 Oct 2026     agent               16-bit 'bitrev_index' on hosts too.
+ *      16 Oct 2026     agent               Moved the complex arithmetic inline
+ *                                          into 'arith.h'.
+ *      16 Oct 2026     agent               Added 'ring_sample'.
  */
 
 #ifndef _DATA_H_
@@ -40,34 +52,111 @@ typedef struct _complex {
 
 
 /*
- * add
+ * complex_q15
  *
- * Description: Adds together two complex numbers in the Cartesian plane.
+ * Description: Data type for holding a complex number with 16-bit parts. Each
+ *              part is a Q15 fixed-point fraction, so 32767 is just under 1.0.
+ *              This takes twice the memory of 'complex', but keeps 8 more bits
+ *              of precision through the FFT.
  *
- * Arguments:   a  The first number to add.
- *              b  The second number to add.
+ * Members:     real  The real part of the complex number.
+ *              imag  The imaginary part of the complex number.
+ */
+typedef struct _complex_q15 {
+    short real;
+    short imag;
+} complex_q15;
+
+
+/*
+ * bitrev_index
+ *
+ * Description: Data type for an entry of the table of bit-reversed positions.
+ *              A byte is enough for up to 256 points; larger transforms need
+ *              16 bits, which are read with 'pgm_read_word' on every target.
+ */
+#if SAMPLE_SIZE <= 256
+typedef unsigned char bitrev_index;
+#else
+typedef unsigned short bitrev_index;
+#endif
+
+
+/*
+ * sample
+ *
+ * Description: Data type for the points collected by the ADC and transformed
+ *              by the main loop. This is 'complex' for the 8-bit datapath, or
+ *              'complex_q15' when the code is built with 'USE_Q15' defined
+ *              (see the 'DATAPATH' variable in the Makefile).
  *
- * Returns:     Returns the complex number that is the sum of the two inputs.
+ * Notes:       The 8-bit datapath uses the real-input FFT, so two samples are
+ *              packed into each point and the buffer only needs
+ *              'SAMPLE_SIZE / 2' points. The Q15 datapath stores one sample
+ *              per point. 'SAMPLE_POINTS' is the number of points either way.
  */
-complex add(complex a, complex b);
+#ifdef USE_Q15
+typedef complex_q15 sample;
+#define SAMPLE_POINTS       SAMPLE_SIZE
+#else
+typedef complex sample;
+#define SAMPLE_POINTS       (SAMPLE_SIZE / 2)
+#endif
+
+
+/*
+ * ring_sample
+ *
+ * Description: Data type for a sample in the ring of the streaming capture
+ *              (see 'ADC_STREAM'). This is 8 bits for the 8-bit datapath, or
+ *              a 16-bit Q15 fraction for the Q15 datapath, so that the bits
+ *              below the top 8 from the ADC and the front end are kept.
+ */
+#ifdef USE_Q15
+typedef short ring_sample;
+#else
+typedef char ring_sample;
+#endif
 
 
 /*
- * mul
+ * ilog10
  *
- * Description: Computes the product of two complex numbers in the Cartesian
- *              plane.
+ * Description: Computes the integer part of the base-10 log of a magnitude
+ *              that has been scaled by a power of two, using only integer
+ *              operations. This gives the same result as
+ *              '(char)log10(ldexp(mag, shift))' without any floating point.
+ *
+ * Arguments:   mag    The magnitude to take the log of. Only the low 32 bits
+ *                     are used.
+ *              shift  The power of two to scale 'mag' by before taking the
+ *                     log. This may be negative.
+ *
+ * Returns:     Returns floor(log10(mag * 2^shift)). If the scaled magnitude is
+ *              less than 1 (including when 'mag' is 0), returns 0, and if it
+ *              is 2^64 or more, returns 19, which is floor(log10(2^64)).
+ */
+unsigned char ilog10(unsigned long mag, signed char shift);
+
+
+/*
+ * ilog2_half
  *
- * Arguments:   a  First number to multiply.
- *              b  Second number to multiply.
+ * Description: Computes the base-2 log of a magnitude that has been scaled by
+ *              a power of two, in steps of half an octave (3 dB of power),
+ *              using only integer operations. This gives the same result as
+ *              'floor(2 * log2(ldexp(mag, shift)))' without any floating point.
  *
- * Returns:     Returns the complex number that is the product of the two
- *              inputs.
+ * Arguments:   mag    The magnitude to take the log of. Only the low 32 bits
+ *                     are used.
+ *              shift  The power of two to scale 'mag' by before taking the
+ *                     log. This may be negative.
  *
- * Notes:       The number is stored in rectangular coordinates, so taking the
- *              product will be a bit slow.
+ * Returns:     Returns floor(2 log2(mag * 2^shift)), clamped to 0 to 255. If
+ *              the scaled magnitude is less than 1 (including when 'mag' is
+ *              0), returns 0.
  */
-complex mul(complex a, complex b);
+unsigned char ilog2_half(unsigned long mag, signed char shift);
 
 
 
@@ -0,0 +1,281 @@
+/*
+ * dtw.c
+ *
+ * Matching whole barks over several windows with dynamic time warping.
+ *
+ * This file contains code for matching the band levels of consecutive windows
+ * against a table of bark templates. For each template, the newest column of
+ * the cost matrix is kept, along with the window that the best path to each
+ * cell started at. Each new window i updates the column in place, down the
+ * frames j of the template:
+ *      D[i][j] = d(i, j) + min(D[i][j-1], D[i-1][j], D[i-1][j-1])
+ * where d(i, j) is the weighted distance between the window and the frame.
+ * Before the first frame, D is taken to be 0 for every window, so that a path
+ * can start anywhere. A cell is only reached from a neighbor whose path keeps
+ * it within 'DTW_BAND' of the diagonal from where the path started. Nothing in
+ * here is used without 'USE_DTW'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Only build the templates for the
+ *                                          window size they were made at.
+ *      16 Oct 2026     agent               Added the second dog.
+ */
+
+#include <stdlib.h>
+
+#include "dtw.h"
+#include "key.h"
+#include "progmem.h"
+
+#ifdef USE_DTW
+
+#ifndef ADC_STREAM
+#error "Matching over several windows needs the ring buffer mode"
+#endif
+
+#if SAMPLE_SIZE != 64
+#error "The DTW templates are only for a SAMPLE_SIZE of 64"
+#endif
+
+/* Cost of a cell that no path reaches. The costs stop growing here. */
+#define DTW_INF     0xFFFF
+
+/* Template of each dog's bark, as the levels of the bands of consecutive
+ * windows. These come from the bark that the keys in 'key.c' were made from,
+ * barked twice with a hop of silence in between, at the levels and with the
+ * noise that 'replay-fft' adds to it, run through the same front end. The
+ * frames are the windows starting at the first bark and every 'HOP_SIZE'
+ * samples after, up to the one holding just the second bark. The weights and
+ * threshold are worked out by the same rule as for the band keys (see
+ * 'bands.c'), with the threshold added up over the frames. The templates are
+ * only right for a 'SAMPLE_SIZE' of 64. The ring buffer mode applies no window
+ * in the front end, so the same templates are used with either window. */
+const dtw_template dtw_templates[] PROGMEM = {
+#ifdef USE_PREPROCESS
+    {   1, 52, 4,
+        { { 13, 17, 11, 16, 14,  7,  3,  0,  1,  1 },
+          { 12, 19, 15, 14, 14, 13,  4,  1,  2,  0 },
+          { 14, 19, 11, 14, 12,  6,  4,  0,  0,  1 },
+          { 13, 17, 12, 15, 14,  8,  3,  0,  1,  1 } },
+        { {  3,  2,  5,  2,  2,  5,  5,  6,  6,  6 },
+          {  3,  1,  2,  2,  1,  1,  5,  4,  4,  6 },
+          {  1,  0,  4,  1,  2,  4,  6,  6,  6,  6 },
+          {  3,  1,  3,  1,  1,  4,  5,  6,  5,  6 } } },
+    {   2, 43, 4,
+        { { 17, 20, 20, 20, 19, 17, 13,  1, 11,  0 },
+          { 16, 14, 15, 13, 14, 11,  6,  0,  8,  0 },
+          { 19, 15, 19, 15, 20, 14, 10,  1, 11,  0 },
+          { 16, 19, 18, 20, 20, 18, 13,  1, 11,  0 } },
+        { {  1,  0,  0,  0,  1,  2,  4,  6,  2,  8 },
+          {  2,  2,  3,  1,  2,  3,  4,  5,  1,  6 },
+          {  2,  3,  2,  4,  2,  5,  5,  5,  2,  8 },
+          {  2,  1,  2,  0,  0,  2,  3,  5,  2,  8 } } },
+#else
+    {   1, 53, 4,
+        { {  7,  8,  6, 15,  9,  5,  1,  0,  3,  4 },
+          {  2, 10,  6,  8,  9,  9,  2,  0,  3,  3 },
+          {  4,  7,  6, 13, 10,  4,  3,  0,  2,  4 },
+          {  7,  8,  7, 14,  9,  5,  1,  0,  3,  4 } },
+        { {  4,  3,  3,  1,  3,  5,  6,  8,  4,  4 },
+          {  6,  1,  3,  2,  1,  1,  5,  8,  3,  3 },
+          {  5,  3,  4,  0,  1,  4,  6,  8,  5,  3 },
+          {  3,  3,  5,  1,  4,  5,  6,  8,  6,  4 } } },
+    {   2, 53, 4,
+        { {  8, 10, 11, 12, 13, 12, 10,  0, 11,  2 },
+          {  2, 12,  7, 15, 11, 12,  8,  0,  6,  2 },
+          {  4, 11,  9, 12, 13, 11,  8,  0, 10,  1 },
+          {  8, 10, 10, 12, 13, 13, 10,  0, 11,  2 } },
+        { {  5,  3,  3,  4,  2,  3,  4,  8,  2,  7 },
+          {  6,  1,  3,  1,  2,  1,  2,  8,  2,  4 },
+          {  6,  3,  2,  3,  4,  3,  5,  8,  2,  7 },
+          {  5,  3,  2,  2,  4,  3,  4,  8,  2,  6 } } },
+#endif
+};
+
+#define NUM_TEMPLATES   (sizeof(dtw_templates) / sizeof(dtw_templates[0]))
+
+const unsigned char num_dtw_templates = NUM_TEMPLATES;
+
+/* The newest column of the cost matrix for each dog, with the window that the
+ * path to each cell started at. */
+static unsigned int cost[NUM_TEMPLATES][DTW_MAX_FRAMES];
+static unsigned int start[NUM_TEMPLATES][DTW_MAX_FRAMES];
+
+/* Number of windows since the last reset, as the index of the newest one. */
+static unsigned int now = 0;
+
+
+/*
+ * in_band
+ *
+ * Description: Checks whether a path that started at a given window can reach
+ *              a frame of the template at the newest window without leaving
+ *              the band around its diagonal.
+ *
+ * Arguments:   first  The window that the path started at.
+ *              frame  The frame of the template.
+ *
+ * Returns:     Returns nonzero if the cell is in the band.
+ */
+static unsigned char in_band(unsigned int first, unsigned char frame)
+{
+    unsigned int i = now - first;   /* Windows since the path started. */
+
+    return (i > frame) ? (i - frame <= DTW_BAND) : (frame - i <= DTW_BAND);
+}
+
+
+/*
+ * frame_error
+ *
+ * Description: Finds the weighted distance between the band levels of a
+ *              window and one frame of a template.
+ *
+ * Arguments:   t       The index of the template.
+ *              frame   The frame of the template.
+ *              levels  The 'NUM_BANDS' band levels of the window.
+ *
+ * Returns:     Returns the sum over the bands of the weight times the absolute
+ *              difference in level.
+ */
+static unsigned int frame_error(unsigned char t, unsigned char frame,
+                                const unsigned char *levels)
+{
+    unsigned char b;
+    unsigned int err = 0;
+
+    for (b = 0; b < NUM_BANDS; b++)
+    {
+        err += abs(levels[b] -
+                   pgm_read_byte(&dtw_templates[t].level[frame][b])) *
+               pgm_read_byte(&dtw_templates[t].weight[frame][b]);
+    }
+
+    return err;
+}
+
+
+/*
+ * dtw_reset
+ *
+ * Description: Forgets all of the windows matched so far, so that the next
+ *              window starts a new bark.
+ *
+ * Notes:       This must be called before the first window, and whenever a
+ *              window is skipped, since the windows of a path have to be
+ *              consecutive.
+ */
+void dtw_reset(void)
+{
+    unsigned char t, j;
+
+    for (t = 0; t < num_dtw_templates; t++)
+    {
+        for (j = 0; j < DTW_MAX_FRAMES; j++)
+        {
+            cost[t][j] = DTW_INF;
+        }
+    }
+
+    now = 0;
+}
+
+
+/*
+ * dtw_update
+ *
+ * Description: Adds the band levels of the next window to the match against
+ *              every template. If a dog's whole template now lines up with the
+ *              latest windows closely enough, that dog is found; if more than
+ *              one does, the one with the smallest error wins.
+ *
+ * Arguments:   levels  The 'NUM_BANDS' band levels of the window, as from
+ *                      'band_levels'. The window must follow right on from the
+ *                      last one, 'HOP_SIZE' samples later.
+ *
+ * Returns:     Returns the ID of the dog whose bark just ended, or 'NO_DOG' if
+ *              no bark has been matched.
+ *
+ * Notes:       Once a dog is found, everything is reset, so the same bark is
+ *              not found twice. The column is updated in place, so the old
+ *              value of the cell above is carried down as the diagonal.
+ */
+unsigned char dtw_update(const unsigned char *levels)
+{
+    unsigned char t, j;
+    unsigned char frames;       /* Frames in this template. */
+    unsigned int up, upfirst;   /* D[i][j-1], and where its path started. */
+    unsigned int diag, dfirst;  /* D[i-1][j-1]. */
+    unsigned int left, lfirst;  /* D[i-1][j]. */
+    unsigned int best, bfirst;  /* Cheapest of the three. */
+    unsigned long total;
+    unsigned int limit;         /* Error the best dog has to be under. */
+    unsigned int besterr = DTW_INF;
+    unsigned char bestid = NO_DOG;
+
+    now++;
+
+    for (t = 0; t < num_dtw_templates; t++)
+    {
+        frames = pgm_read_byte(&dtw_templates[t].frames);
+
+        /* Before the first frame, a path can start at this window for free. */
+        up = 0;
+        upfirst = now;
+        diag = 0;
+        dfirst = now;
+
+        for (j = 0; j < frames; j++)
+        {
+            left = cost[t][j];
+            lfirst = start[t][j];
+
+            /* Take the cheapest neighbor whose path stays in the band. */
+            best = DTW_INF;
+            bfirst = now;
+            if (up < best && in_band(upfirst, j)) {
+                best = up;
+                bfirst = upfirst;
+            }
+            if (left < best && in_band(lfirst, j)) {
+                best = left;
+                bfirst = lfirst;
+            }
+            if (diag < best && in_band(dfirst, j)) {
+                best = diag;
+                bfirst = dfirst;
+            }
+
+            /* The old value of this cell is the diagonal for the next. */
+            diag = left;
+            dfirst = lfirst;
+
+            if (best != DTW_INF) {
+                total = (unsigned long)best + frame_error(t, j, levels);
+                best = (total < DTW_INF) ? total : DTW_INF;
+            }
+            cost[t][j] = best;
+            start[t][j] = bfirst;
+
+            up = best;
+            upfirst = bfirst;
+        }
+
+        /* The whole template has been matched if its last frame was reached;
+         * the dog has to be under its threshold, and better than the best. */
+        limit = BAND_WEIGHT_ONE * pgm_read_byte(&dtw_templates[t].threshold);
+        if (frames != 0 && up < limit && up < besterr) {
+            besterr = up;
+            bestid = pgm_read_byte(&dtw_templates[t].id);
+        }
+    }
+
+    if (bestid != NO_DOG) {
+        dtw_reset();
+    }
+
+    return bestid;
+}
+
+#endif
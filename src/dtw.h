@@ -0,0 +1,115 @@
+/*
+ * dtw.h
+ *
+ * Matching whole barks over several windows with dynamic time warping.
+ *
+ * This file contains an interface for matching a dog's bark as a sequence of
+ * windows rather than one window at a time. A single window is too short to
+ * hold the rhythm of a bark, so each dog has a template of up to
+ * 'DTW_MAX_FRAMES' frames: the band levels (see 'bands.h') of consecutive
+ * windows of its bark, 'HOP_SIZE' samples apart, as the ring buffer mode of
+ * the ADC records them.
+ *
+ * The band levels of each window in the ring are matched against the templates
+ * with dynamic time warping, so that a bark that is a little faster or slower
+ * than the template still lines up. The warping is done incrementally: for
+ * each dog, one column of the cost matrix is kept, holding the cost of the
+ * best path that ends at each frame of the template and at the newest window.
+ * That column is all of the history that is needed, so each new window only
+ * costs one pass down the column for each dog, and a bark is matched as soon
+ * as its last window is in, with no work left over at the end.
+ *
+ * A path can start at any window (so the bark does not have to line up with
+ * the trigger), but is kept within 'DTW_BAND' windows of the diagonal from
+ * where it started, so a template cannot be stretched or squeezed by more than
+ * that. The cost of a step is the weighted difference in band levels, with a
+ * weight for each band of each frame of the template.
+ *
+ * This is only used if built with 'USE_DTW' (see the 'MATCHER' variable in the
+ * Makefile), which needs the ring buffer mode.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#ifndef _DTW_H_
+#define _DTW_H_
+
+
+#include "bands.h"
+#include "data.h"
+#include "progmem.h"
+
+
+#ifndef DTW_MAX_FRAMES
+#define DTW_MAX_FRAMES      8       /* Most frames in a template. */
+#endif
+#ifndef DTW_BAND
+#define DTW_BAND            1       /* Most windows a path can stray from the
+                                     * diagonal. */
+#endif
+
+
+/*
+ * dtw_template
+ *
+ * Description: Data type for one dog in the table of bark templates.
+ *
+ * Members:     id         The ID of the dog; never 'NO_DOG'.
+ *              threshold  A bark matches this dog only if the weighted error
+ *                         along the best path is less than this, in half
+ *                         octaves.
+ *              frames     The number of frames in the template, from 1 to
+ *                         'DTW_MAX_FRAMES'.
+ *              level      The band levels of each frame, as from
+ *                         'band_levels'.
+ *              weight     How much each band of each frame counts toward the
+ *                         error, from 0 to 'BAND_WEIGHT_ONE'.
+ */
+typedef struct _dtw_template {
+    unsigned char id;
+    unsigned char threshold;
+    unsigned char frames;
+    unsigned char level[DTW_MAX_FRAMES][NUM_BANDS];
+    unsigned char weight[DTW_MAX_FRAMES][NUM_BANDS];
+} dtw_template;
+
+
+extern const dtw_template dtw_templates[] PROGMEM;  /* The enrolled dogs. */
+extern const unsigned char num_dtw_templates;       /* Number of entries. */
+
+
+/*
+ * dtw_reset
+ *
+ * Description: Forgets all of the windows matched so far, so that the next
+ *              window starts a new bark.
+ *
+ * Notes:       This must be called before the first window, and whenever a
+ *              window is skipped, since the windows of a path have to be
+ *              consecutive.
+ */
+void dtw_reset(void);
+
+/*
+ * dtw_update
+ *
+ * Description: Adds the band levels of the next window to the match against
+ *              every template. If a dog's whole template now lines up with the
+ *              latest windows closely enough, that dog is found; if more than
+ *              one does, the one with the smallest error wins.
+ *
+ * Arguments:   levels  The 'NUM_BANDS' band levels of the window, as from
+ *                      'band_levels'. The window must follow right on from the
+ *                      last one, 'HOP_SIZE' samples later.
+ *
+ * Returns:     Returns the ID of the dog whose bark just ended, or 'NO_DOG' if
+ *              no bark has been matched.
+ *
+ * Notes:       Once a dog is found, everything is reset, so the same bark is
+ *              not found twice.
+ */
+unsigned char dtw_update(const unsigned char *levels);
+
+
+#endif /* end of include guard: _DTW_H_ */
@@ -0,0 +1,334 @@
+/*
+ * enroll.c
+ *
+ * Enrolling new dogs on the board.
+ *
+ * This file contains code for making a new key from barks recorded on the
+ * board. Commands come in over the UART, one character at a time, and the log
+ * spectra of the recordings are added up into a running sum and sum of squares
+ * for each bin. Once enough of them are in, the mean and the variance of each
+ * bin are worked out with integer math, and the new key is stored. Nothing in
+ * here is built without 'USE_ENROLL'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               16-bit thresholds.
+ */
+
+#include "enroll.h"
+#include "events.h"
+#include "hal.h"
+#include "key.h"
+
+#ifdef USE_ENROLL
+
+#ifdef USE_GOERTZEL
+#error "Enrolling needs the whole spectrum, which the Goertzel matcher skips"
+#endif
+
+#ifdef USE_BANDS
+#error "Enrolling makes keys of bins, which the band matcher does not use"
+#endif
+
+#if ENROLL_BARKS < 2 || ENROLL_BARKS > 64
+#error "ENROLL_BARKS must be from 2 to 64"
+#endif
+
+/* The command being received over the UART. */
+static unsigned char rxcmd = 0;         /* Set once an 'e' comes in. */
+static unsigned int rxid = 0;           /* The ID so far. */
+static volatile unsigned char request = NO_DOG;    /* ID to enroll next. */
+
+/* The dog being enrolled, and the recordings of it added up so far. */
+static unsigned char dog = NO_DOG;
+static unsigned char count = 0;
+static unsigned int sum[KEY_BINS];
+static unsigned int sumsq[KEY_BINS];
+
+
+/*
+ * put_string
+ *
+ * Description: Writes a string over the UART.
+ *
+ * Arguments:   s  The string to write.
+ */
+static void put_string(const char *s)
+{
+    while (*s != '\0')
+    {
+        hal_uart_putc(*s++);
+    }
+}
+
+
+/*
+ * put_number
+ *
+ * Description: Writes a number over the UART in decimal.
+ *
+ * Arguments:   value  The number to write.
+ */
+static void put_number(unsigned int value)
+{
+    unsigned int place = 1;     /* Place value of the leading digit. */
+
+    while (value / place >= 10)
+    {
+        place *= 10;
+    }
+    for (; place != 0; place /= 10)
+    {
+        hal_uart_putc('0' + value / place % 10);
+    }
+}
+
+
+/*
+ * isqrt
+ *
+ * Description: Takes the square root of a small number.
+ *
+ * Arguments:   x  The number, which should be less than 65025.
+ *
+ * Returns:     Returns floor(sqrt(x)).
+ */
+static unsigned char isqrt(unsigned int x)
+{
+    unsigned char r = 0;
+
+    while ((unsigned int)(r + 1) * (r + 1) <= x)
+    {
+        r++;
+    }
+
+    return r;
+}
+
+
+/*
+ * make_key
+ *
+ * Description: Works out the new key from the recordings added up so far. Each
+ *              bin of the key is the rounded mean of the bin, and its weight is
+ *              KEY_WEIGHT_ONE / (1 + v), rounded, where v is the variance of
+ *              the bin. The threshold is the sum over the bins of the weight
+ *              times (2 sd + 1), where sd is the standard deviation, in whole
+ *              bins and rounded up.
+ *
+ * Arguments:   key  Filled in with the new key.
+ *
+ * Notes:       The variances are kept with 4 fraction bits, and the standard
+ *              deviations with 2.
+ */
+static void make_key(enrolled_key *key)
+{
+    unsigned int k;
+    unsigned long spread;       /* count^2 times the variance of a bin. */
+    unsigned int var16;         /* 16 times the variance. */
+    unsigned char sd4;          /* 4 times the standard deviation. */
+    unsigned char mean;
+    unsigned char weight;
+    unsigned long total = 0;    /* 16 times the threshold. */
+    unsigned long n2 = (unsigned long)count * count;
+
+
+    key->key.id = dog;
+    for (k = 0; k < (KEY_BINS + 1) / 2; k++)
+    {
+        key->key.bins[k] = 0;
+        key->weights[k] = 0;
+    }
+
+    for (k = 0; k < KEY_BINS; k++)
+    {
+        mean = (2 * sum[k] + count) / (2 * count);
+        spread = (unsigned long)count * sumsq[k]
+               - (unsigned long)sum[k] * sum[k];
+        var16 = (16 * spread + n2 / 2) / n2;
+        sd4 = isqrt(var16);
+        weight = (32 * KEY_WEIGHT_ONE + 16 + var16) / (2 * (16 + var16));
+
+        total += weight * (2 * sd4 + 4);
+
+        /* Even bins go in the low 4 bits, and odd bins in the high 4 bits. */
+        if (k & 1) {
+            key->key.bins[k / 2] |= mean << 4;
+            key->weights[k / 2] |= weight << 4;
+        }
+        else {
+            key->key.bins[k / 2] |= mean;
+            key->weights[k / 2] |= weight;
+        }
+    }
+
+    total = (total + 15) / 16;
+    key->key.threshold = (total > 0xFFFF) ? 0xFFFF : (total == 0) ? 1 : total;
+}
+
+
+/*
+ * enroll_init
+ *
+ * Description: Loads the dogs that were enrolled before from the EEPROM, and
+ *              starts the UART so that commands can come in.
+ *
+ * Notes:       This must be called before any keys are searched.
+ */
+void enroll_init(void)
+{
+    key_load();
+
+    rxcmd = 0;
+    request = NO_DOG;
+    dog = NO_DOG;
+    hal_uart_init();
+}
+
+
+/*
+ * enroll_rx
+ *
+ * Description: Called by the UART interrupt with each character that comes
+ *              in. Once a whole 'e<id>' command has come in, the dog is
+ *              queued to be enrolled and an 'EV_ENROLL' event is posted.
+ *
+ * Arguments:   c  The character.
+ *
+ * Notes:       Anything that is not part of a command is ignored.
+ */
+void enroll_rx(char c)
+{
+    if (c == 'e' || c == 'E') {
+        /* Start of a new command. */
+        rxcmd = 1;
+        rxid = 0;
+    }
+    else if (rxcmd && c >= '0' && c <= '9') {
+        /* Another digit of the ID; anything too big is thrown out below. */
+        if (rxid <= 255) {
+            rxid = 10 * rxid + (c - '0');
+        }
+    }
+    else if (rxcmd && (c == '\r' || c == '\n')) {
+        /* The end of the command. */
+        if (rxid != NO_DOG && rxid <= 255) {
+            request = rxid;
+            event_post(EV_ENROLL);
+        }
+        rxcmd = 0;
+    }
+    else {
+        rxcmd = 0;
+    }
+}
+
+
+/*
+ * enroll_poll
+ *
+ * Description: Starts enrolling the dog asked for over the UART, if there is
+ *              one. Enrolling another dog starts over from scratch.
+ *
+ * Notes:       This should be called by the main loop whenever it is waiting
+ *              for a recording.
+ */
+void enroll_poll(void)
+{
+    unsigned char sreg;
+    unsigned char id;
+    unsigned int k;
+
+    /* Take the request, so that it is only started once. */
+    sreg = hal_irq_save();
+    id = request;
+    request = NO_DOG;
+    hal_irq_restore(sreg);
+
+    if (id == NO_DOG) {
+        return;
+    }
+
+    dog = id;
+    count = 0;
+    for (k = 0; k < KEY_BINS; k++)
+    {
+        sum[k] = 0;
+        sumsq[k] = 0;
+    }
+
+    put_string("enroll ");
+    put_number(dog);
+    put_string("\r\n");
+}
+
+
+/*
+ * enroll_active
+ *
+ * Description: Checks whether a dog is being enrolled.
+ *
+ * Returns:     Returns nonzero if recordings should go to 'enroll_add' rather
+ *              than the matcher.
+ */
+unsigned char enroll_active(void)
+{
+    return dog != NO_DOG;
+}
+
+
+/*
+ * enroll_add
+ *
+ * Description: Adds the log spectrum of a recording to the key being made.
+ *              Once 'ENROLL_BARKS' have been added, the key is stored and the
+ *              dog is enrolled.
+ *
+ * Arguments:   logs  The 'KEY_BINS' log magnitudes of the recording, as from
+ *                    'fft_logs'.
+ *
+ * Returns:     Returns nonzero once the dog has been enrolled (or could not
+ *              be, if every slot is taken), or 0 while more recordings are
+ *              needed.
+ */
+unsigned char enroll_add(const unsigned char *logs)
+{
+    unsigned int k;
+    enrolled_key key;
+
+    for (k = 0; k < KEY_BINS; k++)
+    {
+        sum[k] += logs[k];
+        sumsq[k] += logs[k] * logs[k];
+    }
+    count++;
+
+    put_string("bark ");
+    put_number(count);
+    put_string(" of ");
+    put_number(ENROLL_BARKS);
+    put_string("\r\n");
+
+    if (count < ENROLL_BARKS) {
+        return 0;
+    }
+
+    /* That is all of the recordings; make the key and save it. */
+    make_key(&key);
+    if (key_store(&key)) {
+        put_string("enrolled ");
+        put_number(dog);
+        put_string(" threshold ");
+        put_number(key.key.threshold);
+    }
+    else {
+        put_string("no room for ");
+        put_number(dog);
+    }
+    put_string("\r\n");
+
+    dog = NO_DOG;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * enroll.h
+ *
+ * Enrolling new dogs on the board.
+ *
+ * This file contains an interface for making a new key from barks recorded on
+ * the board, rather than running 'test-fft' and pasting its output into
+ * 'key.c'. Enrolling is started by sending the command
+ *      e<id>
+ * and a newline over the UART, where <id> is the ID of the dog, from 1 to 255.
+ * The main loop then hands the log spectrum of each of the next
+ * 'ENROLL_BARKS' recordings to 'enroll_add' instead of matching it, and the
+ * recordings go on as usual in the meantime.
+ *
+ * The spectra are added up in a running sum and sum of squares for each bin,
+ * from which the mean and the variance of the bin are found at the end. The
+ * new key holds the mean of each bin, weighted by how steady it was: a bin
+ * with variance v gets a weight of KEY_WEIGHT_ONE / (1 + v), so the bins that
+ * change from bark to bark count for less. The threshold lets each bin be off
+ * by twice its standard deviation, plus one, at its weight. The key is
+ * stored with 'key_store', which writes it to the EEPROM in the background.
+ *
+ * The progress is reported over the UART, one line at a time.
+ *
+ * This is only used if built with 'USE_ENROLL'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#ifndef _ENROLL_H_
+#define _ENROLL_H_
+
+
+#include "key.h"
+
+
+#ifndef ENROLL_BARKS
+#define ENROLL_BARKS        8       /* Recordings that make up a new key. */
+#endif
+
+
+/*
+ * enroll_init
+ *
+ * Description: Loads the dogs that were enrolled before from the EEPROM, and
+ *              starts the UART so that commands can come in.
+ *
+ * Notes:       This must be called before any keys are searched.
+ */
+void enroll_init(void);
+
+/*
+ * enroll_rx
+ *
+ * Description: Called by the UART interrupt with each character that comes
+ *              in. Once a whole 'e<id>' command has come in, the dog is
+ *              queued to be enrolled and an 'EV_ENROLL' event is posted.
+ *
+ * Arguments:   c  The character.
+ *
+ * Notes:       Anything that is not part of a command is ignored.
+ */
+void enroll_rx(char c);
+
+/*
+ * enroll_poll
+ *
+ * Description: Starts enrolling the dog asked for over the UART, if there is
+ *              one. Enrolling another dog starts over from scratch.
+ *
+ * Notes:       This should be called by the main loop whenever it is waiting
+ *              for a recording.
+ */
+void enroll_poll(void);
+
+/*
+ * enroll_active
+ *
+ * Description: Checks whether a dog is being enrolled.
+ *
+ * Returns:     Returns nonzero if recordings should go to 'enroll_add' rather
+ *              than the matcher.
+ */
+unsigned char enroll_active(void);
+
+/*
+ * enroll_add
+ *
+ * Description: Adds the log spectrum of a recording to the key being made.
+ *              Once 'ENROLL_BARKS' have been added, the key is stored and the
+ *              dog is enrolled.
+ *
+ * Arguments:   logs  The 'KEY_BINS' log magnitudes of the recording, as from
+ *                    'fft_logs'.
+ *
+ * Returns:     Returns nonzero once the dog has been enrolled (or could not
+ *              be, if every slot is taken), or 0 while more recordings are
+ *              needed.
+ */
+unsigned char enroll_add(const unsigned char *logs);
+
+
+#endif /* end of include guard: _ENROLL_H_ */
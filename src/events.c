@@ -0,0 +1,115 @@
+/*
+ * events.c
+ *
+ * Queue of hardware events for the main loop.
+ *
+ * This file contains code for passing events from the interrupts to the main
+ * loop. The interrupts post an event whenever something happens that the main
+ * loop might act on, and the main loop takes the events off of the queue in
+ * order, sleeping whenever the queue is empty.
+ *
+ * The queue is lock-free: only the interrupts add to it and only the main loop
+ * takes from it, so each side has an index of its own. The indices are single
+ * bytes, so they are always read and written in one go.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#include "events.h"
+#include "hal.h"
+
+#if (EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) != 0 || EVENT_QUEUE_SIZE > 128
+#error "EVENT_QUEUE_SIZE must be a power of two, up to 128"
+#endif
+
+/* The queue of events. The indices run freely and are taken modulo the size of
+ * the queue. */
+static volatile unsigned char queue[EVENT_QUEUE_SIZE];
+static volatile unsigned char head = 0;     /* Next event to take. */
+static volatile unsigned char tail = 0;     /* Next slot to post into. */
+static volatile unsigned int drops = 0;
+
+
+/*
+ * event_post
+ *
+ * Description: Adds an event to the end of the queue. If the queue is full, the
+ *              event is dropped and counted.
+ *
+ * Arguments:   ev  The event to post.
+ *
+ * Notes:       This must only be called from interrupts.
+ */
+void event_post(unsigned char ev)
+{
+    unsigned char t = tail;
+
+    if ((unsigned char)(t - head) < EVENT_QUEUE_SIZE) {
+        /* Fill in the slot before making it visible to the main loop. */
+        queue[t & (EVENT_QUEUE_SIZE - 1)] = ev;
+        tail = t + 1;
+    }
+    else {
+        drops++;
+    }
+}
+
+
+/*
+ * event_get
+ *
+ * Description: Takes the next event off of the queue. If the queue is empty,
+ *              the CPU is put to sleep until the next interrupt first.
+ *
+ * Returns:     Returns the oldest event, or 'EV_NONE' if the interrupt that
+ *              woke the CPU up did not post one.
+ *
+ * Notes:       This must only be called from the main loop. The queue is
+ *              checked with interrupts off, and 'hal_sleep' turns them back on
+ *              at the same moment that it sleeps, so an event posted just after
+ *              the check still wakes the CPU up.
+ */
+unsigned char event_get(void)
+{
+    unsigned char sreg;
+    unsigned char h = head;
+    unsigned char ev = EV_NONE;
+
+    sreg = hal_irq_save();
+    if (h == tail) {
+        /* Nothing to do until the next interrupt. */
+        hal_sleep();
+    }
+    hal_irq_restore(sreg);
+
+    if (h != tail) {
+        ev = queue[h & (EVENT_QUEUE_SIZE - 1)];
+        head = h + 1;
+    }
+
+    return ev;
+}
+
+
+/*
+ * event_drops
+ *
+ * Description: Gets the number of events dropped because the queue was full.
+ *
+ * Returns:     Returns the number of dropped events. This wraps around once it
+ *              overflows.
+ */
+unsigned int event_drops(void)
+{
+    unsigned char sreg;
+    unsigned int count;
+
+    /* The count is changed by interrupts, so read both bytes of it with
+     * interrupts off. */
+    sreg = hal_irq_save();
+    count = drops;
+    hal_irq_restore(sreg);
+
+    return count;
+}
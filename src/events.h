@@ -0,0 +1,73 @@
+/*
+ * events.h
+ *
+ * Queue of hardware events for the main loop.
+ *
+ * This file contains an interface for passing events from the interrupts to the
+ * main loop. The interrupts post an event whenever something happens that the
+ * main loop might act on (a recording finishing, a trigger, a change in the
+ * proximity sensors, or a command to enroll a dog). The main loop takes the
+ * events off of the queue in order, and sleeps whenever the queue is empty.
+ *
+ * The queue is lock-free: only the interrupts add to it and only the main loop
+ * takes from it, so each side has an index of its own. Interrupts do not
+ * interrupt each other, so there is only ever one writer at a time.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Added the enroll event.
+ */
+
+#ifndef _EVENTS_H_
+#define _EVENTS_H_
+
+
+#ifndef EVENT_QUEUE_SIZE
+#define EVENT_QUEUE_SIZE    8       /* Must be a power of two. */
+#endif
+
+/* Events that can be posted. */
+#define EV_NONE             0       /* Nothing happened. */
+#define EV_RECORDING        1       /* A recording is ready to acquire. */
+#define EV_TRIGGER          2       /* The external trigger fired. */
+#define EV_PROXIMITY        3       /* The proximity sensors changed. */
+#define EV_ENROLL           4       /* A dog was asked to be enrolled. */
+
+
+/*
+ * event_post
+ *
+ * Description: Adds an event to the end of the queue. If the queue is full, the
+ *              event is dropped and counted.
+ *
+ * Arguments:   ev  The event to post.
+ *
+ * Notes:       This must only be called from interrupts.
+ */
+void event_post(unsigned char ev);
+
+/*
+ * event_get
+ *
+ * Description: Takes the next event off of the queue. If the queue is empty,
+ *              the CPU is put to sleep until the next interrupt first.
+ *
+ * Returns:     Returns the oldest event, or 'EV_NONE' if the interrupt that
+ *              woke the CPU up did not post one.
+ *
+ * Notes:       This must only be called from the main loop.
+ */
+unsigned char event_get(void);
+
+/*
+ * event_drops
+ *
+ * Description: Gets the number of events dropped because the queue was full.
+ *
+ * Returns:     Returns the number of dropped events. This wraps around once it
+ *              overflows.
+ */
+unsigned int event_drops(void);
+
+
+#endif /* end of include guard: _EVENTS_H_ */
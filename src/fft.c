@@ -20,37 +20,548 @@
  * Revision History:
  *      16 Apr 2015     Brian Kubisiak      Initial revision.
  *      06 Jun 2015     Brian Kubisiak      Added method for FFT comparison.
+ *      16 Oct 2026     agent               Block-floating-point scaling.
+ *      16 Oct 2026     agent               Added Q15 FFT.
+ *      16 Oct 2026     agent               Added real-input FFT.
+ *      16 Oct 2026     agent               Added radix-4 passes.
+ *      16 Oct 2026     agent               Integer log10 in the matcher.
+ *      16 Oct 2026     agent               Transforms that read from a ring.
+ *      16 Oct 2026     agent               Match against several dogs.
+ *      16 Oct 2026     agent               Read the roots from program memory.
+ *      16 Oct 2026     agent               Added the reordering passes.
+ *      16 Oct 2026     agent               Split the log spectrum out of the
+ *                                          matcher.
+ *      16 Oct 2026     agent               Inline butterflies from 'arith.h'.
+ *      16 Oct 2026     agent               Optional assembly radix-4 kernel.
+ *      16 Oct 2026     agent               Read 16-bit samples from the ring.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
 
+#include "arith.h"
 #include "fft.h"
+#include "key.h"
+#include "progmem.h"
 
-#define ERROR_THRESHOLD 30
+/*
+ * Largest magnitude (of either part) that a point may have going into a pass
+ * of butterflies. A butterfly computes a + bw with |w| = 1, so each part can
+ * grow by at most 1 + sqrt(2); 52 * (1 + sqrt(2)) still fits in a char.
+ */
+#define BFP_LIMIT       52
+#define BFP_LIMIT_Q15   13572   /* Same limit for the Q15 datapath. */
+
+/*
+ * Same limit for a radix-4 pass, which does two butterflies in a row on each
+ * point: 21 * (1 + sqrt(2))^2 still fits in a char.
+ */
+#define BFP_LIMIT4      21
+
+/* Roots of unity for the FFT, and the bit-reversed positions, in program
+ * memory. */
+extern const complex root[SAMPLE_SIZE] PROGMEM;
+extern const complex_q15 root_q15[SAMPLE_SIZE] PROGMEM;
+extern const bitrev_index bitrev[SAMPLE_SIZE] PROGMEM;
+
+/* Kernel for the radix-4 clusters with real multiplies: the assembly one on
+ * the board if built with 'USE_ASM_BUTTERFLY', or else the C reference. */
+#if defined(__AVR__) && defined(USE_ASM_BUTTERFLY)
+#define FFT_CLUSTERS4   fft_clusters4_avr
+#else
+#define FFT_CLUSTERS4   fft_clusters4
+#endif
+
+/* Reads an entry of 'bitrev', whatever size it is. */
+#if SAMPLE_SIZE <= 256
+#define get_bitrev(p)   pgm_read_byte(p)
+#else
+#define get_bitrev(p)   pgm_read_word(p)
+#endif
 
-extern complex root[SAMPLE_SIZE];       /* Roots of unity for the FFT. */
-extern unsigned char key[SAMPLE_SIZE];  /* Spectrum that will open the bowl. */
 
 /*
- * fft
+ * get_root
  *
- * Description: Computes the fast Fourier transform (FFT) of an array of input
- *              data. This implementation is in-place, so it will take O(1)
- *              space. Additionally, optimizations are performed assuming that
- *              the data to transform is purely real. The implementation assumes
- *              8-bit characters and 16-bit shorts. It attempts to avoid 16-bit
- *              additions/multiplications wherever possible in order to cut down
- *              on the number of clocks.
+ * Description: Reads one of the roots of unity out of program memory.
  *
- * Arguments:   data An array of complex numbers for performing the FFT. This
- *                   FFT assumes that the array contains 'SAMPLE_SIZE' values of
- *                   type 'complex'. Both of these are defined in 'data.h'.
+ * Arguments:   m  The index of the root in 'root'.
+ *
+ * Returns:     Returns the root.
+ */
+static complex get_root(unsigned int m)
+{
+    complex w;
+
+    w.real = pgm_read_byte(&root[m].real);
+    w.imag = pgm_read_byte(&root[m].imag);
+
+    return w;
+}
+
+
+/*
+ * get_root_q15
+ *
+ * Description: Reads one of the Q15 roots of unity out of program memory.
+ *
+ * Arguments:   m  The index of the root in 'root_q15'.
+ *
+ * Returns:     Returns the root.
+ */
+static complex_q15 get_root_q15(unsigned int m)
+{
+    complex_q15 w;
+
+    w.real = pgm_read_word(&root_q15[m].real);
+    w.imag = pgm_read_word(&root_q15[m].imag);
+
+    return w;
+}
+
+/*
+ * peak_of
+ *
+ * Description: Finds the larger of a running peak and the magnitudes of the
+ *              real and imaginary parts of a complex number. This is used to
+ *              track the largest value in a block of data as it is written.
+ *
+ * Arguments:   peak  The largest magnitude seen so far.
+ *              c     The complex number to check against the peak.
+ *
+ * Returns:     Returns the new peak magnitude.
+ */
+static unsigned char peak_of(unsigned char peak, complex c)
+{
+    /* Take the absolute value of each part; note that -128 becomes 128, which
+     * is why the peak is unsigned. */
+    unsigned char re = (c.real < 0) ? -c.real : c.real;
+    unsigned char im = (c.imag < 0) ? -c.imag : c.imag;
+
+    if (re > peak) {
+        peak = re;
+    }
+    if (im > peak) {
+        peak = im;
+    }
+
+    return peak;
+}
+
+/*
+ * scale_shift
+ *
+ * Description: Finds how far a block of data has to be shifted down so that
+ *              its peak (after rounding) is within a limit.
+ *
+ * Arguments:   peak  The largest magnitude of any part of any point in the
+ *                    block.
+ *              limit The largest magnitude allowed after shifting.
+ *
+ * Returns:     Returns the smallest number of bits to shift the block down by.
+ */
+static unsigned char scale_shift(unsigned int peak, unsigned int limit)
+{
+    unsigned char shift = 0;
+    unsigned int round = 0;     /* Half an LSB after shifting. */
+
+    /* Find the smallest shift that brings the (rounded) peak within the
+     * limit. */
+    while (((peak + round) >> shift) > limit) {
+        shift++;
+        round = 1U << (shift - 1);
+    }
+
+    return shift;
+}
+
+
+/*
+ * block_scale
+ *
+ * Description: Scales a block of data down by a power of two so that it has
+ *              enough headroom for the next pass of butterflies. The amount to
+ *              scale by is determined from the peak magnitude of the block;
+ *              if the peak is already within the limit, nothing is done.
+ *
+ * Arguments:   data  The block of data to scale.
+ *              n     The number of points in the block.
+ *              peak  The largest magnitude of any part of any point in the
+ *                    block.
+ *              limit The largest magnitude allowed going into the pass;
+ *                    'BFP_LIMIT' or 'BFP_LIMIT4'.
+ *
+ * Returns:     Returns the number of bits the block was shifted down by. This
+ *              should be added to the exponent for the block.
+ */
+static unsigned char block_scale(complex *data, unsigned int n,
+                                 unsigned char peak, unsigned char limit)
+{
+    unsigned char shift;
+    unsigned char round;        /* Half an LSB after shifting. */
+    unsigned int i;
+
+    shift = scale_shift(peak, limit);
+    round = (shift != 0) ? 1 << (shift - 1) : 0;
+
+    /* Only touch the data if it actually needs to be scaled. */
+    if (shift != 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            /* Round to nearest rather than truncating so that the error
+             * does not build up in one direction. */
+            data[i].real = (data[i].real + round) >> shift;
+            data[i].imag = (data[i].imag + round) >> shift;
+        }
+    }
+
+    return shift;
+}
+
+/*
+ * peak_of_q15
+ *
+ * Description: Finds the larger of a running peak and the magnitudes of the
+ *              real and imaginary parts of a Q15 complex number.
  *
- * Limitations: Assumes that the input data is purely real. Because there is no
- *              FPU and fixed-point arithmetic is used, the resulting FFT will
- *              not be normalized to anything sensible.
+ * Arguments:   peak  The largest magnitude seen so far.
+ *              c     The complex number to check against the peak.
+ *
+ * Returns:     Returns the new peak magnitude.
+ */
+static unsigned int peak_of_q15(unsigned int peak, complex_q15 c)
+{
+    /* Same as 'peak_of', just with wider parts. */
+    unsigned int re = (c.real < 0) ? -(long)c.real : c.real;
+    unsigned int im = (c.imag < 0) ? -(long)c.imag : c.imag;
+
+    if (re > peak) {
+        peak = re;
+    }
+    if (im > peak) {
+        peak = im;
+    }
+
+    return peak;
+}
+
+/*
+ * block_scale_q15
+ *
+ * Description: Scales a block of Q15 data down by a power of two so that it
+ *              has enough headroom for the next pass of butterflies. This works
+ *              the same as 'block_scale', but with 'BFP_LIMIT_Q15'.
+ *
+ * Arguments:   data  The block of data to scale.
+ *              n     The number of points in the block.
+ *              peak  The largest magnitude of any part of any point in the
+ *                    block.
+ *
+ * Returns:     Returns the number of bits the block was shifted down by.
+ */
+static unsigned char block_scale_q15(complex_q15 *data, unsigned int n,
+                                     unsigned int peak)
+{
+    unsigned char shift;
+    unsigned int round;         /* Half an LSB after shifting. */
+    unsigned int i;
+
+    shift = scale_shift(peak, BFP_LIMIT_Q15);
+    round = (shift != 0) ? 1U << (shift - 1) : 0;
+
+    /* Only touch the data if it actually needs to be scaled. */
+    if (shift != 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            data[i].real = ((long)data[i].real + round) >> shift;
+            data[i].imag = ((long)data[i].imag + round) >> shift;
+        }
+    }
+
+    return shift;
+}
+
+/*
+ * fft_pass2
+ *
+ * Description: Does a single radix-2 pass of butterflies over a block of data.
+ *              Each butterfly takes two points a and b and replaces them with
+ *              a + bw and a - bw, so the product bw is only computed once.
+ *
+ * Arguments:   data    The block of 'n' points to transform.
+ *              n       The number of points in the block.
+ *              stride  The distance between the two points of a butterfly.
+ *              peak    Updated with the largest magnitude of the output.
+ *
+ * Notes:       The first cluster always uses the root 1, and the second uses
+ *              j, so neither needs a real multiply.
+ */
+static void fft_pass2(complex *data, unsigned int n, unsigned int stride,
+                      unsigned char *peak)
+{
+    unsigned int j, k;          /* Loop indices. */
+    unsigned int m;             /* Index of the current cluster. */
+
+    /*
+     * Keep striding through the data until we cover all of it. Note that we
+     * only go to 'n / 2', since each butterfly covers 2 data points.
+     */
+    for (j = 0, m = 0; j < n; j += 2*stride, m++)
+    {
+        /* Since the roots are stored in bit-reversed order, every butterfly in
+         * the mth cluster uses the mth root. */
+        complex w = get_root(m);
+
+        /*
+         * Iterate over every butterfly in the cluster. This will use one data
+         * point in the cluster, and one in the next cluster. We then stride
+         * over the next butterfly cluster to avoid redoing this computation.
+         */
+        for (k = j; k < j + stride; k++)
+        {
+            /* Get the second data point, which is multiplied by the root. */
+            complex b = data[k+stride];
+            complex t;
+
+            /* Multiply by the root, skipping the trivial ones: 1 is a no-op,
+             * and j just swaps the parts and negates one. */
+            if (m == 0) {
+                t = b;
+            }
+            else if (m == 1) {
+                t.real = -b.imag;
+                t.imag = b.real;
+            }
+            else {
+                t = mul(b, w);
+            }
+
+            /* Now transform them using a butterfly. The negative of the root
+             * is just 180 degrees around the unit circle. */
+            butterfly(&data[k], &data[k+stride], t);
+
+            /* Keep track of the largest output for the next pass. */
+            *peak = peak_of(*peak, data[k]);
+            *peak = peak_of(*peak, data[k+stride]);
+        }
+    }
+}
+
+/*
+ * fft_clusters4
+ *
+ * Description: Does the clusters of a radix-4 pass (see 'fft_pass4') that
+ *              need real multiplies, which is every cluster but the first.
+ *              This is the reference version of the kernel; if built with
+ *              'USE_ASM_BUTTERFLY', the board uses 'fft_clusters4_avr' (in
+ *              'fft_avr.S') instead, which has to give exactly the same
+ *              output.
+ *
+ * Arguments:   data      The first point of the second cluster of the pass.
+ *              clusters  The number of clusters to do, each of '2 * stride'
+ *                        points, starting with cluster 1.
+ *              stride    The stride of the first of the two passes; must be
+ *                        at least 2.
+ *              peak      The largest magnitude of the output so far.
+ *
+ * Returns:     Returns the largest magnitude of the output, including 'peak'.
+ */
+unsigned char fft_clusters4(complex *data, unsigned char clusters,
+                            unsigned int stride, unsigned char peak)
+{
+    unsigned int k;             /* Loop index. */
+    unsigned int m;             /* Index of the current cluster. */
+    unsigned int half = stride / 2;
+
+    for (m = 1; m <= clusters; m++, data += 2*stride)
+    {
+        /* Roots for the first and second passes of this cluster. */
+        complex w1 = get_root(m);
+        complex w2 = get_root(2*m);
+
+        for (k = 0; k < half; k++)
+        {
+            complex x0 = data[k];
+            complex x1 = data[k + half];
+            complex x2 = data[k + stride];
+            complex x3 = data[k + stride + half];
+            complex u, v, jv;
+
+            /* First pass: butterflies (x0, x2) and (x1, x3) with root w1. The
+             * results stay in the same variables. */
+            butterfly(&x0, &x2, mul(x2, w1));
+            butterfly(&x1, &x3, mul(x3, w1));
+
+            /* Second pass: butterflies (x0, x1) with root w2 and (x2, x3) with
+             * root j w2. */
+            u = mul(x1, w2);
+            v = mul(x3, w2);
+            jv.real = -v.imag;
+            jv.imag = v.real;
+            butterfly(&x0, &x1, u);
+            butterfly(&x2, &x3, jv);
+
+            data[k]                 = x0;
+            data[k + half]          = x1;
+            data[k + stride]        = x2;
+            data[k + stride + half] = x3;
+
+            /* Keep track of the largest output for the next pass. */
+            peak = peak_of(peak, x0);
+            peak = peak_of(peak, x1);
+            peak = peak_of(peak, x2);
+            peak = peak_of(peak, x3);
+        }
+    }
+
+    return peak;
+}
+
+
+/*
+ * fft_pass4
+ *
+ * Description: Does two radix-2 passes of butterflies at once, with strides
+ *              'stride' and 'stride / 2'. Each group of four points is loaded
+ *              once, run through both butterflies, and stored once, which
+ *              halves the loads, stores, and loop overhead of two 'fft_pass2'
+ *              calls. The output is in the same (bit-reversed) order.
+ *
+ * Arguments:   data    The block of 'n' points to transform.
+ *              n       The number of points in the block.
+ *              stride  The stride of the first of the two passes; must be at
+ *                      least 2.
+ *              peak    Updated with the largest magnitude of the output.
+ *
+ * Notes:       In cluster m of the first pass, the root is w1 = root[m]. This
+ *              cluster is split into clusters 2m and 2m + 1 in the second pass,
+ *              which use w2 = root[2m] and root[2m + 1] = j w2. So the second
+ *              pass needs only one root, and the multiply by j is free. In the
+ *              first cluster, w1 = w2 = 1 and no multiplies are needed at all,
+ *              so it is done here; the rest are done by 'FFT_CLUSTERS4'.
+ */
+static void fft_pass4(complex *data, unsigned int n, unsigned int stride,
+                      unsigned char *peak)
+{
+    unsigned int k;             /* Loop index. */
+    unsigned int half = stride / 2;
+
+    for (k = 0; k < half; k++)
+    {
+        complex x0 = data[k];
+        complex x1 = data[k + half];
+        complex x2 = data[k + stride];
+        complex x3 = data[k + stride + half];
+        complex jv;
+
+        /* First pass, then second pass, all with the root 1 except for the
+         * last butterfly, which is with j. */
+        butterfly(&x0, &x2, x2);
+        butterfly(&x1, &x3, x3);
+        jv.real = -x3.imag;
+        jv.imag = x3.real;
+        butterfly(&x0, &x1, x1);
+        butterfly(&x2, &x3, jv);
+
+        data[k]                 = x0;
+        data[k + half]          = x1;
+        data[k + stride]        = x2;
+        data[k + stride + half] = x3;
+
+        /* Keep track of the largest output for the next pass. */
+        *peak = peak_of(*peak, x0);
+        *peak = peak_of(*peak, x1);
+        *peak = peak_of(*peak, x2);
+        *peak = peak_of(*peak, x3);
+    }
+
+    /* All of the other clusters. There are at most 255 of them for up to 1024
+     * points, since the stride is at least 2. */
+    if (n > 2*stride) {
+        *peak = FFT_CLUSTERS4(data + 2*stride, n / (2*stride) - 1, stride,
+                              *peak);
+    }
+}
+
+
+/*
+ * fft_passes
+ *
+ * Description: Does the passes of butterflies for 'fft_core', starting from a
+ *              given stride. This lets a transform whose first pass was done
+ *              some other way (see 'rfft_ring') finish the rest of the passes.
+ *
+ * Arguments:   data    The array of 'n' complex points to transform.
+ *              n       The number of points.
+ *              stride  The stride of the first pass to do.
+ *              passes  The number of passes left to do; the last one is done
+ *                      with a stride of 1.
+ *              radix4  Nonzero to do the passes two at a time with
+ *                      'fft_pass4'.
+ *              peak    On input, the largest magnitude of any part of the
+ *                      data. On output, the largest magnitude of the result.
+ *
+ * Returns:     Returns the number of bits the block was shifted down by.
+ */
+static unsigned char fft_passes(complex *data, unsigned int n,
+                                unsigned int stride, unsigned char passes,
+                                unsigned char radix4, unsigned char *peak)
+{
+    unsigned char exponent = 0; /* Total shift applied to the block. */
+
+    /* Before each pass, make sure that it cannot overflow; the peak of the
+     * output is tracked as it is written for checking the next pass. */
+    while (passes > 0)
+    {
+        if (radix4 && passes >= 2)
+        {
+            exponent += block_scale(data, n, *peak, BFP_LIMIT4);
+            *peak = 0;
+            fft_pass4(data, n, stride, peak);
+            stride /= 4;
+            passes -= 2;
+        }
+        else
+        {
+            exponent += block_scale(data, n, *peak, BFP_LIMIT);
+            *peak = 0;
+            fft_pass2(data, n, stride, peak);
+            stride /= 2;
+            passes--;
+        }
+    }
+
+    return exponent;
+}
+
+
+/*
+ * fft_core
+ *
+ * Description: Computes the in-place FFT of a block of 'n' complex points with
+ *              block floating point scaling. This is the actual transform used
+ *              by 'fft' (with n = SAMPLE_SIZE) and by 'rfft' (with n =
+ *              SAMPLE_SIZE / 2). The output is left in bit-reversed order.
+ *
+ *              Before each pass, the whole block is checked for headroom and
+ *              shifted down if the butterflies could overflow 8 bits. The
+ *              total number of bits shifted is returned as a shared exponent
+ *              for the block, so the true result is the output multiplied by
+ *              2^exponent.
+ *
+ * Arguments:   data     The array of 'n' complex points to transform.
+ *              n        The number of points; must be a power of two no larger
+ *                       than 'SAMPLE_SIZE'.
+ *              log2n    The base-2 log of 'n'.
+ *              radix4   Nonzero to do the passes two at a time with
+ *                       'fft_pass4'. If log2n is odd, the last pass is still
+ *                       done with 'fft_pass2'.
+ *              outpeak  Filled in with the largest magnitude of any part of
+ *                       the output, so the caller can check its headroom.
+ *
+ * Returns:     Returns the block exponent of the output.
  *
  * Notes:       A lot of the notation below is made up. Basically, we do log2(N)
  *              passes over the data, where each pass will iterate over a
@@ -63,108 +574,635 @@ extern unsigned char key[SAMPLE_SIZE];  /* Spectrum that will open the bowl. */
  *              If you don't understand how this works, try staring at FFT
  *              butterflies a bit longer and it will hopefully make sense. If
  *              that doesn't work, try eating ice cream because yum ice cream.
+ *
+ *              The roots of unity are stored in bit-reversed order, so the mth
+ *              cluster always uses the mth root. The first n/2 roots of the
+ *              'SAMPLE_SIZE' table are exactly the bit-reversed roots for an
+ *              n-point transform, which is why any smaller size works too.
  */
-
-void fft(complex *data)
+static unsigned char fft_core(complex *data, unsigned int n,
+                              unsigned char log2n, unsigned char radix4,
+                              unsigned char *outpeak)
 {
-    /*
-     * The stride of each pass over the data is a measure of the distance
-     * between the two data points combined together in a butterfly. It is
-     * always a power of two.
-     */
-    unsigned int stride;
-    unsigned int i, j, k;      /* Loop indices. */
+    unsigned int i;             /* Loop index. */
+    unsigned char peak;         /* Largest magnitude in the block. */
 
 
+    /* Find the peak of the input so the first pass can be scaled. */
+    peak = 0;
+    for (i = 0; i < n; i++) {
+        peak = peak_of(peak, data[i]);
+    }
+
     /* We start off with two separate clusters of butterflie nodes filling the
-     * entire data set. */
-    stride = SAMPLE_SIZE / 2;
+     * entire data set, and need to perform log2(N) passes over the data in
+     * order to fully transform it. */
+    *outpeak = peak;
+    return fft_passes(data, n, n / 2, log2n, radix4, outpeak);
+}
 
-    /* We need to perform log2(N) iterations over the data in order to fully
-     * transform it. */
-    for (i = 0; i < LOG2_SAMPLE_SIZE; i++)
+/*
+ * fft
+ *
+ * Description: Computes the fast Fourier transform (FFT) of an array of input
+ *              data. This implementation is in-place, so it will take O(1)
+ *              space. The implementation assumes 8-bit characters and 16-bit
+ *              shorts. It attempts to avoid 16-bit additions/multiplications
+ *              wherever possible in order to cut down on the number of clocks.
+ *
+ *              The transform uses block floating point: before each pass, the
+ *              whole block is checked for headroom and shifted down if the
+ *              butterflies could overflow 8 bits. The total number of bits
+ *              shifted is returned as a shared exponent for the block, so the
+ *              true result is the output multiplied by 2^exponent.
+ *
+ *              The passes are done two at a time (radix 4) to cut down on
+ *              loads, stores, and multiplies, with a single radix-2 pass at
+ *              the end if 'LOG2_SAMPLE_SIZE' is odd.
+ *
+ * Arguments:   data An array of complex numbers for performing the FFT. This
+ *                   FFT assumes that the array contains 'SAMPLE_SIZE' values of
+ *                   type 'complex'. Both of these are defined in 'data.h'.
+ *
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Limitations: Because there is no FPU and fixed-point arithmetic is used, the
+ *              resulting FFT will not be normalized to anything sensible. For
+ *              purely real input, 'rfft' does the same job in about half the
+ *              time and memory.
+ */
+unsigned char fft(complex *data)
+{
+    unsigned char peak;     /* Unused peak of the output. */
+
+    return fft_core(data, SAMPLE_SIZE, LOG2_SAMPLE_SIZE, 1, &peak);
+}
+
+/*
+ * fft_radix2
+ *
+ * Description: Computes the same transform as 'fft', but only using radix-2
+ *              passes. This is the plain reference version of the transform,
+ *              kept for comparing against the faster kernels.
+ *
+ * Arguments:   data An array of 'SAMPLE_SIZE' complex numbers for performing
+ *                   the FFT.
+ *
+ * Returns:     Returns the block exponent of the output.
+ */
+unsigned char fft_radix2(complex *data)
+{
+    unsigned char peak;     /* Unused peak of the output. */
+
+    return fft_core(data, SAMPLE_SIZE, LOG2_SAMPLE_SIZE, 0, &peak);
+}
+
+/*
+ * rfft_split
+ *
+ * Description: Does the split pass of 'rfft', turning the half-size transform
+ *              of the packed samples into the first half of the spectrum of
+ *              the real signal. See 'rfft' for the math.
+ *
+ * Arguments:   data  The 'SAMPLE_SIZE / 2' points of the half-size transform,
+ *                    in bit-reversed order.
+ *              peak  The largest magnitude of any part of the data.
+ *
+ * Returns:     Returns the number of bits the block was shifted down by.
+ */
+static unsigned char rfft_split(complex *data, unsigned char peak)
+{
+    unsigned int k;             /* Bin being computed. */
+    unsigned int p, q;          /* Positions of bins k and N/2 - k. */
+    unsigned int bit;           /* For stepping the bit-reversed positions. */
+    unsigned char exponent;
+    complex z;
+
+
+    /* Parts of the split pass add two points together before halving, so make
+     * sure there is the same headroom as for a butterfly. */
+    exponent = block_scale(data, SAMPLE_SIZE / 2, peak, BFP_LIMIT);
+
+    /* Bins 0 and N/2 only depend on the first point: they are the sum and the
+     * difference of the (real) spectra of the even and odd samples. */
+    z = data[0];
+    data[0].real = z.real + z.imag;
+    data[0].imag = z.real - z.imag;
+
+    /* Start with k = 1; in bit-reversed order, that is the top bit. N/2 - 1 is
+     * all ones, so it is the same reversed. */
+    p = SAMPLE_SIZE / 4;
+    q = SAMPLE_SIZE / 2 - 1;
+
+    for (k = 1; k <= SAMPLE_SIZE / 4; k++)
     {
-        /*
-         * Keep striding through the data until we cover all of it. Note that we
-         * only go to 'SAMPLE_SIZE / 2', since each butterfly covers 2 data
-         * points.
-         */
-        for (j = 0; j < SAMPLE_SIZE; j += 2*stride)
+        complex a = data[p];
+        complex b = data[q];
+        complex w;
+        int sr, si;             /* 2E = Z[k] + conj Z[N/2 - k] */
+        int dr, di;             /* Z[k] - conj Z[N/2 - k] */
+        int tr, ti;             /* 2 W^k O */
+
+        /* The roots are in bit-reversed order, so W^k is at position p. */
+        w = get_root(p);
+
+        /* After scaling, all of these fit in a char. */
+        sr = a.real + b.real;
+        si = a.imag - b.imag;
+        dr = a.real - b.real;
+        di = a.imag + b.imag;
+
+        /* 2O = (di - j dr); multiply that by W^k, rounding like 'mul'. */
+        tr = (di * w.real + dr * w.imag + 64) >> 7;
+        ti = (di * w.imag - dr * w.real + 64) >> 7;
+
+        /* X[k] = E + W^k O and X[N/2 - k] = conj(E - W^k O). Each part is at
+         * most (104 + 148) / 2, so the result fits back in a char. */
+        data[p].real = (sr + tr + 1) >> 1;
+        data[p].imag = (si + ti + 1) >> 1;
+        data[q].real = (sr - tr + 1) >> 1;
+        data[q].imag = (ti - si + 1) >> 1;
+
+        /* Step p forward and q backward in bit-reversed order. Adding one in
+         * bit-reversed order carries from the top bit down. */
+        bit = SAMPLE_SIZE / 4;
+        while (p & bit) {
+            p ^= bit;
+            bit >>= 1;
+        }
+        p |= bit;
+
+        bit = SAMPLE_SIZE / 4;
+        while (bit != 0 && !(q & bit)) {
+            q |= bit;
+            bit >>= 1;
+        }
+        q ^= bit;
+    }
+
+    return exponent;
+}
+
+
+/*
+ * rfft
+ *
+ * Description: Computes the FFT of 'SAMPLE_SIZE' purely real samples. The
+ *              samples are packed two to a point, with even samples in the
+ *              real parts and odd samples in the imaginary parts, so the input
+ *              is only 'SAMPLE_SIZE / 2' points. These are transformed with a
+ *              half-size complex FFT, and then a split pass untangles the
+ *              spectra of the even and odd samples to get the first half of
+ *              the spectrum of the real signal. The second half is just the
+ *              complex conjugate of the first, so it is not computed.
+ *
+ * Arguments:   data An array of 'SAMPLE_SIZE / 2' complex numbers, each
+ *                   holding two consecutive real samples.
+ *
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Notes:       The output is in bit-reversed order just like 'fft', but over
+ *              'LOG2_SAMPLE_SIZE - 1' bits. Bins 0 and SAMPLE_SIZE/2 are both
+ *              purely real, so they are packed together into the first point:
+ *              the real part is bin 0 and the imaginary part is bin
+ *              SAMPLE_SIZE/2.
+ *
+ *              With Z the half-size transform, the split pass computes
+ *                  X[k]       = E + W^k O
+ *                  X[N/2 - k] = conj(E - W^k O)
+ *              where E = (Z[k] + conj Z[N/2 - k]) / 2 and
+ *                    O = (Z[k] - conj Z[N/2 - k]) / 2j.
+ *              Both bins are computed at once from the same pair of points and
+ *              written back in their place, so the pass is in-place.
+ */
+unsigned char rfft(complex *data)
+{
+    unsigned char peak;         /* Largest magnitude in the block. */
+    unsigned char exponent;
+
+
+    /* Transform the packed samples with a half-size FFT. */
+    exponent = fft_core(data, SAMPLE_SIZE / 2, LOG2_SAMPLE_SIZE - 1, 1, &peak);
+
+    /* Then untangle the spectra of the even and odd samples. */
+    return exponent + rfft_split(data, peak);
+}
+
+/*
+ * rfft_ring
+ *
+ * Description: Computes the same transform as 'rfft', but reads the
+ *              'SAMPLE_SIZE' real samples straight out of a ring buffer rather
+ *              than from a packed array. The first pass of butterflies is done
+ *              as the samples are read, so the window is never copied and the
+ *              ring is left untouched; the result is written to 'data'.
+ *
+ * Arguments:   data   An array of 'SAMPLE_POINTS' complex numbers to hold the
+ *                     output. This must not overlap the ring.
+ *              ring   The ring buffer of real samples.
+ *              start  The index in the ring of the first sample in the window.
+ *              mask   One less than the size of the ring, which must be a
+ *                     power of two. Indices into the ring wrap around with it.
+ *
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Notes:       The output is in the same order as for 'rfft'. The first pass
+ *              of the half-size transform has a single cluster using the root
+ *              1, so it only adds and subtracts and fits in with loading the
+ *              samples; the rest of the passes are done in-place as usual.
+ */
+unsigned char rfft_ring(complex *data, const char *ring, unsigned int start,
+                        unsigned int mask)
+{
+    unsigned int i;             /* Loop index. */
+    unsigned char peak;         /* Largest magnitude in the block. */
+    unsigned char shift;        /* Scaling for the first pass. */
+    unsigned char round;        /* Half an LSB after shifting. */
+    unsigned char exponent;
+    complex a, b;               /* Points of a butterfly. */
+
+
+    /* Find the peak of the window so the first pass can be scaled. */
+    peak = 0;
+    for (i = 0; i < SAMPLE_SIZE; i += 2)
+    {
+        a.real = ring[(start + i) & mask];
+        a.imag = ring[(start + i + 1) & mask];
+        peak = peak_of(peak, a);
+    }
+
+    shift = scale_shift(peak, BFP_LIMIT);
+    round = (shift != 0) ? 1 << (shift - 1) : 0;
+
+    /* Load and scale the points for the first pass. Point i holds samples 2i
+     * and 2i + 1, and its butterfly is with the point a quarter of the window
+     * further on. */
+    peak = 0;
+    for (i = 0; i < SAMPLE_SIZE / 4; i++)
+    {
+        a.real = (ring[(start + 2*i) & mask] + round) >> shift;
+        a.imag = (ring[(start + 2*i + 1) & mask] + round) >> shift;
+        b.real = (ring[(start + 2*i + SAMPLE_SIZE/2) & mask] + round) >> shift;
+        b.imag = (ring[(start + 2*i + SAMPLE_SIZE/2 + 1) & mask] + round)
+                 >> shift;
+
+        /* The root is 1, so there is nothing to multiply. */
+        butterfly(&a, &b, b);
+        data[i]                     = a;
+        data[i + SAMPLE_SIZE / 4]   = b;
+
+        peak = peak_of(peak, data[i]);
+        peak = peak_of(peak, data[i + SAMPLE_SIZE / 4]);
+    }
+
+    /* Finish the half-size FFT from the second pass on. */
+    exponent = shift + fft_passes(data, SAMPLE_SIZE / 2, SAMPLE_SIZE / 8,
+                                  LOG2_SAMPLE_SIZE - 2, 1, &peak);
+
+    /* Then untangle the spectra of the even and odd samples. */
+    return exponent + rfft_split(data, peak);
+}
+
+
+/*
+ * rfft_reorder
+ *
+ * Description: Puts the output of 'rfft' (or 'rfft_ring') in natural order, in
+ *              place, so that point k holds bin k. Each point is swapped with
+ *              its partner from the table of bit-reversed positions, so no
+ *              positions are worked out as it goes.
+ *
+ * Arguments:   data  The 'SAMPLE_SIZE / 2' points output by 'rfft'.
+ *
+ * Notes:       The first point still holds bins 0 and SAMPLE_SIZE/2. The
+ *              partners over 'LOG2_SAMPLE_SIZE - 1' bits are the even entries
+ *              of 'bitrev'. Every pair shows up twice in the table, so it is
+ *              only swapped from its lower end. The first and last points are
+ *              their own partners, so they are skipped.
+ */
+void rfft_reorder(complex *data)
+{
+    unsigned int i;             /* Point being placed. */
+    unsigned int j;             /* Its partner. */
+    const bitrev_index *pair;   /* Entry of the table for point i. */
+    complex t;
+
+
+    pair = &bitrev[2];
+    for (i = 1; i < SAMPLE_SIZE / 2 - 1; i++, pair += 2)
+    {
+        j = get_bitrev(pair);
+        if (i < j) {
+            t = data[i];
+            data[i] = data[j];
+            data[j] = t;
+        }
+    }
+}
+
+
+/*
+ * fft_q15_passes
+ *
+ * Description: Does the passes of butterflies for 'fft_q15', starting from a
+ *              given stride.
+ *
+ * Arguments:   data    An array of 'SAMPLE_SIZE' Q15 complex numbers.
+ *              stride  The stride of the first pass to do.
+ *              peak    The largest magnitude of any part of the data.
+ *
+ * Returns:     Returns the number of bits the block was shifted down by.
+ */
+static unsigned char fft_q15_passes(complex_q15 *data, unsigned int stride,
+                                    unsigned int peak)
+{
+    unsigned int j, k;          /* Loop indices. */
+    unsigned int m;             /* Index of the current cluster. */
+    unsigned char exponent = 0; /* Total shift applied to the block. */
+
+    /* Keep going until the last pass (with a stride of 1) is done. */
+    for (; stride > 0; stride /= 2)
+    {
+        /* Make sure that this pass cannot overflow. */
+        exponent += block_scale_q15(data, SAMPLE_SIZE, peak);
+        peak = 0;
+
+        for (j = 0, m = 0; j < SAMPLE_SIZE; j += 2*stride, m++)
         {
-            /*
-             * Iterate over every butterfly in the cluster. This will use one
-             * data point in the cluster, and one in the next cluster. We then
-             * stride over the next butterfly cluster to avoid redoing this
-             * computation.
-             */
+            /* Get the root for this cluster. */
+            complex_q15 w = get_root_q15(m);
+
             for (k = j; k < j + stride; k++)
             {
-                /* Get the two data points that we are transforming. */
-                complex a = data[k];
-                complex b = data[k+stride];
-
-                /* Since the roots are stored in bit-reversed order, we can just
-                 * index into the array with the butterfly index. */
-                complex w = root[j];
+                /* Transform them using a butterfly. */
+                butterfly_q15(&data[k], &data[k+stride], w);
 
-                /* The negative of the root is just 180 degrees around the unit
-                 * circle. */
-                complex neg_w = root[j + SAMPLE_SIZE / 2];
-
-                /* Now transform them using a butterfly. */
-                data[k]         = add(a, mul(b, w));
-                data[k+stride]  = add(a, mul(b, neg_w));
+                /* Keep track of the largest output for the next pass. */
+                peak = peak_of_q15(peak, data[k]);
+                peak = peak_of_q15(peak, data[k+stride]);
             }
         }
+    }
 
-        /* Reduce the stride for the next pass over the data. */
-        stride /= 2;
+    return exponent;
+}
+
+
+/*
+ * fft_q15
+ *
+ * Description: Computes the fast Fourier transform (FFT) of an array of Q15
+ *              input data. This is the same transform as 'fft', with the same
+ *              block floating point scaling and the same output order, but
+ *              using 16-bit parts for each point. This takes twice the memory
+ *              and more clocks per butterfly, but is much more accurate.
+ *
+ * Arguments:   data An array of 'SAMPLE_SIZE' Q15 complex numbers for
+ *                   performing the FFT.
+ *
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Notes:       See 'fft' for a description of how the loops work.
+ */
+unsigned char fft_q15(complex_q15 *data)
+{
+    unsigned int i;             /* Loop index. */
+    unsigned int peak;          /* Largest magnitude in the block. */
+
+
+    /* Find the peak of the input so the first pass can be scaled. */
+    peak = 0;
+    for (i = 0; i < SAMPLE_SIZE; i++) {
+        peak = peak_of_q15(peak, data[i]);
     }
+
+    /* Start with two clusters filling the data set. */
+    return fft_q15_passes(data, SAMPLE_SIZE / 2, peak);
 }
 
 
 /*
- * is_fft_match
+ * fft_q15_ring
  *
- * Description: Determines if the given frequency spectrum data is an
- *              approximate match for the previously recorded data (the 'key').
- *              The key that this data will be compared to is stored in ROM at
- *              compile time. This function will first take the (integer) log2
- *              of the magnitude of the input data in order to normalize it.
- *              Then, the difference between this data and the key is
- *              calculated, squared, and accumulated to get a measure of the
- *              error. This is compared to a set threshold: above the threshold,
- *              0 is returns; below the threshold, 1 is returned.
+ * Description: Computes the same transform as 'fft_q15', but reads the
+ *              'SAMPLE_SIZE' real samples straight out of a ring buffer. The
+ *              samples are Q15 numbers, as the ADC stores them for 'fft_q15'.
+ *              The first pass of butterflies is done as the samples are read,
+ *              so the window is never copied and the ring is left untouched;
+ *              the result is written to 'data'.
  *
- * Arguments:   data -- The data to compare to the key to determine whether or
- *                      not there is a match.
+ * Arguments:   data   An array of 'SAMPLE_SIZE' Q15 complex numbers to hold the
+ *                     output.
+ *              ring   The ring buffer of real Q15 samples.
+ *              start  The index in the ring of the first sample in the window.
+ *              mask   One less than the size of the ring, which must be a
+ *                     power of two.
  *
- * Returns:     Returns 0 if the input data is dissimilar to the key.
- *              Returns 1 if the input data matches the key, within some error.
+ * Returns:     Returns the block exponent of the output.
  *
- * Notes:       This function is very slow and probably won't give very good
- *              results. Ideally, some more sophisticated analysis on a more
- *              powerful chip should be used.
+ * Notes:       See 'rfft_ring'.
  */
-unsigned char is_fft_match(complex *data)
+unsigned char fft_q15_ring(complex_q15 *data, const short *ring,
+                           unsigned int start, unsigned int mask)
 {
-    double mag;
-    unsigned int i;
-    unsigned char cmpval;
-    unsigned long err = 0;
+    unsigned int i;             /* Loop index. */
+    unsigned int peak;          /* Largest magnitude in the block. */
+    unsigned char shift;        /* Scaling for the first pass. */
+    unsigned int round;         /* Half an LSB after shifting. */
+    int a, b;                   /* Samples of a butterfly, after scaling. */
+    complex_q15 x;              /* A sample as a Q15 number. */
+
 
-    /* Transform each point of the input data. */
+    /* Find the peak of the window so the first pass can be scaled. */
+    peak = 0;
+    x.imag = 0;
     for (i = 0; i < SAMPLE_SIZE; i++)
     {
-        /* First, take the log of the magnitude of the data. This will fit in an
-         * 8-bit char. */
+        x.real = ring[(start + i) & mask];
+        peak = peak_of_q15(peak, x);
+    }
+
+    shift = scale_shift(peak, BFP_LIMIT_Q15);
+    round = (shift != 0) ? 1U << (shift - 1) : 0;
+
+    /* The first pass has a single cluster using the root 1, and the inputs are
+     * purely real, so it is just a sum and a difference of samples. */
+    peak = 0;
+    for (i = 0; i < SAMPLE_SIZE / 2; i++)
+    {
+        a = ((long)ring[(start + i) & mask] + round) >> shift;
+        b = ((long)ring[(start + i + SAMPLE_SIZE/2) & mask] + round) >> shift;
+
+        data[i].real                    = a + b;
+        data[i].imag                    = 0;
+        data[i + SAMPLE_SIZE / 2].real  = a - b;
+        data[i + SAMPLE_SIZE / 2].imag  = 0;
+
+        peak = peak_of_q15(peak, data[i]);
+        peak = peak_of_q15(peak, data[i + SAMPLE_SIZE / 2]);
+    }
+
+    /* Finish the transform from the second pass on. */
+    return shift + fft_q15_passes(data, SAMPLE_SIZE / 4, peak);
+}
+
+
+/*
+ * fft_q15_reorder
+ *
+ * Description: Puts the output of 'fft_q15' (or 'fft_q15_ring') in natural
+ *              order, in place, so that point k holds bin k. See
+ *              'rfft_reorder'.
+ *
+ * Arguments:   data  The 'SAMPLE_SIZE' points output by 'fft_q15'.
+ */
+void fft_q15_reorder(complex_q15 *data)
+{
+    unsigned int i;             /* Point being placed. */
+    unsigned int j;             /* Its partner. */
+    const bitrev_index *pair;   /* Entry of the table for point i. */
+    complex_q15 t;
+
+
+    pair = &bitrev[1];
+    for (i = 1; i < SAMPLE_SIZE - 1; i++, pair++)
+    {
+        j = get_bitrev(pair);
+        if (i < j) {
+            t = data[i];
+            data[i] = data[j];
+            data[j] = t;
+        }
+    }
+}
+
+
+/*
+ * fft_logs
+ *
+ * Description: Takes the (integer) log10 of the magnitude of each bin of the
+ *              given frequency spectrum in order to normalize it. The block
+ *              exponent from the FFT is applied first, so the true magnitude
+ *              is used rather than the scaled one.
+ *
+ * Arguments:   data -- The output of 'rfft'. This is put in natural order in
+ *                      place.
+ *              exponent -- The block exponent returned by 'rfft'.
+ *              logs -- Filled in with the 'KEY_BINS' log magnitudes.
+ *
+ * Notes:       The logs are in the same order as the keys: the 'SAMPLE_SIZE /
+ *              2 + 1' unique bins in natural order, with bin SAMPLE_SIZE/2
+ *              last.
+ */
+void fft_logs(complex *data, unsigned char exponent, unsigned char *logs)
+{
+    unsigned int i;
+    unsigned long mag;
+
+    /* Put the bins in the same order as the keys. */
+    rfft_reorder(data);
+
+    /* The first point holds bins 0 and N/2, which are both real. The magnitude
+     * is squared, so the block exponent is applied twice. */
+    mag = data[0].real * data[0].real;
+    logs[0] = ilog10(mag, 2 * exponent);
+    mag = data[0].imag * data[0].imag;
+    logs[SAMPLE_SIZE / 2] = ilog10(mag, 2 * exponent);
+
+    /* Take the log of the rest of the bins. */
+    for (i = 1; i < SAMPLE_SIZE / 2; i++)
+    {
         mag = data[i].real * data[i].real + data[i].imag * data[i].imag;
-        cmpval = (char)log10(mag);
+        logs[i] = ilog10(mag, 2 * exponent);
+    }
+}
+
+
+/*
+ * fft_logs_q15
+ *
+ * Description: Takes the log magnitude of each bin of the given Q15 frequency
+ *              spectrum. This works just like 'fft_logs', but the magnitudes
+ *              are scaled back down to the units of the 8-bit datapath (the
+ *              ADC stores samples shifted up by 8 bits) so the same keys can be
+ *              used.
+ *
+ * Arguments:   data -- The output of 'fft_q15'. This is put in natural order in
+ *                      place.
+ *              exponent -- The block exponent returned by 'fft_q15'.
+ *              logs -- Filled in with the 'KEY_BINS' log magnitudes.
+ *
+ * Notes:       'fft_q15' is a full complex transform, so only the first half
+ *              of its output (and bin SAMPLE_SIZE/2) is needed.
+ */
+void fft_logs_q15(complex_q15 *data, unsigned char exponent,
+                  unsigned char *logs)
+{
+    unsigned int i;
+    unsigned long mag;
 
-        /* Now calculate the absolute value of the error, and accumulate it. */
-        err += abs(cmpval - key[i]);
+    /* The samples were shifted up by 8 bits, so the squared magnitudes are 16
+     * bits too large. */
+    signed char shift = 2 * exponent - 16;
+
+    /* Put the bins in the same order as the keys. */
+    fft_q15_reorder(data);
+
+    for (i = 0; i < KEY_BINS; i++)
+    {
+        mag = (long)data[i].real * data[i].real
+            + (long)data[i].imag * data[i].imag;
+        logs[i] = ilog10(mag, shift);
     }
+}
+
+
+/*
+ * fft_match
+ *
+ * Description: Finds which enrolled dog (if any) the given frequency spectrum
+ *              matches. The log magnitude of each bin is taken with
+ *              'fft_logs', then the table of keys is searched for the closest
+ *              match with 'key_search'.
+ *
+ * Arguments:   data -- The output of 'rfft' to compare to the keys. This is
+ *                      put in natural order in place.
+ *              exponent -- The block exponent returned by 'rfft'.
+ *
+ * Returns:     Returns the ID of the dog that matches, or 'NO_DOG' if the data
+ *              is dissimilar to all of the keys.
+ */
+unsigned char fft_match(complex *data, unsigned char exponent)
+{
+    unsigned char logs[KEY_BINS];   /* Log magnitude of each bin. */
+
+    fft_logs(data, exponent, logs);
+
+    /* Find the dog that is the closest match. */
+    return key_search(logs, NULL, KEY_BINS, 0);
+}
+
+
+/*
+ * fft_match_q15
+ *
+ * Description: Finds which enrolled dog (if any) the given Q15 frequency
+ *              spectrum matches. This works just like 'fft_match', with the
+ *              log magnitudes from 'fft_logs_q15'.
+ *
+ * Arguments:   data -- The output of 'fft_q15' to compare to the keys. This is
+ *                      put in natural order in place.
+ *              exponent -- The block exponent returned by 'fft_q15'.
+ *
+ * Returns:     Returns the ID of the dog that matches, or 'NO_DOG' if the data
+ *              is dissimilar to all of the keys.
+ */
+unsigned char fft_match_q15(complex_q15 *data, unsigned char exponent)
+{
+    unsigned char logs[KEY_BINS];   /* Log magnitude of each bin. */
+
+    fft_logs_q15(data, exponent, logs);
 
-    /* Return true iff the error is below the error threshold. */
-    return (err < ERROR_THRESHOLD);
+    /* Find the dog that is the closest match. */
+    return key_search(logs, NULL, KEY_BINS, 0);
 }
@@ -20,6 +20,17 @@
  * Revision History:
  *      16 Apr 2015     Brian Kubisiak      Initial revision.
  *      06 Jun 2015     Brian Kubisiak      Added method for FFT comparison.
+ *      16 Oct 2026     agent               Block-floating-point scaling.
+ *      16 Oct 2026     agent               Added Q15 FFT.
+ *      16 Oct 2026     agent               Added real-input FFT.
+ *      16 Oct 2026     agent               Added radix-4 passes.
+ *      16 Oct 2026     agent               Transforms that read from a ring.
+ *      16 Oct 2026     agent               Match against several dogs.
+ *      16 Oct 2026     agent               Added the reordering passes.
+ *      16 Oct 2026     agent               Split the log spectrum out of the
+ *                                          matcher.
+ *      16 Oct 2026     agent               Optional assembly radix-4 kernel.
+ *      16 Oct 2026     agent               Read 16-bit samples from the ring.
  */
 
 
@@ -35,48 +46,269 @@
  *
  * Description: Computes the fast Fourier transform (FFT) of an array of input
  *              data. This implementation is in-place, so it will take O(1)
- *              space. Additionally, optimizations are performed assuming that
- *              the data to transform is purely real. The implementation assumes
- *              8-bit characters and 16-bit shorts. It attempts to avoid 16-bit
- *              additions/multiplications wherever possible in order to cut down
- *              on the number of clocks.
+ *              space. The implementation assumes 8-bit characters and 16-bit
+ *              shorts. It attempts to avoid 16-bit additions/multiplications
+ *              wherever possible in order to cut down on the number of clocks.
+ *
+ *              The transform uses block floating point: before each pass, the
+ *              whole block is checked for headroom and shifted down if the
+ *              butterflies could overflow 8 bits. The total number of bits
+ *              shifted is returned as a shared exponent for the block, so the
+ *              true result is the output multiplied by 2^exponent.
+ *
+ *              The passes are done two at a time (radix 4) to cut down on
+ *              loads, stores, and multiplies, with a single radix-2 pass at
+ *              the end if 'LOG2_SAMPLE_SIZE' is odd.
  *
  * Arguments:   data An array of complex numbers for performing the FFT. This
  *                   FFT assumes that the array contains 'SAMPLE_SIZE' values of
  *                   type 'complex'. Both of these are defined in 'data.h'.
  *
- * Limitations: Assumes that the input data is purely real. Because there is no
- *              FPU and fixed-point arithmetic is used, the resulting FFT will
- *              not be normalized to anything sensible.
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Limitations: Because there is no FPU and fixed-point arithmetic is used, the
+ *              resulting FFT will not be normalized to anything sensible. For
+ *              purely real input, 'rfft' does the same job in about half the
+ *              time and memory.
+ */
+unsigned char fft(complex *data);
+
+
+/*
+ * fft_radix2
+ *
+ * Description: Computes the same transform as 'fft', but only using radix-2
+ *              passes. This is the plain reference version of the transform,
+ *              kept for comparing against the faster kernels.
+ *
+ * Arguments:   data An array of 'SAMPLE_SIZE' complex numbers for performing
+ *                   the FFT.
+ *
+ * Returns:     Returns the block exponent of the output.
+ */
+unsigned char fft_radix2(complex *data);
+
+
+/*
+ * fft_clusters4
+ * fft_clusters4_avr
+ *
+ * Description: Do the clusters of a radix-4 pass that need real multiplies,
+ *              which is every cluster but the first. 'fft_clusters4' is the
+ *              reference version in C, and 'fft_clusters4_avr' is the hand
+ *              written version for the ATmega2560 (in 'fft_avr.S'), which the
+ *              board uses if built with 'USE_ASM_BUTTERFLY'. Both give exactly
+ *              the same output; 'test-butterfly' checks this.
+ *
+ * Arguments:   data      The first point of the second cluster of the pass.
+ *              clusters  The number of clusters to do, each of '2 * stride'
+ *                        points, starting with cluster 1.
+ *              stride    The stride of the first of the two butterflies of
+ *                        the pass; must be at least 2.
+ *              peak      The largest magnitude of the output so far.
+ *
+ * Returns:     Returns the largest magnitude of the output, including 'peak'.
+ */
+unsigned char fft_clusters4(complex *data, unsigned char clusters,
+                            unsigned int stride, unsigned char peak);
+unsigned char fft_clusters4_avr(complex *data, unsigned char clusters,
+                                unsigned int stride, unsigned char peak);
+
+
+/*
+ * rfft
+ *
+ * Description: Computes the FFT of 'SAMPLE_SIZE' purely real samples. The
+ *              samples are packed two to a point, with even samples in the
+ *              real parts and odd samples in the imaginary parts, so the input
+ *              is only 'SAMPLE_SIZE / 2' points. These are transformed with a
+ *              half-size complex FFT, and then a split pass untangles the
+ *              spectra of the even and odd samples to get the first half of
+ *              the spectrum of the real signal. The second half is just the
+ *              complex conjugate of the first, so it is not computed.
+ *
+ * Arguments:   data An array of 'SAMPLE_SIZE / 2' complex numbers, each
+ *                   holding two consecutive real samples.
+ *
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Notes:       The output is in bit-reversed order just like 'fft', but over
+ *              'LOG2_SAMPLE_SIZE - 1' bits. Bins 0 and SAMPLE_SIZE/2 are both
+ *              purely real, so they are packed together into the first point:
+ *              the real part is bin 0 and the imaginary part is bin
+ *              SAMPLE_SIZE/2.
+ */
+unsigned char rfft(complex *data);
+
+/*
+ * rfft_ring
+ *
+ * Description: Computes the same transform as 'rfft', but reads the
+ *              'SAMPLE_SIZE' real samples straight out of a ring buffer rather
+ *              than from a packed array. The first pass of butterflies is done
+ *              as the samples are read, so the window is never copied and the
+ *              ring is left untouched; the result is written to 'data'.
+ *
+ * Arguments:   data   An array of 'SAMPLE_POINTS' complex numbers to hold the
+ *                     output. This must not overlap the ring.
+ *              ring   The ring buffer of real samples.
+ *              start  The index in the ring of the first sample in the window.
+ *              mask   One less than the size of the ring, which must be a
+ *                     power of two. Indices into the ring wrap around with it.
+ *
+ * Returns:     Returns the block exponent of the output.
+ *
+ * Notes:       The output is in the same order as for 'rfft'.
+ */
+unsigned char rfft_ring(complex *data, const char *ring, unsigned int start,
+                        unsigned int mask);
+
+
+/*
+ * rfft_reorder
+ *
+ * Description: Puts the output of 'rfft' (or 'rfft_ring') in natural order, in
+ *              place, so that point k holds bin k. Each point is swapped with
+ *              its partner from the table of bit-reversed positions, so no
+ *              positions are worked out as it goes.
+ *
+ * Arguments:   data  The 'SAMPLE_SIZE / 2' points output by 'rfft'.
+ *
+ * Notes:       The first point still holds bins 0 and SAMPLE_SIZE/2.
  */
-void fft(complex *data);
+void rfft_reorder(complex *data);
 
+/*
+ * fft_q15
+ *
+ * Description: Computes the fast Fourier transform (FFT) of an array of Q15
+ *              input data. This is the same transform as 'fft', with the same
+ *              block floating point scaling and the same output order, but
+ *              using 16-bit parts for each point. This takes twice the memory
+ *              and more clocks per butterfly, but is much more accurate.
+ *
+ * Arguments:   data An array of 'SAMPLE_SIZE' Q15 complex numbers for
+ *                   performing the FFT.
+ *
+ * Returns:     Returns the block exponent of the output.
+ */
+unsigned char fft_q15(complex_q15 *data);
 
 /*
- * is_fft_match
+ * fft_q15_ring
  *
- * Description: Determines if the given frequency spectrum data is an
- *              approximate match for the previously recorded data. The data
- *              that this will be compared to is stored in ROM at compile time.
- *              This function will first take the (integer) log2 of the
- *              magnitude of the input data in order to normalize it. Then, the
- *              difference between this data and the comparison values is
- *              calculated, squared, and accumualted to get a measure of the
- *              error. This is compared to a set threshold: above the threshold,
- *              0 is returns; below the threshold, 1 is returned.
+ * Description: Computes the same transform as 'fft_q15', but reads the
+ *              'SAMPLE_SIZE' real samples straight out of a ring buffer. The
+ *              samples are Q15 numbers, as the ADC stores them for 'fft_q15'.
+ *              The first pass of butterflies is done as the samples are read,
+ *              so the window is never copied and the ring is left untouched;
+ *              the result is written to 'data'.
  *
- * Arguments:   data -- The data to compare to the previously-recorded data to
- *                      determine whether or not there is a match.
+ * Arguments:   data   An array of 'SAMPLE_SIZE' Q15 complex numbers to hold the
+ *                     output.
+ *              ring   The ring buffer of real Q15 samples.
+ *              start  The index in the ring of the first sample in the window.
+ *              mask   One less than the size of the ring, which must be a
+ *                     power of two.
  *
- * Returns:     Returns 0 if the input data is dissimilar to the comparison
- *              data. Returns 1 if the input data matches the comparison data,
- *              within some error.
+ * Returns:     Returns the block exponent of the output.
+ */
+unsigned char fft_q15_ring(complex_q15 *data, const short *ring,
+                           unsigned int start, unsigned int mask);
+
+
+/*
+ * fft_q15_reorder
+ *
+ * Description: Puts the output of 'fft_q15' (or 'fft_q15_ring') in natural
+ *              order, in place, so that point k holds bin k. See
+ *              'rfft_reorder'.
+ *
+ * Arguments:   data  The 'SAMPLE_SIZE' points output by 'fft_q15'.
+ */
+void fft_q15_reorder(complex_q15 *data);
+
+/*
+ * fft_logs
+ *
+ * Description: Takes the (integer) log10 of the magnitude of each bin of the
+ *              given frequency spectrum in order to normalize it. The block
+ *              exponent from the FFT is applied first, so the true magnitude
+ *              is used rather than the scaled one.
+ *
+ * Arguments:   data -- The output of 'rfft'. This is put in natural order in
+ *                      place.
+ *              exponent -- The block exponent returned by 'rfft'.
+ *              logs -- Filled in with the 'KEY_BINS' log magnitudes.
+ *
+ * Notes:       The logs are in the same order as the keys: the 'SAMPLE_SIZE /
+ *              2 + 1' unique bins in natural order, with bin SAMPLE_SIZE/2
+ *              last.
+ */
+void fft_logs(complex *data, unsigned char exponent, unsigned char *logs);
+
+/*
+ * fft_logs_q15
+ *
+ * Description: Takes the log magnitude of each bin of the given Q15 frequency
+ *              spectrum. This works just like 'fft_logs', but the magnitudes
+ *              are scaled back down to the units of the 8-bit datapath (the
+ *              ADC stores samples shifted up by 8 bits) so the same keys can be
+ *              used.
+ *
+ * Arguments:   data -- The output of 'fft_q15'. This is put in natural order in
+ *                      place.
+ *              exponent -- The block exponent returned by 'fft_q15'.
+ *              logs -- Filled in with the 'KEY_BINS' log magnitudes.
+ *
+ * Notes:       'fft_q15' is a full complex transform, so only the first half
+ *              of its output (and bin SAMPLE_SIZE/2) is needed.
+ */
+void fft_logs_q15(complex_q15 *data, unsigned char exponent,
+                  unsigned char *logs);
+
+/*
+ * fft_match
+ *
+ * Description: Finds which enrolled dog (if any) the given frequency spectrum
+ *              matches. The keys that this data will be compared to are stored
+ *              in ROM at compile time (or enrolled on the board). This function
+ *              will first take the (integer) log10 of the magnitude of the
+ *              input data with 'fft_logs'. Then, the difference between this
+ *              data and each key is calculated, and the absolute value is
+ *              accumulated to get a measure of the error. The dog with the
+ *              smallest error wins, as long as it is below the dog's threshold.
+ *              The data is put in natural order first, which is the order that
+ *              the keys are in.
+ *
+ * Arguments:   data -- The output of 'rfft' to compare to the keys. This is
+ *                      reordered in place.
+ *              exponent -- The block exponent returned by 'rfft'.
+ *
+ * Returns:     Returns the ID of the dog that matches, or 'NO_DOG' if the data
+ *              is dissimilar to all of the keys.
  *
  * Notes:       This function is very slow and probably won't give very good
  *              results. Ideally, some more sophisticated analysis on a more
  *              powerful chip should be used.
  */
-unsigned char is_fft_match(complex *data);
+unsigned char fft_match(complex *data, unsigned char exponent);
 
 
+/*
+ * fft_match_q15
+ *
+ * Description: Finds which enrolled dog (if any) the given Q15 frequency
+ *              spectrum matches. This works just like 'fft_match', with the
+ *              log magnitudes from 'fft_logs_q15'.
+ *
+ * Arguments:   data -- The output of 'fft_q15' to compare to the keys. This is
+ *                      reordered in place.
+ *              exponent -- The block exponent returned by 'fft_q15'.
+ *
+ * Returns:     Returns the ID of the dog that matches, or 'NO_DOG' if the data
+ *              is dissimilar to all of the keys.
+ */
+unsigned char fft_match_q15(complex_q15 *data, unsigned char exponent);
+
 #endif /* end of include guard: _FFT_H_ */
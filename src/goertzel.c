@@ -0,0 +1,334 @@
+/*
+ * goertzel.c
+ *
+ * Partial spectrum matching with the Goertzel algorithm.
+ *
+ * This file contains code for matching a recording against the key without
+ * doing a full FFT. Most of the bins of the key are flat, and carry no
+ * information about the dog; only the few bins that stand out from the rest are
+ * worth checking. Those bins are computed with Goertzel recurrences, which are
+ * updated one sample at a time as the ADC records them. Once the last sample
+ * comes in, the only work left is to take the magnitudes of the few bins and
+ * compare them to the key.
+ *
+ * For bin k, the recurrence is
+ *      s[n] = x[n] + 2 cos(2 pi k / N) s[n-1] - s[n-2]
+ * and after the last sample, the squared magnitude of the bin is
+ *      |X[k]|^2 = s[N-1]^2 + s[N-2]^2 - 2 cos(2 pi k / N) s[N-1] s[N-2].
+ * Nothing in here is built without 'USE_GOERTZEL', so that the state of the
+ * recurrences takes no SRAM in the other builds.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Match against several dogs.
+ *      16 Oct 2026     agent               Read tables from program memory.
+ *      16 Oct 2026     agent               Use the HAL for interrupts.
+ *      16 Oct 2026     agent               Keys are in natural order.
+ *      16 Oct 2026     agent               Only build with the matcher.
+ */
+
+#include <stdlib.h>
+
+#include "goertzel.h"
+#include "hal.h"
+#include "key.h"
+#include "progmem.h"
+
+#ifdef USE_GOERTZEL
+
+#if GOERTZEL_BINS > KEY_BINS
+#error "GOERTZEL_BINS is larger than the number of bins in the key"
+#endif
+
+/*
+ * Error allowed over all of the bins checked, for every dog. The bins picked
+ * are the ones that stand out, so they are held to less than half a decade
+ * each on average; the dogs' own thresholds are for all of the bins, and
+ * allowing that much error over just these lets plain noise through.
+ */
+#define ERROR_THRESHOLD (GOERTZEL_BINS / 2)
+
+/* Largest state that can be squared without overflowing the magnitude. */
+#define STATE_LIMIT     0x3FFFL
+
+/* Roots of unity for the FFT, and the bit-reversed positions, in program
+ * memory. */
+extern const complex_q15 root_q15[SAMPLE_SIZE] PROGMEM;
+extern const bitrev_index bitrev[SAMPLE_SIZE] PROGMEM;
+
+/* Reads an entry of 'bitrev', whatever size it is. */
+#if SAMPLE_SIZE <= 256
+#define get_bitrev(p)   pgm_read_byte(p)
+#else
+#define get_bitrev(p)   pgm_read_word(p)
+#endif
+
+static unsigned int bins[GOERTZEL_BINS];    /* Index in the key of each bin. */
+static int coeff[GOERTZEL_BINS];            /* cos(2 pi k / N), in Q15. */
+
+/* The last two states of each recurrence, and their values at the end of the
+ * last recording. */
+static long s1[GOERTZEL_BINS], s2[GOERTZEL_BINS];
+static long res1[GOERTZEL_BINS], res2[GOERTZEL_BINS];
+static volatile unsigned char ready = 0;
+
+
+/*
+ * mul_coeff
+ *
+ * Description: Multiplies a state of a recurrence by twice a Q15 coefficient,
+ *              rounding the result. The state is split into 16-bit halves so
+ *              that neither product needs more than 32 bits.
+ *
+ * Arguments:   s  The state to multiply.
+ *              c  The Q15 coefficient.
+ *
+ * Returns:     Returns 2 * c * s, with c taken as a fraction.
+ */
+static long mul_coeff(long s, int c)
+{
+    long hi = s >> 16;                  /* Signed top half of the state. */
+    unsigned int lo = s & 0xFFFF;       /* Unsigned bottom half. */
+
+    /* 2 c s = c (hi 2^16 + lo) / 2^14. */
+    return (long)c * hi * 4 + (((long)c * lo + 0x2000) >> 14);
+}
+
+
+/*
+ * goertzel_init
+ *
+ * Description: Picks the bins of the keys to check, and gets the coefficients
+ *              for their recurrences. For each dog, the distance of each bin
+ *              from the most common value in its key is found; the bins picked
+ *              are the ones with the largest total distance over all the dogs.
+ *
+ * Notes:       This must be called before any of the other functions, and
+ *              again whenever the keys change. The keys are in natural order,
+ *              so the bin at index k of a key is bin k. The roots of unity are
+ *              in bit-reversed order, so the coefficient for bin k is the real
+ *              part of the root at 'bitrev[2k]' (which is k reversed over one
+ *              bit less). The last entry of a key is bin SAMPLE_SIZE/2,
+ *              whose coefficient is -1.
+ */
+void goertzel_init(void)
+{
+    unsigned int i, j;          /* Loop indices. */
+    unsigned int count, best;   /* For finding the most common value. */
+    unsigned char common;       /* The most common value in a key. */
+    unsigned int dist[KEY_BINS];/* Total distance of each bin. */
+    unsigned int bestdist;
+    unsigned char d;            /* Dog being looked at. */
+    unsigned char k;            /* Bin being picked. */
+    unsigned char taken;
+
+
+    for (i = 0; i < KEY_BINS; i++) {
+        dist[i] = 0;
+    }
+
+    for (d = 0; d < num_keys; d++)
+    {
+        /* Find the most common value in the key; this is the flat part that
+         * does not say anything about the dog. */
+        best = 0;
+        common = 0;
+        for (i = 0; i < KEY_BINS; i++)
+        {
+            count = 0;
+            for (j = 0; j < KEY_BINS; j++)
+            {
+                if (key_bin(d, j) == key_bin(d, i)) {
+                    count++;
+                }
+            }
+
+            if (count > best) {
+                best = count;
+                common = key_bin(d, i);
+            }
+        }
+
+        /* Add up how far each bin is from it. */
+        for (i = 0; i < KEY_BINS; i++) {
+            dist[i] += abs(key_bin(d, i) - common);
+        }
+    }
+
+    /* Pick the bins that are furthest out, one at a time. Ties go to the first
+     * bin in the key. */
+    for (k = 0; k < GOERTZEL_BINS; k++)
+    {
+        bestdist = 0;
+        bins[k] = KEY_BINS;
+
+        for (i = 0; i < KEY_BINS; i++)
+        {
+            /* Skip any bin that was already picked. */
+            taken = 0;
+            for (j = 0; j < k; j++)
+            {
+                if (bins[j] == i) {
+                    taken = 1;
+                }
+            }
+
+            if (!taken && (bins[k] == KEY_BINS || dist[i] > bestdist)) {
+                bins[k] = i;
+                bestdist = dist[i];
+            }
+        }
+
+        /* Get the coefficient for the bin. */
+        if (bins[k] == SAMPLE_SIZE / 2) {
+            coeff[k] = -(short)pgm_read_word(&root_q15[0].real);
+        }
+        else {
+            j = get_bitrev(&bitrev[2 * bins[k]]);
+            coeff[k] = (short)pgm_read_word(&root_q15[j].real);
+        }
+    }
+
+    goertzel_start();
+    ready = 0;
+}
+
+
+/*
+ * goertzel_start
+ *
+ * Description: Resets the recurrences to start on a new recording.
+ *
+ * Notes:       This is called by the ADC when a recording is triggered.
+ */
+void goertzel_start(void)
+{
+    unsigned char k;
+
+    for (k = 0; k < GOERTZEL_BINS; k++)
+    {
+        s1[k] = 0;
+        s2[k] = 0;
+    }
+}
+
+
+/*
+ * goertzel_update
+ *
+ * Description: Runs one step of the recurrence for each of the bins with a new
+ *              sample.
+ *
+ * Arguments:   x  The new sample.
+ *
+ * Notes:       This is called by the ADC interrupt for every sample, so it has
+ *              to be fast.
+ */
+void goertzel_update(char x)
+{
+    unsigned char k;
+    long s0;
+
+    for (k = 0; k < GOERTZEL_BINS; k++)
+    {
+        s0 = x + mul_coeff(s1[k], coeff[k]) - s2[k];
+        s2[k] = s1[k];
+        s1[k] = s0;
+    }
+}
+
+
+/*
+ * goertzel_finish
+ *
+ * Description: Saves the state of the recurrences after the last sample of a
+ *              recording, so that the main loop can check it against the key.
+ *
+ * Notes:       This is called by the ADC interrupt once 'SAMPLE_SIZE' samples
+ *              have been recorded. If the last result has not been checked yet,
+ *              it is replaced.
+ */
+void goertzel_finish(void)
+{
+    unsigned char k;
+
+    for (k = 0; k < GOERTZEL_BINS; k++)
+    {
+        res1[k] = s1[k];
+        res2[k] = s2[k];
+    }
+
+    ready = 1;
+}
+
+
+/*
+ * goertzel_result
+ *
+ * Description: Checks whether a recording has finished, and if so, compares
+ *              the bins that were computed against the keys. The (integer)
+ *              log10 of the magnitude of each bin is taken, and the keys are
+ *              searched for the closest match with 'key_search'.
+ *
+ * Arguments:   dog  Set to the ID of the dog that matches, or to 'NO_DOG' if
+ *                   none of them do. Only set if there was a result.
+ *
+ * Returns:     Returns nonzero if there was a finished recording, or 0 if not.
+ *
+ * Notes:       Each recording is only returned once. The states are shifted
+ *              down until they fit in 15 bits so that the magnitude can be
+ *              found in 32 bits; the shift is applied to the log afterwards.
+ */
+unsigned char goertzel_result(unsigned char *dog)
+{
+    long a[GOERTZEL_BINS], b[GOERTZEL_BINS];    /* Copy of the states. */
+    unsigned char logs[GOERTZEL_BINS];          /* Log magnitude of each bin. */
+    unsigned char sreg;
+    unsigned char k;
+    unsigned char shift;
+    long mag;
+
+
+    if (!ready) {
+        return 0;
+    }
+
+    /* Copy the result with interrupts off, since the ADC could finish another
+     * recording while this one is being read. */
+    sreg = hal_irq_save();
+    for (k = 0; k < GOERTZEL_BINS; k++)
+    {
+        a[k] = res1[k];
+        b[k] = res2[k];
+    }
+    ready = 0;
+    hal_irq_restore(sreg);
+
+    for (k = 0; k < GOERTZEL_BINS; k++)
+    {
+        /* Scale the states down so that the products fit. */
+        shift = 0;
+        while (labs(a[k]) > STATE_LIMIT || labs(b[k]) > STATE_LIMIT)
+        {
+            a[k] >>= 1;
+            b[k] >>= 1;
+            shift++;
+        }
+
+        /* Rounding can push a tiny magnitude below zero. */
+        mag = a[k] * a[k] + b[k] * b[k] - mul_coeff(a[k], coeff[k]) * b[k];
+        if (mag < 0) {
+            mag = 0;
+        }
+
+        /* The magnitude is squared, so the shift is applied twice. */
+        logs[k] = ilog10(mag, 2 * shift);
+    }
+
+    /* Find the dog that is the closest match on just these bins. */
+    *dog = key_search(logs, bins, GOERTZEL_BINS, ERROR_THRESHOLD);
+
+    return 1;
+}
+
+#endif
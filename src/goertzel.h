@@ -0,0 +1,96 @@
+/*
+ * goertzel.h
+ *
+ * Partial spectrum matching with the Goertzel algorithm.
+ *
+ * This file contains an interface for matching a recording against the key
+ * without doing a full FFT. Most of the bins of the key are flat, and carry no
+ * information about the dog; only the few bins that stand out from the rest are
+ * worth checking. Those bins are computed with Goertzel recurrences, which are
+ * updated one sample at a time as the ADC records them. Once the last sample
+ * comes in, the only work left is to take the magnitudes of the few bins and
+ * compare them to the key.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Match against several dogs.
+ */
+
+#ifndef _GOERTZEL_H_
+#define _GOERTZEL_H_
+
+
+#include "data.h"
+
+
+#ifndef GOERTZEL_BINS
+#define GOERTZEL_BINS       12      /* Number of bins of the key to check. */
+#endif
+
+
+/*
+ * goertzel_init
+ *
+ * Description: Picks the bins of the keys to check, and gets the coefficients
+ *              for their recurrences. For each dog, the distance of each bin
+ *              from the most common value in its key is found; the bins picked
+ *              are the ones with the largest total distance over all the dogs.
+ *
+ * Notes:       This must be called before any of the other functions, and
+ *              again whenever the keys change.
+ */
+void goertzel_init(void);
+
+/*
+ * goertzel_start
+ *
+ * Description: Resets the recurrences to start on a new recording.
+ *
+ * Notes:       This is called by the ADC when a recording is triggered.
+ */
+void goertzel_start(void);
+
+/*
+ * goertzel_update
+ *
+ * Description: Runs one step of the recurrence for each of the bins with a new
+ *              sample.
+ *
+ * Arguments:   x  The new sample.
+ *
+ * Notes:       This is called by the ADC interrupt for every sample, so it has
+ *              to be fast.
+ */
+void goertzel_update(char x);
+
+/*
+ * goertzel_finish
+ *
+ * Description: Saves the state of the recurrences after the last sample of a
+ *              recording, so that the main loop can check it against the key.
+ *
+ * Notes:       This is called by the ADC interrupt once 'SAMPLE_SIZE' samples
+ *              have been recorded. If the last result has not been checked yet,
+ *              it is replaced.
+ */
+void goertzel_finish(void);
+
+/*
+ * goertzel_result
+ *
+ * Description: Checks whether a recording has finished, and if so, compares
+ *              the bins that were computed against the keys. The (integer)
+ *              log10 of the magnitude of each bin is taken, and the keys are
+ *              searched for the closest match with 'key_search'.
+ *
+ * Arguments:   dog  Set to the ID of the dog that matches, or to 'NO_DOG' if
+ *                   none of them do. Only set if there was a result.
+ *
+ * Returns:     Returns nonzero if there was a finished recording, or 0 if not.
+ *
+ * Notes:       Each recording is only returned once.
+ */
+unsigned char goertzel_result(unsigned char *dog);
+
+
+#endif /* end of include guard: _GOERTZEL_H_ */
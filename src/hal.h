@@ -0,0 +1,312 @@
+/*
+ * hal.h
+ *
+ * Hardware abstraction layer for the dog bowl.
+ *
+ * This file describes the interface between the dog bowl code and the hardware
+ * that it runs on. Everything that touches a register goes through the
+ * functions here, so that the rest of the code can be built either for the
+ * board or for the build host. There are two backends:
+ *      hal_avr.c    Drives the ATmega2560 peripherals on the board.
+ *      hal_posix.c  Simulates the peripherals on a POSIX host. The audio and
+ *                   the sensors are read from a script on the standard input,
+ *                   and the servo positions are logged to the standard output.
+ *
+ * The backends call back into the rest of the code when the hardware has
+ * something to report; see 'adc_sample_ready' and 'adc_trigger' in 'adc.h',
+ * 'prox_tick' in 'proximity.h', and 'enroll_rx' in 'enroll.h'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Added the trace timer and the UART.
+ *      16 Oct 2026     agent               Added sleep and the periodic tick.
+ *      16 Oct 2026     agent               Added timer-triggered sampling.
+ *      16 Oct 2026     agent               Added UART receive and the EEPROM.
+ *      16 Oct 2026     agent               Pass on 16-bit samples, and keep the
+ *                                          ADC clock at 200 kHz or less.
+ *      16 Oct 2026     agent               Added the stack peak.
+ */
+
+#ifndef _HAL_H_
+#define _HAL_H_
+
+
+#ifdef __AVR__
+#include <avr/io.h>
+#endif
+
+
+#ifndef TICK_HZ
+#define TICK_HZ             100     /* Rate of the periodic tick. */
+#endif
+
+/* If built with 'ADC_TIMER', the ADC is started by a timer at an exact rate
+ * instead of running freely off of the ADC clock. Each sample passed on to
+ * 'adc_sample_ready' is then the sum of 2^'LOG2_OVERSAMPLE' 10-bit
+ * conversions, left-adjusted to 16 bits. The ADC clock has to stay at 200 kHz
+ * or less for the full 10 bits, which at 16 MHz leaves a little over 9250
+ * conversions a second (see 'hal_avr.c'), so the default rate is just under
+ * that, and oversampling needs a lower rate. */
+#ifdef ADC_TIMER
+#ifndef SAMPLE_HZ
+#define SAMPLE_HZ           9000    /* Samples per second. */
+#endif
+#ifndef LOG2_OVERSAMPLE
+#define LOG2_OVERSAMPLE     0       /* Conversions averaged per sample. */
+#endif
+#define OVERSAMPLE          (1 << LOG2_OVERSAMPLE)
+#endif
+
+
+/*
+ * trace_time
+ *
+ * Description: Data type for a timestamp from the trace timer. This is the
+ *              16-bit Timer5 count on the board, and nanoseconds (wrapping
+ *              around) on the host.
+ */
+typedef unsigned int trace_time;
+
+/* Reads the trace timer. On the board, this reads the timer register directly,
+ * so that a trace probe stays down to a few cycles. */
+#ifdef __AVR__
+#define HAL_TRACE_TIME()    TCNT5
+#else
+#define HAL_TRACE_TIME()    hal_trace_time()
+#endif
+
+
+/*
+ * hal_init
+ *
+ * Description: Sets up anything in the backend that is not tied to one of the
+ *              peripherals below. This should be called first.
+ */
+void hal_init(void);
+
+/*
+ * hal_running
+ *
+ * Description: Lets the backend do its work between passes of the main loop.
+ *
+ * Returns:     Returns nonzero while the main loop should keep running. This is
+ *              always nonzero on the board. On the host, it returns 0 once the
+ *              script has run out and the main loop has had some time to catch
+ *              up.
+ */
+unsigned char hal_running(void);
+
+/*
+ * hal_sleep
+ *
+ * Description: Puts the CPU to sleep until the next interrupt. Interrupts must
+ *              be off when this is called; they are turned on at the same
+ *              moment that the CPU goes to sleep, so that an interrupt that
+ *              comes in just before cannot be missed. On the host, this is
+ *              where time moves forward, the samples are recorded, and the
+ *              interrupts are run.
+ *
+ * Notes:       This returns with interrupts on, after the interrupt that woke
+ *              the CPU up has run.
+ */
+void hal_sleep(void);
+
+/*
+ * hal_decision
+ *
+ * Description: Notes that the main loop has made a decision on a recording.
+ *              The host uses this to measure the time from waking up to the
+ *              decision; on the board, it does nothing.
+ */
+void hal_decision(void);
+
+
+/*
+ * hal_irq_enable
+ *
+ * Description: Turns on interrupts.
+ */
+void hal_irq_enable(void);
+
+/*
+ * hal_irq_save
+ *
+ * Description: Turns off interrupts, so that data shared with an interrupt can
+ *              be accessed safely.
+ *
+ * Returns:     Returns the interrupt state before they were turned off, to pass
+ *              to 'hal_irq_restore'.
+ */
+unsigned char hal_irq_save(void);
+
+/*
+ * hal_irq_restore
+ *
+ * Description: Puts interrupts back the way that they were before a call to
+ *              'hal_irq_save'.
+ *
+ * Arguments:   state  The value returned by 'hal_irq_save'.
+ */
+void hal_irq_restore(unsigned char state);
+
+
+/*
+ * hal_adc_init
+ *
+ * Description: Sets up the ADC and the external trigger, without starting any
+ *              conversions. After this, every trigger results in a call to
+ *              'adc_trigger'.
+ */
+void hal_adc_init(void);
+
+/*
+ * hal_adc_start
+ *
+ * Description: Starts the ADC converting continuously. Every sample results in
+ *              a call to 'adc_sample_ready'. With 'ADC_TIMER', this also starts
+ *              the timer that paces the conversions.
+ */
+void hal_adc_start(void);
+
+/*
+ * hal_adc_stop
+ *
+ * Description: Stops the ADC after the conversion in progress.
+ *
+ * Notes:       This is safe to call from 'adc_sample_ready'.
+ */
+void hal_adc_stop(void);
+
+
+/*
+ * hal_prox_init
+ *
+ * Description: Sets up the inputs from the proximity sensors.
+ */
+void hal_prox_init(void);
+
+/*
+ * hal_prox_read
+ *
+ * Description: Reads the inputs from the proximity sensors.
+ *
+ * Returns:     Returns the level of each of the 8 inputs, one per bit. A
+ *              sensor that sees something pulls its input low.
+ */
+unsigned char hal_prox_read(void);
+
+
+/*
+ * hal_tick_init
+ *
+ * Description: Starts the periodic tick. Every 1 / 'TICK_HZ' seconds, the tick
+ *              results in a call to 'prox_tick'.
+ */
+void hal_tick_init(void);
+
+
+/*
+ * hal_servo_init
+ *
+ * Description: Sets up the PWM output that drives the servo.
+ */
+void hal_servo_init(void);
+
+/*
+ * hal_servo_set
+ *
+ * Description: Moves the servo by changing the duty cycle of the PWM.
+ *
+ * Arguments:   duty  The PWM compare value for the new position.
+ */
+void hal_servo_set(unsigned char duty);
+
+
+/*
+ * hal_trace_init
+ *
+ * Description: Starts the free-running timer used for the trace.
+ */
+void hal_trace_init(void);
+
+/*
+ * hal_trace_time
+ *
+ * Description: Reads the timer used for the trace. Use 'HAL_TRACE_TIME'
+ *              instead, which avoids the call on the board.
+ *
+ * Returns:     Returns the current time.
+ */
+trace_time hal_trace_time(void);
+
+/*
+ * hal_stack_peak
+ *
+ * Description: Finds the most stack that has been used since reset.
+ *
+ * Returns:     Returns the deepest the stack has gone, in bytes, or 0 if it
+ *              cannot be measured.
+ */
+unsigned int hal_stack_peak(void);
+
+/*
+ * hal_uart_init
+ *
+ * Description: Sets up the UART for sending. If built with 'USE_ENROLL', it
+ *              also receives, and every character that comes in results in a
+ *              call to 'enroll_rx'.
+ */
+void hal_uart_init(void);
+
+/*
+ * hal_uart_putc
+ *
+ * Description: Sends a character over the UART, waiting for room to send it.
+ *
+ * Arguments:   c  The character to send.
+ */
+void hal_uart_putc(char c);
+
+
+/*
+ * hal_eeprom_read
+ *
+ * Description: Reads a block of the EEPROM, waiting for any write in progress
+ *              to finish first.
+ *
+ * Arguments:   addr  The address in the EEPROM to start at.
+ *              data  Filled in with the bytes read.
+ *              len   The number of bytes to read.
+ */
+void hal_eeprom_read(unsigned int addr, void *data, unsigned int len);
+
+/*
+ * hal_eeprom_write
+ *
+ * Description: Starts writing a block to the EEPROM. The bytes are written one
+ *              at a time in the background, by the interrupt for the EEPROM
+ *              being ready, so this returns right away.
+ *
+ * Arguments:   addr  The address in the EEPROM to start at.
+ *              data  The bytes to write. These are read as they are written, so
+ *                    they must not change until 'hal_eeprom_busy' returns 0.
+ *              len   The number of bytes to write.
+ *
+ * Notes:       If a write is already in progress, this waits for it to finish
+ *              first.
+ */
+void hal_eeprom_write(unsigned int addr, const void *data, unsigned int len);
+
+/*
+ * hal_eeprom_busy
+ *
+ * Description: Checks whether a write started by 'hal_eeprom_write' is still in
+ *              progress.
+ *
+ * Returns:     Returns nonzero while bytes are left to write, or 0 once they
+ *              are all written.
+ */
+unsigned char hal_eeprom_busy(void);
+
+
+#endif /* end of include guard: _HAL_H_ */
@@ -0,0 +1,741 @@
+/*
+ * hal_avr.c
+ *
+ * Hardware abstraction layer for the dog bowl on the ATmega2560.
+ *
+ * This file contains the backend of the hardware abstraction layer that runs on
+ * the board. It sets up the registers of each of the peripherals, and passes
+ * the ADC and external interrupts on to the code in 'adc.c'.
+ *
+ * Peripherals Used:
+ *      ADC
+ *      EEPROM
+ *      External interrupts
+ *      GPIO
+ *      PWM
+ *      Timer1
+ *      Timer3
+ *      Timer5
+ *      UART0
+ *
+ * Pins Used:
+ *      PA[0..7]
+ *      PB7
+ *      PC[0..7]
+ *      PD0
+ *      PE0 (with 'USE_ENROLL')
+ *      PE1
+ *      PF0
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Added the trace timer and the UART.
+ *      16 Oct 2026     agent               Added sleep and the periodic tick.
+ *      16 Oct 2026     agent               Added timer-triggered sampling.
+ *      16 Oct 2026     agent               Added UART receive and the EEPROM.
+ *      16 Oct 2026     agent               Pass on 16-bit samples, and keep the
+ *                                          ADC clock at 200 kHz or less.
+ *      16 Oct 2026     agent               Paint the stack to find its peak.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "adc.h"
+#include "enroll.h"
+#include "hal.h"
+#include "proximity.h"
+
+/* Clock speed of the board, and the baud rate of the UART. */
+#ifndef F_CPU
+#define F_CPU       16000000UL
+#endif
+#ifndef BAUD
+#define BAUD        115200UL
+#endif
+
+#ifdef ADC_TIMER
+
+#if LOG2_OVERSAMPLE < 0 || LOG2_OVERSAMPLE > 4
+#error "LOG2_OVERSAMPLE must be from 0 to 4"
+#endif
+
+/* Rate of the conversions, before they are averaged. */
+#define CONVERT_HZ  (SAMPLE_HZ * (1UL << LOG2_OVERSAMPLE))
+
+/* Fastest ADC clock that still gives the full 10 bits. */
+#define ADC_CLOCK_MAX   200000UL
+
+/* A conversion started by the timer takes 13.5 ADC clocks. The ADC is most
+ * accurate with a slow clock, so divide it down as far as it will go while
+ * still keeping up with the conversions, but never let the clock go over
+ * 'ADC_CLOCK_MAX'. At 16 MHz, that leaves only the divide by 128 (a 125 kHz
+ * clock), which keeps up with 9259 conversions a second. */
+#if F_CPU / 128 * 2 >= CONVERT_HZ * 27 && F_CPU / 128 <= ADC_CLOCK_MAX
+#define ADC_PRESCALE    0x07
+#elif F_CPU / 64 * 2 >= CONVERT_HZ * 27 && F_CPU / 64 <= ADC_CLOCK_MAX
+#define ADC_PRESCALE    0x06
+#elif F_CPU / 32 * 2 >= CONVERT_HZ * 27 && F_CPU / 32 <= ADC_CLOCK_MAX
+#define ADC_PRESCALE    0x05
+#elif F_CPU / 16 * 2 >= CONVERT_HZ * 27 && F_CPU / 16 <= ADC_CLOCK_MAX
+#define ADC_PRESCALE    0x04
+#else
+#error "SAMPLE_HZ times OVERSAMPLE is too fast for the ADC at 200 kHz"
+#endif
+
+/* Initial values for the ADC configuration registers: right-adjusted 10-bit
+ * results, with conversions started by a Timer1 compare match B. */
+#define ADMUX_VAL   0x40
+#define ADCSRA_VAL  (0x88 | ADC_PRESCALE)
+#define ADCSRB_VAL  0x05
+#define DIDR0_VAL   0x01
+#define DIDR2_VAL   0x00
+
+/* Timer1 settings: clear on compare match with OCR1A, counting every clock.
+ * Compare match B is set to the same count, and starts each conversion. */
+#define TCCR1A_VAL  0x00
+#define TCCR1B_VAL  0x09
+#define TCCR1B_OFF  0x00
+#define OCR1_VAL    ((F_CPU + CONVERT_HZ / 2) / CONVERT_HZ - 1)
+#define OCF1B_MASK  0x04    /* Cleared by writing a 1 to it. */
+
+/* ORing this with ADCSRA lets the timer start the conversions. */
+#define ADCSTART    0x20
+
+/* Conversions added up toward the next sample. */
+static unsigned int oversum = 0;
+static unsigned char overcount = 0;
+
+#else
+
+/* Initial values for the ADC configuration registers. */
+#define ADMUX_VAL   0x60
+#define ADCSRA_VAL  0x8F
+#define ADCSRB_VAL  0x00
+#define DIDR0_VAL   0x01
+#define DIDR2_VAL   0x00
+
+/* ORing this with ADCSRA will begin the data collection process. */
+#define ADCSTART    0x60
+
+#endif
+
+/* Byte that the free SRAM is filled with at reset, so that the deepest the
+ * stack has gone can be found later. */
+#define STACK_PAINT 0xC5
+
+/* End of the variables in SRAM, from the linker. The stack grows down toward
+ * it from the top of the SRAM. */
+extern unsigned char _end;
+
+/* Initial values for external interrupt configuration. */
+#define EICRA_VAL   0x03
+#define EIMSK_VAL   0x01
+
+/* Add pullup resistor to interrupt pin. */
+#define PORTD_VAL   0xFF
+
+
+/* Timer5 runs freely, counting every clock cycle unless this is changed to one
+ * of the other clock select values (2 counts every 8 cycles, 3 every 64). */
+#ifndef TRACE_PRESCALE
+#define TRACE_PRESCALE  0x01
+#endif
+
+/* UART0 settings: double speed, 8 data bits, no parity. It only transmits,
+ * unless commands are taken for enrolling dogs; then it also receives, with an
+ * interrupt for each character. */
+#define UCSR0A_VAL  0x02
+#ifdef USE_ENROLL
+#define UCSR0B_VAL  0x98
+#else
+#define UCSR0B_VAL  0x08
+#endif
+#define UCSR0C_VAL  0x06
+#define UDRE0_MASK  0x20    /* Set when the UART has room for a character. */
+
+/* EEPROM control bits. */
+#define EERE_MASK   0x01    /* Starts a read. */
+#define EEPE_MASK   0x02    /* Starts a write, and stays set until done. */
+#define EEMPE_MASK  0x04    /* Lets EEPE be set for the next 4 clocks. */
+#define EERIE_MASK  0x08    /* Interrupts whenever the EEPROM is ready. */
+
+/* The block being written to the EEPROM in the background. */
+static const unsigned char *eedata;
+static unsigned int eeaddr;
+static volatile unsigned int eeleft = 0;   /* Bytes still to write. */
+
+/* Timer3 settings for the tick: clear on compare match with OCR3A, counting
+ * every 64 clocks, with the compare match interrupt on. */
+#define TCCR3A_VAL  0x00
+#define TCCR3B_VAL  0x0B
+#define TIMSK3_VAL  0x02
+#define TICK_CLOCK  (F_CPU / 64)
+
+/* Constants for setting up the proximity sensor inputs. */
+#define DDR_INPUT   0x00    /* Configure all pins as inputs. */
+#define PORT_PULLUP 0xFF    /* Activate all pull-up resistors. */
+
+
+/*
+ * hal_init
+ *
+ * Description: Sets up anything in the backend that is not tied to one of the
+ *              peripherals. On the board, this makes port C an output.
+ */
+void hal_init(void)
+{
+    DDRC = 0xFF;
+}
+
+
+/*
+ * hal_running
+ *
+ * Description: Lets the backend do its work between passes of the main loop.
+ *              On the board, the interrupts do all of the work, so there is
+ *              nothing to do here.
+ *
+ * Returns:     Always returns nonzero; the main loop runs until reset.
+ */
+unsigned char hal_running(void)
+{
+    return 1;
+}
+
+
+/*
+ * hal_sleep
+ *
+ * Description: Puts the CPU into idle sleep until the next interrupt. The
+ *              instruction after 'sei' always runs before any interrupt, so
+ *              an interrupt that is already pending wakes the CPU right back
+ *              up instead of being missed.
+ *
+ * Notes:       The ADC noise reduction mode would save more power, but it
+ *              stops the I/O clock, which runs the servo PWM, the tick, and the
+ *              auto-triggering of the ADC. Idle mode keeps all of them running.
+ */
+void hal_sleep(void)
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+}
+
+
+/*
+ * hal_decision
+ *
+ * Description: Notes that the main loop has made a decision on a recording.
+ *              There is nothing to measure on the board; use the trace.
+ */
+void hal_decision(void)
+{
+}
+
+
+/*
+ * hal_irq_enable
+ *
+ * Description: Turns on interrupts.
+ */
+void hal_irq_enable(void)
+{
+    sei();
+}
+
+
+/*
+ * hal_irq_save
+ *
+ * Description: Turns off interrupts, so that data shared with an interrupt can
+ *              be accessed safely.
+ *
+ * Returns:     Returns the status register from before interrupts were turned
+ *              off.
+ */
+unsigned char hal_irq_save(void)
+{
+    unsigned char sreg = SREG;
+
+    cli();
+    return sreg;
+}
+
+
+/*
+ * hal_irq_restore
+ *
+ * Description: Puts interrupts back the way that they were before a call to
+ *              'hal_irq_save'.
+ *
+ * Arguments:   state  The status register returned by 'hal_irq_save'.
+ */
+void hal_irq_restore(unsigned char state)
+{
+    SREG = state;
+}
+
+
+/*
+ * hal_adc_init
+ *
+ * Description: Sets up the ADC and the external trigger, without starting any
+ *              conversions. This initialization involves:
+ *               - Writing to ADMUX and ADCSRB to select the input channel.
+ *               - Enable ADC by writing to ADCSRA.
+ *               - Left-adjust the data input by writing to ADMUX.
+ *               - Set the trigger source using ADCSRB.
+ *               - Enable the ADC interrupt.
+ *               - Setting up interrupts for autotriggering.
+ *               - Setting up external interrupt.
+ *               - With 'ADC_TIMER', setting the period of Timer1, without
+ *                 starting it.
+ *
+ * Notes:       This function will initialize the ADC and external interrupt to
+ *              use PF0 and PD0. If these pins are used for another purpose,
+ *              these functions will not work properly.
+ */
+void hal_adc_init(void)
+{
+    /* Set all the configuration registers to their initial values. */
+    ADMUX   = ADMUX_VAL;
+    ADCSRA  = ADCSRA_VAL;
+    ADCSRB  = ADCSRB_VAL;
+    DIDR0   = DIDR0_VAL;
+    DIDR2   = DIDR2_VAL;
+
+    /* Add pullup resistor to the INT0 pin. */
+    PORTD = PORTD_VAL;
+
+    /* Activate the external interrupt for triggering a recording. */
+    EICRA = EICRA_VAL;
+    EIMSK = EIMSK_VAL;
+
+#ifdef ADC_TIMER
+    /* Set up the timer that will start the conversions. */
+    TCCR1B = TCCR1B_OFF;
+    TCCR1A = TCCR1A_VAL;
+    OCR1A  = OCR1_VAL;
+    OCR1B  = OCR1_VAL;
+#endif
+}
+
+
+/*
+ * hal_adc_start
+ *
+ * Description: Enables autotriggering and starts the first conversion, which
+ *              starts the chain of conversions. With 'ADC_TIMER', this instead
+ *              starts Timer1 from 0, which starts a conversion every period.
+ */
+void hal_adc_start(void)
+{
+#ifdef ADC_TIMER
+    /* Start a new sample, and a new period. */
+    oversum = 0;
+    overcount = 0;
+    TCNT1 = 0;
+    TIFR1 = OCF1B_MASK;
+    ADCSRA |= ADCSTART;
+    TCCR1B = TCCR1B_VAL;
+#else
+    ADCSRA |= ADCSTART;
+#endif
+}
+
+
+/*
+ * hal_adc_stop
+ *
+ * Description: Disables autotriggering, so that no more conversions are
+ *              started. With 'ADC_TIMER', Timer1 is stopped too.
+ */
+void hal_adc_stop(void)
+{
+#ifdef ADC_TIMER
+    TCCR1B = TCCR1B_OFF;
+#endif
+    ADCSRA = ADCSRA_VAL;
+}
+
+
+/*
+ * hal_prox_init
+ *
+ * Description: This function initializes the GPIO pins so that they are ready
+ *              to read data from the proximity sensors. This process involves:
+ *               - Writing a 0 to DDA to set GPIO as input.
+ *               - Writing a 1 to PORTA to enable the pull-up resistor.
+ *
+ * Notes:       This function assumes that no other peripherals are going to use
+ *              PA[0..7] pins; the configuration might not work if this is the
+ *              case.
+ */
+void hal_prox_init(void)
+{
+    /* Set the configurations for IO port A. */
+    DDRA  = DDR_INPUT;
+    PORTA = PORT_PULLUP;
+}
+
+
+/*
+ * hal_prox_read
+ *
+ * Description: Reads the inputs from the proximity sensors.
+ *
+ * Returns:     Returns the pins of port A.
+ */
+unsigned char hal_prox_read(void)
+{
+    return PINA;
+}
+
+
+/*
+ * hal_tick_init
+ *
+ * Description: Starts Timer3 counting up to the tick period and back to 0,
+ *              with an interrupt each time it gets there.
+ */
+void hal_tick_init(void)
+{
+    TCCR3A = TCCR3A_VAL;
+    OCR3A  = TICK_CLOCK / TICK_HZ - 1;
+    TCNT3  = 0;
+    TIMSK3 = TIMSK3_VAL;
+    TCCR3B = TCCR3B_VAL;
+}
+
+
+/*
+ * hal_servo_init
+ *
+ * Description: Sets up the PWM output that drives the servo.
+ *
+ * Notes:       The PWM uses the pin PB7; using this pin somewhere else could
+ *              cause problems.
+ */
+void hal_servo_init(void)
+{
+    DDRB = 0x80;    /* Enable output on the PWM pin. */
+    TCCR0A = 0x83;  /* Set pin to fast PWM mode. */
+    TCCR0B = 0x05;  /* Prescale clock by 1024. */
+}
+
+
+/*
+ * hal_servo_set
+ *
+ * Description: Moves the servo by changing the duty cycle of the PWM.
+ *
+ * Arguments:   duty  The new PWM compare value.
+ */
+void hal_servo_set(unsigned char duty)
+{
+    OCR0A = duty;
+}
+
+
+/*
+ * hal_trace_init
+ *
+ * Description: Starts Timer5 running freely in normal mode, with no
+ *              interrupts.
+ */
+void hal_trace_init(void)
+{
+    TCCR5A = 0x00;
+    TCCR5B = TRACE_PRESCALE;
+}
+
+
+/*
+ * hal_trace_time
+ *
+ * Description: Reads Timer5.
+ *
+ * Returns:     Returns the count of Timer5.
+ */
+trace_time hal_trace_time(void)
+{
+    return TCNT5;
+}
+
+
+/*
+ * paint_stack
+ *
+ * Description: Fills the SRAM from the end of the variables up to the top of
+ *              the stack with 'STACK_PAINT'.
+ *
+ * Notes:       This runs in the '.init3' section, before 'main' and with
+ *              nothing on the stack yet. It is naked and cannot call anything,
+ *              so it does not use the stack that it paints.
+ */
+static void paint_stack(void) __attribute__((naked, used, section(".init3")));
+static void paint_stack(void)
+{
+    unsigned char *p;
+
+    for (p = &_end; p <= (unsigned char *)RAMEND; p++)
+    {
+        *p = STACK_PAINT;
+    }
+}
+
+
+/*
+ * hal_stack_peak
+ *
+ * Description: Finds the deepest the stack has gone, as the lowest byte below
+ *              the top of the SRAM that no longer holds 'STACK_PAINT'.
+ *
+ * Returns:     Returns the peak stack use since reset, in bytes.
+ *
+ * Notes:       A byte that was pushed with the same value as the paint is not
+ *              seen, so this can be off by a few bytes.
+ */
+unsigned int hal_stack_peak(void)
+{
+    const unsigned char *p = &_end;
+
+    while (p <= (const unsigned char *)RAMEND && *p == STACK_PAINT)
+    {
+        p++;
+    }
+
+    return (const unsigned char *)RAMEND + 1 - p;
+}
+
+
+/*
+ * hal_uart_init
+ *
+ * Description: Sets up UART0 for sending at 'BAUD', with 8 data bits, no
+ *              parity, and 1 stop bit. With 'USE_ENROLL', it receives the same
+ *              way too.
+ *
+ * Notes:       UART0 uses the pin PE1 for sending, and PE0 for receiving.
+ */
+void hal_uart_init(void)
+{
+    /* Round the baud rate divider, at double speed. */
+    UBRR0  = (F_CPU + 4 * BAUD) / (8 * BAUD) - 1;
+    UCSR0A = UCSR0A_VAL;
+    UCSR0B = UCSR0B_VAL;
+    UCSR0C = UCSR0C_VAL;
+}
+
+
+/*
+ * hal_uart_putc
+ *
+ * Description: Sends a character over UART0, waiting until there is room for
+ *              it.
+ *
+ * Arguments:   c  The character to send.
+ */
+void hal_uart_putc(char c)
+{
+    while (!(UCSR0A & UDRE0_MASK))
+    {
+        /* Wait for the last character to go out. */
+    }
+
+    UDR0 = c;
+}
+
+
+/*
+ * hal_eeprom_read
+ *
+ * Description: Reads a block of the EEPROM, waiting for any write in progress
+ *              to finish first.
+ *
+ * Arguments:   addr  The address in the EEPROM to start at.
+ *              data  Filled in with the bytes read.
+ *              len   The number of bytes to read.
+ */
+void hal_eeprom_read(unsigned int addr, void *data, unsigned int len)
+{
+    unsigned char *p = data;
+
+    while (eeleft != 0 || (EECR & EEPE_MASK))
+    {
+        /* Wait for the background write to finish. */
+    }
+
+    while (len-- > 0)
+    {
+        EEAR = addr++;
+        EECR |= EERE_MASK;
+        *p++ = EEDR;
+    }
+}
+
+
+/*
+ * hal_eeprom_write
+ *
+ * Description: Starts writing a block to the EEPROM. The bytes are written one
+ *              at a time in the background, by the interrupt for the EEPROM
+ *              being ready, so this returns right away.
+ *
+ * Arguments:   addr  The address in the EEPROM to start at.
+ *              data  The bytes to write. These are read as they are written, so
+ *                    they must not change until 'hal_eeprom_busy' returns 0.
+ *              len   The number of bytes to write.
+ *
+ * Notes:       If a write is already in progress, this waits for it to finish
+ *              first.
+ */
+void hal_eeprom_write(unsigned int addr, const void *data, unsigned int len)
+{
+    unsigned char sreg;
+
+    while (eeleft != 0)
+    {
+        /* Wait for the last block to be written. */
+    }
+
+    if (len == 0) {
+        return;
+    }
+
+    /* The interrupt takes over from here, and runs as soon as the EEPROM is
+     * ready. */
+    sreg = hal_irq_save();
+    eedata = data;
+    eeaddr = addr;
+    eeleft = len;
+    EECR |= EERIE_MASK;
+    hal_irq_restore(sreg);
+}
+
+
+/*
+ * hal_eeprom_busy
+ *
+ * Description: Checks whether a write started by 'hal_eeprom_write' is still in
+ *              progress.
+ *
+ * Returns:     Returns nonzero while bytes are left to write, or 0 once they
+ *              are all written.
+ */
+unsigned char hal_eeprom_busy(void)
+{
+    return eeleft != 0;
+}
+
+
+/*
+ * ADC_vect
+ *
+ * Description: Interrupt vector for the ADC interrupt. Passes the new sample,
+ *              which the ADC left-adjusts to 16 bits, on to 'adc_sample_ready'.
+ *              With 'ADC_TIMER', the 10-bit conversions are added up, and every
+ *              'OVERSAMPLE' of them, their sum is passed on, left-adjusted to
+ *              16 bits the same way.
+ *
+ * Notes:       The interrupt should be automatically reset in hardware. The
+ *              Timer1 compare flag is not, since there is no interrupt for it,
+ *              and the next compare match only starts a conversion once it is
+ *              clear.
+ */
+ISR(ADC_vect)
+{
+#ifdef ADC_TIMER
+    TIFR1 = OCF1B_MASK;
+
+    oversum += ADC;
+    overcount++;
+    if (overcount == OVERSAMPLE) {
+        adc_sample_ready(oversum << (6 - LOG2_OVERSAMPLE));
+        oversum = 0;
+        overcount = 0;
+    }
+#else
+    adc_sample_ready(ADC);
+#endif
+}
+
+
+/*
+ * INT0_vect
+ *
+ * Description: Interrupt vector for the external trigger, which fires once the
+ *              amplitude of the audio input goes above a certain level. Passes
+ *              the trigger on to 'adc_trigger'.
+ *
+ * Notes:       The interrupt should be automatically reset in hardware.
+ */
+ISR(INT0_vect)
+{
+    adc_trigger();
+}
+
+
+/*
+ * TIMER3_COMPA_vect
+ *
+ * Description: Interrupt vector for the periodic tick. Passes the tick on to
+ *              'prox_tick'.
+ *
+ * Notes:       The interrupt should be automatically reset in hardware.
+ */
+ISR(TIMER3_COMPA_vect)
+{
+    prox_tick();
+}
+
+
+/*
+ * EE_READY_vect
+ *
+ * Description: Interrupt vector for the EEPROM being ready. Writes the next
+ *              byte of the block from 'hal_eeprom_write', and turns itself off
+ *              once the last one has been started. Bytes that already hold the
+ *              right value are skipped, so they are not worn out.
+ *
+ * Notes:       This keeps firing for as long as it is on and the EEPROM is not
+ *              busy, so a skipped byte just moves on to the next one.
+ */
+ISR(EE_READY_vect)
+{
+    EEAR = eeaddr;
+    EECR |= EERE_MASK;
+    if (EEDR != *eedata) {
+        EEDR = *eedata;
+        EECR |= EEMPE_MASK;
+        EECR |= EEPE_MASK;
+    }
+
+    eeaddr++;
+    eedata++;
+    eeleft--;
+    if (eeleft == 0) {
+        EECR &= ~EERIE_MASK;
+    }
+}
+
+
+#ifdef USE_ENROLL
+/*
+ * USART0_RX_vect
+ *
+ * Description: Interrupt vector for a character coming in over UART0. Passes
+ *              the character on to 'enroll_rx'.
+ *
+ * Notes:       Reading the character resets the interrupt.
+ */
+ISR(USART0_RX_vect)
+{
+    enroll_rx(UDR0);
+}
+#endif
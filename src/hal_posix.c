@@ -0,0 +1,813 @@
+/*
+ * hal_posix.c
+ *
+ * Hardware abstraction layer for running the dog bowl on a POSIX host.
+ *
+ * This file contains the backend of the hardware abstraction layer that runs on
+ * the build host, so that the whole dog bowl can be run and profiled without
+ * the board. The peripherals are simulated from a script read from the
+ * standard input, one command per line:
+ *      <sample> ...            Samples of audio, from -128 to 127. They are
+ *                              given to the ADC code in offset binary, like
+ *                              the ADC gives them, with 0 at mid-rail.
+ *      silence <n>             n samples of silence.
+ *      tone <n> <bin> <amp>    n samples of a cosine at FFT bin 'bin' with
+ *                              amplitude 'amp'.
+ *      noise <n> <amp>         n samples of uniform noise from -amp to amp.
+ *      trigger                 Fires the external trigger.
+ *      near <mask>             Sets the proximity sensors that see something,
+ *                              one per bit (0x55 is all four of them).
+ *      serial <text>           Sends the text, and then a newline, to the UART.
+ *                              It is ignored unless built with 'USE_ENROLL'.
+ * Blank lines and anything after a '#' are ignored. Commands take effect at the
+ * time of the next sample.
+ *
+ * Time is counted in samples, and only moves forward while the main loop is
+ * asleep in 'hal_sleep'. Each sample of audio is taken from the script and
+ * passed to the ADC code if the ADC is running; the audio goes by whether or
+ * not the ADC is listening. The periodic tick runs every 'TICK_SAMPLES'
+ * samples. Once the script runs out, the simulation goes on for 'DRAIN_PASSES'
+ * more samples (with no audio) to let the main loop finish up.
+ *
+ * At the end, a model of the power used is printed. The board is taken to be
+ * awake while the main loop runs (for 'AVR_SLOWDOWN' times as long as it took
+ * on the host) and for 'ISR_CYCLES' per interrupt, and idle the rest of the
+ * time. From this, the average current and the time from waking up to making
+ * a decision on a recording are found. The constants are estimates, and should
+ * be checked against the trace on a real board.
+ *
+ * Every change in the position of the servo is logged to the standard output,
+ * as the time followed by the PWM compare value. Anything sent over the UART
+ * also goes to the standard output, and takes as long to send as it would at
+ * 'BAUD'. The trace timer is a monotonic clock, in nanoseconds.
+ *
+ * The EEPROM starts out erased on every run. Writes to it take 'EEPROM_SAMPLES'
+ * per byte, as on the board; a main loop that waits on the EEPROM lets time
+ * move forward while it waits, like it would on the board.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Added the trace timer and the UART.
+ *      16 Oct 2026     agent               Added sleep, the tick, and the
+ *                                          model.
+ *      16 Oct 2026     agent               Run at SAMPLE_HZ with ADC_TIMER.
+ *      16 Oct 2026     agent               Added UART receive and the EEPROM.
+ *      16 Oct 2026     agent               Pass on 16-bit samples.
+ *      16 Oct 2026     agent               Added the stack peak.
+ *      16 Oct 2026     agent               Pass on samples in offset binary.
+ *      16 Oct 2026     agent               Let time go by while the UART sends.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adc.h"
+#include "data.h"
+#include "enroll.h"
+#include "hal.h"
+#include "proximity.h"
+
+/* Samples to run after the script is done. */
+#define DRAIN_PASSES    (4 * SAMPLE_SIZE)
+
+/* Rate of the ADC on the board: a 16 MHz clock, divided by 128 for the ADC,
+ * with 13 ADC clocks per conversion, unless a timer sets the rate. */
+#define F_CPU           16000000UL
+#ifdef ADC_TIMER
+#define SAMPLE_RATE     SAMPLE_HZ
+#else
+#define SAMPLE_RATE     (F_CPU / 128 / 13)
+#endif
+#define TICK_SAMPLES    (SAMPLE_RATE / TICK_HZ)
+
+/* Rate of the UART, which takes 10 bits to send a character. */
+#define BAUD            115200UL
+
+/* Size of the EEPROM, and the samples it takes to write a byte (3.4 ms). */
+#define EEPROM_SIZE     4096
+#define EEPROM_SAMPLES  (SAMPLE_RATE * 34 / 10000 + 1)
+
+/* Model of the board, for the power estimate. */
+#ifndef AVR_SLOWDOWN
+#define AVR_SLOWDOWN    1000    /* Times slower the board runs the main loop. */
+#endif
+#ifndef ISR_CYCLES
+#define ISR_CYCLES      100     /* Clocks to wake up and run an interrupt. */
+#endif
+#ifndef ACTIVE_UA
+#define ACTIVE_UA       14000   /* Current while awake, in uA. */
+#endif
+#ifndef IDLE_UA
+#define IDLE_UA         4000    /* Current in idle sleep, in uA. */
+#endif
+
+/* Longest line in the script. */
+#define LINE_LENGTH     256
+
+/* Kinds of generated audio. */
+#define GEN_SILENCE     0
+#define GEN_TONE        1
+#define GEN_NOISE       2
+
+static unsigned long now = 0;           /* Samples since the start. */
+static unsigned int drain = 0;          /* Passes since the script ran out. */
+static unsigned char adc_on = 0;        /* Whether the ADC is converting. */
+static unsigned char irq_on = 0;        /* Whether interrupts are on. */
+static unsigned char nearby = 0;        /* Sensors that see something. */
+static unsigned char tick_on = 0;       /* Whether the tick is running. */
+static unsigned int tickcount = 0;      /* Samples since the last tick. */
+static unsigned char done = 0;          /* Whether the simulation is over. */
+static int servo = -1;                  /* Last servo position, if any. */
+static unsigned long uartbits = 0;      /* Sample time of the UART, in bits. */
+
+/* The simulated EEPROM, and the block being written to it. */
+static unsigned char eeprom[EEPROM_SIZE];
+static const unsigned char *eedata = NULL;
+static unsigned int eeaddr = 0;
+static unsigned int eeleft = 0;         /* Bytes still to write. */
+static unsigned int eewait = 0;         /* Samples into writing a byte. */
+
+/* Counts for the power model. The times are on the host, in nanoseconds. */
+static unsigned long isrs = 0;          /* Interrupts run. */
+static unsigned long wakes = 0;         /* Times woken from sleep. */
+static unsigned long long awake = 0;    /* Time spent awake. */
+static unsigned long long woke = 0;     /* Time of the last wake up. */
+static unsigned long decisions = 0;     /* Recordings decided on. */
+static unsigned long long latency = 0;  /* Total time to decide. */
+static unsigned long long worst = 0;    /* Longest time to decide. */
+
+/* The line of the script being read. */
+static char line[LINE_LENGTH];
+static char *linepos = NULL;
+static unsigned int lineno = 0;
+
+/* Generated audio still to come. */
+static unsigned char gen = GEN_SILENCE;
+static long genleft = 0;                /* Samples left. */
+static long genidx = 0;                 /* Samples done. */
+static long genbin = 0;
+static long genamp = 0;
+
+
+/*
+ * script_error
+ *
+ * Description: Reports a bad line in the script and quits.
+ *
+ * Arguments:   msg  What was wrong with the line.
+ */
+static void script_error(const char *msg)
+{
+    fprintf(stderr, "line %u: %s\n", lineno, msg);
+    exit(1);
+}
+
+
+/*
+ * next_number
+ *
+ * Description: Reads the next number from the current line of the script.
+ *
+ * Arguments:   value  Filled in with the number.
+ *
+ * Returns:     Returns nonzero if there was a number, or 0 if not.
+ */
+static unsigned char next_number(long *value)
+{
+    char *end;
+
+    *value = strtol(linepos, &end, 0);
+    if (end == linepos) {
+        return 0;
+    }
+
+    linepos = end;
+    return 1;
+}
+
+
+/*
+ * run_command
+ *
+ * Description: Runs the command at the start of the current line of the script.
+ *              Any samples on the line are left to be read.
+ */
+static void run_command(void)
+{
+    char *cmd;
+    size_t len;
+
+    /* Skip to the first word. */
+    cmd = linepos + strspn(linepos, " \t\r\n");
+    len = strcspn(cmd, " \t\r\n");
+    linepos = cmd + len;
+
+    /* A line of samples is read as it goes. */
+    if (len == 0 || (cmd[0] >= '0' && cmd[0] <= '9') || cmd[0] == '-') {
+        linepos = cmd;
+    }
+    else if (len == 7 && strncmp(cmd, "trigger", len) == 0) {
+        if (irq_on) {
+            adc_trigger();
+            isrs++;
+        }
+    }
+    else if (len == 6 && strncmp(cmd, "serial", len) == 0) {
+        /* Each character comes in with an interrupt of its own. */
+        cmd = linepos + strspn(linepos, " \t");
+        len = strcspn(cmd, "\r\n");
+        linepos = cmd + len;
+#ifdef USE_ENROLL
+        if (irq_on) {
+            for (; len > 0; len--)
+            {
+                enroll_rx(*cmd++);
+                isrs++;
+            }
+            enroll_rx('\n');
+            isrs++;
+        }
+#endif
+    }
+    else if (len == 4 && strncmp(cmd, "near", len) == 0) {
+        if (!next_number(&genamp)) {
+            script_error("near needs a mask");
+        }
+        nearby = genamp;
+    }
+    else if (len == 7 && strncmp(cmd, "silence", len) == 0) {
+        gen = GEN_SILENCE;
+        if (!next_number(&genleft)) {
+            script_error("silence needs a length");
+        }
+    }
+    else if (len == 4 && strncmp(cmd, "tone", len) == 0) {
+        gen = GEN_TONE;
+        if (!next_number(&genleft) || !next_number(&genbin) ||
+            !next_number(&genamp)) {
+            script_error("tone needs a length, bin, and amplitude");
+        }
+    }
+    else if (len == 5 && strncmp(cmd, "noise", len) == 0) {
+        gen = GEN_NOISE;
+        if (!next_number(&genleft) || !next_number(&genamp)) {
+            script_error("noise needs a length and amplitude");
+        }
+    }
+    else {
+        script_error("unknown command");
+    }
+
+    genidx = 0;
+}
+
+
+/*
+ * next_sample
+ *
+ * Description: Gets the next sample of audio from the script, running any
+ *              commands on the way to it.
+ *
+ * Arguments:   value  Filled in with the sample.
+ *
+ * Returns:     Returns nonzero if there was a sample, or 0 if the script is
+ *              done.
+ */
+static unsigned char next_sample(long *value)
+{
+    char *comment;
+
+    for (;;)
+    {
+        /* Generated audio comes first. */
+        if (genleft > 0)
+        {
+            if (gen == GEN_TONE) {
+                *value = lround(genamp * cos(2 * M_PI * genbin * genidx /
+                                             SAMPLE_SIZE));
+            }
+            else if (gen == GEN_NOISE) {
+                *value = rand() % (2 * genamp + 1) - genamp;
+            }
+            else {
+                *value = 0;
+            }
+
+            genleft--;
+            genidx++;
+            break;
+        }
+
+        /* Then any samples left on the line. */
+        if (linepos != NULL && next_number(value)) {
+            break;
+        }
+
+        /* Else, go on to the next line. */
+        if (fgets(line, LINE_LENGTH, stdin) == NULL) {
+            return 0;
+        }
+        lineno++;
+
+        comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        linepos = line;
+        run_command();
+    }
+
+    /* Clip the sample to what the ADC can give. */
+    if (*value > 127) {
+        *value = 127;
+    }
+    if (*value < -128) {
+        *value = -128;
+    }
+
+    return 1;
+}
+
+
+/*
+ * host_ns
+ *
+ * Description: Reads the monotonic clock of the host.
+ *
+ * Returns:     Returns the time in nanoseconds.
+ */
+static unsigned long long host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*
+ * step
+ *
+ * Description: Moves time forward by one sample. The next sample of audio is
+ *              read from the script and given to the ADC if it is running, and
+ *              the tick is run if it is due. Once the script has run out, and
+ *              'DRAIN_PASSES' more samples have gone by, the simulation is
+ *              over.
+ */
+static void step(void)
+{
+    long value;
+
+    /* Write the next byte to the EEPROM once the last one is done. The time
+     * goes on even after the script, so that a wait for it always ends. */
+    if (eeleft != 0 && ++eewait >= EEPROM_SAMPLES) {
+        eewait = 0;
+        if (eeaddr < EEPROM_SIZE) {
+            eeprom[eeaddr] = *eedata;
+        }
+        eeaddr++;
+        eedata++;
+        eeleft--;
+        isrs++;
+    }
+
+    if (next_sample(&value)) {
+        /* The ADC reads the sample as a byte, biased to mid-rail and
+         * left-adjusted to 16 bits. */
+        if (adc_on && irq_on) {
+            adc_sample_ready((unsigned int)(value + 128) << 8);
+            isrs++;
+        }
+    }
+    else if (++drain > DRAIN_PASSES) {
+        done = 1;
+        return;
+    }
+
+    tickcount++;
+    if (tickcount >= TICK_SAMPLES) {
+        tickcount = 0;
+        if (tick_on && irq_on) {
+            prox_tick();
+            isrs++;
+        }
+    }
+
+    now++;
+}
+
+
+/*
+ * report
+ *
+ * Description: Prints the model of the power used and the time taken to make
+ *              decisions. The times on the host are scaled by 'AVR_SLOWDOWN',
+ *              and each interrupt adds 'ISR_CYCLES' clocks of time awake.
+ */
+static void report(void)
+{
+    double total, on, ua;
+
+    total = (double)now / SAMPLE_RATE;
+    on = (double)awake * AVR_SLOWDOWN / 1e9 + (double)isrs * ISR_CYCLES / F_CPU;
+    if (on > total) {
+        on = total;
+    }
+    ua = (total > 0) ? (ACTIVE_UA * on + IDLE_UA * (total - on)) / total :
+                       ACTIVE_UA;
+
+    printf("# %.3f s, %lu interrupts, %lu wake ups, awake %.2f%% of the time\n",
+           total, isrs, wakes, (total > 0) ? 100 * on / total : 100.0);
+    printf("# average current %.0f uA (%u uA awake, %u uA idle)\n", ua,
+           ACTIVE_UA, IDLE_UA);
+    if (decisions != 0) {
+        printf("# wake to decision %.0f us average, %.0f us worst, "
+               "over %lu decisions\n",
+               (double)latency * AVR_SLOWDOWN / decisions / 1000,
+               (double)worst * AVR_SLOWDOWN / 1000, decisions);
+    }
+}
+
+
+/*
+ * hal_init
+ *
+ * Description: Sets up the simulation. The noise is seeded the same way every
+ *              time, so that runs can be repeated, and the EEPROM is erased.
+ */
+void hal_init(void)
+{
+    srand(1);
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    woke = host_ns();
+}
+
+
+/*
+ * hal_running
+ *
+ * Description: Checks whether the simulation is over. The power model is
+ *              printed once it is.
+ *
+ * Returns:     Returns nonzero while the main loop should keep running, or 0
+ *              once the script is done and 'DRAIN_PASSES' more samples have
+ *              gone by.
+ */
+unsigned char hal_running(void)
+{
+    static unsigned char reported = 0;
+
+    if (done && !reported) {
+        awake += host_ns() - woke;
+        report();
+        reported = 1;
+    }
+
+    return !done;
+}
+
+
+/*
+ * hal_sleep
+ *
+ * Description: Sleeps until the next interrupt. Interrupts are turned on, and
+ *              time moves forward one sample at a time until an interrupt has
+ *              run (or the simulation is over).
+ */
+void hal_sleep(void)
+{
+    unsigned long before = isrs;
+
+    irq_on = 1;
+    if (done) {
+        return;
+    }
+
+    /* The main loop has stopped running until the wake up. */
+    awake += host_ns() - woke;
+
+    while (!done && isrs == before)
+    {
+        step();
+    }
+
+    wakes++;
+    woke = host_ns();
+}
+
+
+/*
+ * hal_decision
+ *
+ * Description: Notes the time from the last wake up to a decision on a
+ *              recording.
+ */
+void hal_decision(void)
+{
+    unsigned long long t = host_ns() - woke;
+
+    latency += t;
+    if (t > worst) {
+        worst = t;
+    }
+    decisions++;
+}
+
+
+/*
+ * hal_irq_enable
+ *
+ * Description: Turns on interrupts. No interrupts are run until this is
+ *              called.
+ */
+void hal_irq_enable(void)
+{
+    irq_on = 1;
+}
+
+
+/*
+ * hal_irq_save
+ *
+ * Description: Turns off interrupts. Interrupts are only ever run between
+ *              passes of the main loop, so this just keeps track of them.
+ *
+ * Returns:     Returns whether interrupts were on.
+ */
+unsigned char hal_irq_save(void)
+{
+    unsigned char state = irq_on;
+
+    irq_on = 0;
+    return state;
+}
+
+
+/*
+ * hal_irq_restore
+ *
+ * Description: Puts interrupts back the way that they were before a call to
+ *              'hal_irq_save'.
+ *
+ * Arguments:   state  The value returned by 'hal_irq_save'.
+ */
+void hal_irq_restore(unsigned char state)
+{
+    irq_on = state;
+}
+
+
+/*
+ * hal_adc_init
+ *
+ * Description: Sets up the simulated ADC, with no conversions running.
+ */
+void hal_adc_init(void)
+{
+    adc_on = 0;
+}
+
+
+/*
+ * hal_adc_start
+ *
+ * Description: Starts passing samples from the script to the ADC code.
+ */
+void hal_adc_start(void)
+{
+    adc_on = 1;
+}
+
+
+/*
+ * hal_adc_stop
+ *
+ * Description: Stops passing samples from the script to the ADC code.
+ */
+void hal_adc_stop(void)
+{
+    adc_on = 0;
+}
+
+
+/*
+ * hal_prox_init
+ *
+ * Description: Sets up the simulated proximity sensors, with nothing nearby.
+ */
+void hal_prox_init(void)
+{
+    nearby = 0;
+}
+
+
+/*
+ * hal_prox_read
+ *
+ * Description: Reads the simulated proximity sensors.
+ *
+ * Returns:     Returns the level of each input; the sensors set with the 'near'
+ *              command pull their inputs low.
+ */
+unsigned char hal_prox_read(void)
+{
+    return ~nearby;
+}
+
+
+/*
+ * hal_tick_init
+ *
+ * Description: Starts the simulated tick, which runs every 'TICK_SAMPLES'
+ *              samples.
+ */
+void hal_tick_init(void)
+{
+    tick_on = 1;
+    tickcount = 0;
+}
+
+
+/*
+ * hal_servo_init
+ *
+ * Description: Sets up the simulated servo. Nothing is logged until the first
+ *              position is set.
+ */
+void hal_servo_init(void)
+{
+    servo = -1;
+}
+
+
+/*
+ * hal_servo_set
+ *
+ * Description: Moves the simulated servo, logging the time and the new position
+ *              if it changed.
+ *
+ * Arguments:   duty  The PWM compare value for the new position.
+ */
+void hal_servo_set(unsigned char duty)
+{
+    if (duty != servo) {
+        printf("%lu servo %u\n", now, duty);
+        servo = duty;
+    }
+}
+
+
+/*
+ * hal_trace_init
+ *
+ * Description: Starts the trace timer. The host clock is always running, so
+ *              there is nothing to do.
+ */
+void hal_trace_init(void)
+{
+}
+
+
+/*
+ * hal_trace_time
+ *
+ * Description: Reads the monotonic clock.
+ *
+ * Returns:     Returns the time in nanoseconds, truncated to fit.
+ */
+trace_time hal_trace_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (trace_time)(ts.tv_sec * 1000000000UL + ts.tv_nsec);
+}
+
+
+/*
+ * hal_stack_peak
+ *
+ * Description: Finds the most stack used. The host stack says nothing about
+ *              the board's, so it is not measured.
+ *
+ * Returns:     Returns 0.
+ */
+unsigned int hal_stack_peak(void)
+{
+    return 0;
+}
+
+
+/*
+ * hal_uart_init
+ *
+ * Description: Sets up the simulated UART. Nothing needs to be done.
+ */
+void hal_uart_init(void)
+{
+}
+
+
+/*
+ * hal_uart_putc
+ *
+ * Description: Sends a character over the simulated UART, to the standard
+ *              output. Carriage returns are left out. Time moves forward for
+ *              as long as the character takes to send at 'BAUD', as the board
+ *              waits on the UART, so that interrupts keep running meanwhile.
+ *
+ * Arguments:   c  The character to send.
+ */
+void hal_uart_putc(char c)
+{
+    if (c != '\r') {
+        putchar(c);
+    }
+
+    /* Each sample's worth of bits that has gone by is a sample of time. */
+    uartbits += 10 * SAMPLE_RATE;
+    while (uartbits >= BAUD)
+    {
+        uartbits -= BAUD;
+        step();
+    }
+}
+
+
+/*
+ * hal_eeprom_read
+ *
+ * Description: Reads a block of the simulated EEPROM, letting time go by until
+ *              any write in progress is done. Bytes past the end of the EEPROM
+ *              read as erased.
+ *
+ * Arguments:   addr  The address in the EEPROM to start at.
+ *              data  Filled in with the bytes read.
+ *              len   The number of bytes to read.
+ */
+void hal_eeprom_read(unsigned int addr, void *data, unsigned int len)
+{
+    unsigned char *p = data;
+
+    while (eeleft != 0)
+    {
+        step();
+    }
+
+    for (; len > 0; len--, addr++)
+    {
+        *p++ = (addr < EEPROM_SIZE) ? eeprom[addr] : 0xFF;
+    }
+}
+
+
+/*
+ * hal_eeprom_write
+ *
+ * Description: Starts writing a block to the simulated EEPROM. A byte is
+ *              written every 'EEPROM_SAMPLES' samples as time goes by.
+ *
+ * Arguments:   addr  The address in the EEPROM to start at.
+ *              data  The bytes to write, which must not change until
+ *                    'hal_eeprom_busy' returns 0.
+ *              len   The number of bytes to write.
+ *
+ * Notes:       If a write is already in progress, time goes by until it is
+ *              done.
+ */
+void hal_eeprom_write(unsigned int addr, const void *data, unsigned int len)
+{
+    while (eeleft != 0)
+    {
+        step();
+    }
+
+    eedata = data;
+    eeaddr = addr;
+    eeleft = len;
+    eewait = 0;
+}
+
+
+/*
+ * hal_eeprom_busy
+ *
+ * Description: Checks whether a write to the simulated EEPROM is still in
+ *              progress. If it is, time moves forward by a sample, since the
+ *              caller is most likely waiting on it.
+ *
+ * Returns:     Returns nonzero while bytes are left to write, or 0 once they
+ *              are all written.
+ */
+unsigned char hal_eeprom_busy(void)
+{
+    if (eeleft != 0) {
+        step();
+    }
+
+    return eeleft != 0;
+}
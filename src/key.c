@@ -1,22 +1,387 @@
 /*
  * key.c
  *
- * Power spectrum for the key to the dog bowl.
+ * Power spectra for the keys to the dog bowl.
  *
- * Contains the magnitude of the power spectrum of the dog bark that will unlock
- * the dog bowl. This spectrum is compared to the recorded spectrum in order to
- * identify the dog that barked. If the spectra match, the dog bowl will open.
+ * Contains the magnitude of the power spectrum of the dog barks that will
+ * unlock the dog bowl. These spectra are compared to the recorded spectrum in
+ * order to identify the dog that barked. If one of the spectra matches, the dog
+ * bowl will open. Dogs enrolled on the board (with 'USE_ENROLL') are kept here
+ * too, after the ones in the table.
  *
  * Revision History:
  *      06 Jun 2015     Brian Kubisiak      Initial revision.
  *      09 Jun 2015     Brian Kubisiak      Working key added.
+ *      16 Oct 2026     agent               Re-recorded for block floating
+ *                                          point.
+ *      16 Oct 2026     agent               Only keep the unique bins.
+ *      16 Oct 2026     agent               Table of keys for several dogs.
+ *      16 Oct 2026     agent               Packed keys in program memory.
+ *      16 Oct 2026     agent               Keys in natural order.
+ *      16 Oct 2026     agent               Keys for the front end.
+ *      16 Oct 2026     agent               Added keys enrolled on the board,
+ *                                          and weighted bins.
+ *      16 Oct 2026     agent               Added the second dog.
+ *      16 Oct 2026     agent               Only build the table at 64 points.
+ *      16 Oct 2026     agent               16-bit thresholds.
+ *      16 Oct 2026     agent               Re-recorded the first dog with no
+ *                                          front end.
  */
 
-#include "data.h"
+#include <stdlib.h>
 
-/* Frequency spectrum that unlocks the dog bowl, obtained empiracally. */
-unsigned char key[SAMPLE_SIZE] = {
-    2, 3, 3, 4, 4, 3, 4, 3, 4, 2, 4, 3, 4, 4, 4, 3, 4, 3, 4, 4, 4, 4, 3, 4, 4,
-    3, 3, 3, 4, 4, 3, 4, 4, 2, 4, 4, 4, 4, 4, 3, 3, 3, 3, 4, 3, 4, 4, 4, 3, 4,
-    3, 3, 4, 2, 3, 3, 4, 4, 3, 3, 3, 4, 4, 4,
+#include "hal.h"
+#include "key.h"
+
+/* Frequency spectra that unlock the dog bowl, obtained empiracally. These are
+ * the log magnitudes of each dog's bark, including the block exponent from the
+ * FFT. Only the 'SAMPLE_SIZE / 2 + 1' unique bins of the real-input FFT are
+ * kept, in natural order from bin 0 to bin SAMPLE_SIZE / 2, and packed two to a
+ * byte. The dogs are the two barks in 'test-fft.c'; the first key is the bark
+ * itself, as 'test-fft' prints it ('make check' checks that they still agree),
+ * and the second is the median of each bin over the noisy copies that
+ * 'replay-fft' makes of it, in both datapaths. Keys recorded in the old
+ * bit-reversed order can be put in order with 'convert-keys'. The front end
+ * changes the spectrum, so the keys have to be recorded through the same front
+ * end that the code is built with. The keys are only right for a 'SAMPLE_SIZE'
+ * of 64; at any other size, every dog has to be enrolled on the board. */
+#if SAMPLE_SIZE == 64
+const dog_key keys[] PROGMEM = {
+#if defined(USE_PREPROCESS) && defined(PREPROCESS_HAMMING)
+    {   1, 30, {
+        KEY_PAIR(1, 2), KEY_PAIR(2, 3), KEY_PAIR(2, 2), KEY_PAIR(3, 3),
+        KEY_PAIR(4, 4), KEY_PAIR(4, 4), KEY_PAIR(4, 4), KEY_PAIR(4, 3),
+        KEY_PAIR(3, 3), KEY_PAIR(4, 4), KEY_PAIR(4, 3), KEY_PAIR(4, 4),
+        KEY_PAIR(4, 4), KEY_PAIR(3, 3), KEY_PAIR(3, 2), KEY_PAIR(3, 2),
+        KEY_PAIR(3, 0),
+    } },
+    {   2, 30, {
+        KEY_PAIR(2, 2), KEY_PAIR(2, 2), KEY_PAIR(1, 2), KEY_PAIR(2, 2),
+        KEY_PAIR(2, 2), KEY_PAIR(2, 4), KEY_PAIR(5, 5), KEY_PAIR(4, 3),
+        KEY_PAIR(2, 2), KEY_PAIR(2, 2), KEY_PAIR(2, 2), KEY_PAIR(3, 3),
+        KEY_PAIR(5, 5), KEY_PAIR(5, 4), KEY_PAIR(3, 2), KEY_PAIR(2, 2),
+        KEY_PAIR(1, 0),
+    } },
+#elif defined(USE_PREPROCESS)
+    {   1, 30, {
+        KEY_PAIR(0, 1), KEY_PAIR(2, 3), KEY_PAIR(1, 2), KEY_PAIR(3, 3),
+        KEY_PAIR(4, 4), KEY_PAIR(4, 4), KEY_PAIR(4, 4), KEY_PAIR(4, 3),
+        KEY_PAIR(3, 3), KEY_PAIR(4, 4), KEY_PAIR(4, 3), KEY_PAIR(4, 3),
+        KEY_PAIR(4, 4), KEY_PAIR(3, 3), KEY_PAIR(3, 3), KEY_PAIR(3, 2),
+        KEY_PAIR(3, 0),
+    } },
+    {   2, 30, {
+        KEY_PAIR(2, 2), KEY_PAIR(2, 1), KEY_PAIR(2, 2), KEY_PAIR(2, 2),
+        KEY_PAIR(2, 2), KEY_PAIR(2, 4), KEY_PAIR(5, 5), KEY_PAIR(4, 3),
+        KEY_PAIR(2, 2), KEY_PAIR(2, 2), KEY_PAIR(2, 2), KEY_PAIR(2, 3),
+        KEY_PAIR(5, 5), KEY_PAIR(5, 4), KEY_PAIR(3, 2), KEY_PAIR(2, 2),
+        KEY_PAIR(2, 0),
+    } },
+#else
+    {   1, 30, {
+        KEY_PAIR(6, 4), KEY_PAIR(4, 4), KEY_PAIR(3, 4), KEY_PAIR(4, 4),
+        KEY_PAIR(4, 5), KEY_PAIR(4, 5), KEY_PAIR(4, 4), KEY_PAIR(4, 3),
+        KEY_PAIR(3, 3), KEY_PAIR(4, 4), KEY_PAIR(3, 3), KEY_PAIR(4, 4),
+        KEY_PAIR(4, 4), KEY_PAIR(3, 3), KEY_PAIR(3, 0), KEY_PAIR(3, 3),
+        KEY_PAIR(3, 0),
+    } },
+    {   2, 30, {
+        KEY_PAIR(6, 4), KEY_PAIR(4, 4), KEY_PAIR(4, 4), KEY_PAIR(3, 3),
+        KEY_PAIR(3, 4), KEY_PAIR(4, 3), KEY_PAIR(5, 5), KEY_PAIR(4, 3),
+        KEY_PAIR(3, 3), KEY_PAIR(3, 3), KEY_PAIR(3, 2), KEY_PAIR(3, 3),
+        KEY_PAIR(4, 5), KEY_PAIR(5, 4), KEY_PAIR(3, 3), KEY_PAIR(3, 3),
+        KEY_PAIR(2, 0),
+    } },
+#endif
 };
+
+const unsigned char num_keys = sizeof(keys) / sizeof(keys[0]);
+#elif defined(USE_ENROLL)
+/* No dogs in the table. C does not allow an empty array, so it has one entry,
+ * which is never searched. */
+const dog_key keys[1] PROGMEM = { { NO_DOG, 0, { 0 } } };
+
+const unsigned char num_keys = 0;
+#else
+#error "The keys are only for a SAMPLE_SIZE of 64; enroll dogs at other sizes"
+#endif
+
+#ifdef USE_ENROLL
+/* Dogs enrolled on the board, in the same order as in the EEPROM. */
+static enrolled_key enrolled[ENROLL_SLOTS];
+
+/* The enrolled dog at an index past the end of the table. */
+#define ENROLLED(dog)   (&enrolled[(dog) - num_keys])
+#else
+/* Every bin of a key in the table counts fully. */
+#define key_weight(dog, bin)    KEY_WEIGHT_ONE
+#endif
+
+
+/*
+ * key_count
+ *
+ * Description: Gets the number of keys that can be searched, including the
+ *              slots for dogs enrolled on the board.
+ *
+ * Returns:     Returns the number of keys. Slots with no dog in them have the
+ *              ID 'NO_DOG'.
+ */
+unsigned char key_count(void)
+{
+#ifdef USE_ENROLL
+    return num_keys + ENROLL_SLOTS;
+#else
+    return num_keys;
+#endif
+}
+
+
+/*
+ * key_id
+ *
+ * Description: Gets the ID of an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *
+ * Returns:     Returns the ID of the dog.
+ */
+unsigned char key_id(unsigned char dog)
+{
+#ifdef USE_ENROLL
+    if (dog >= num_keys) {
+        return ENROLLED(dog)->key.id;
+    }
+#endif
+    return pgm_read_byte(&keys[dog].id);
+}
+
+
+/*
+ * key_bin
+ *
+ * Description: Gets one bin of the key for an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *              bin  The index of the bin in the key.
+ *
+ * Returns:     Returns the log10 magnitude of the bin.
+ */
+unsigned char key_bin(unsigned char dog, unsigned int bin)
+{
+    unsigned char pair;
+
+#ifdef USE_ENROLL
+    if (dog >= num_keys) {
+        pair = ENROLLED(dog)->key.bins[bin / 2];
+    }
+    else {
+        pair = pgm_read_byte(&keys[dog].bins[bin / 2]);
+    }
+#else
+    pair = pgm_read_byte(&keys[dog].bins[bin / 2]);
+#endif
+
+    /* Even bins are in the low 4 bits, and odd bins in the high 4 bits. */
+    return (bin & 1) ? (pair >> 4) : (pair & 0x0F);
+}
+
+
+/*
+ * key_threshold
+ *
+ * Description: Gets the error threshold for an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *
+ * Returns:     Returns the threshold, in whole bins of error.
+ */
+unsigned int key_threshold(unsigned char dog)
+{
+#ifdef USE_ENROLL
+    if (dog >= num_keys) {
+        return ENROLLED(dog)->key.threshold;
+    }
+#endif
+    return pgm_read_word(&keys[dog].threshold);
+}
+
+
+#ifdef USE_ENROLL
+/*
+ * key_weight
+ *
+ * Description: Gets the weight of one bin of the key for an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *              bin  The index of the bin in the key.
+ *
+ * Returns:     Returns the weight of the bin, from 0 to 'KEY_WEIGHT_ONE'.
+ */
+unsigned char key_weight(unsigned char dog, unsigned int bin)
+{
+    unsigned char pair;
+
+    /* Every bin of a key in the table counts fully. */
+    if (dog < num_keys) {
+        return KEY_WEIGHT_ONE;
+    }
+
+    pair = ENROLLED(dog)->weights[bin / 2];
+    return (bin & 1) ? (pair >> 4) : (pair & 0x0F);
+}
+
+
+/*
+ * key_load
+ *
+ * Description: Reads the dogs enrolled on the board from the EEPROM. Slots that
+ *              were never written, or were written for another 'SAMPLE_SIZE',
+ *              are left empty.
+ *
+ * Notes:       This must be called before any keys are searched.
+ */
+void key_load(void)
+{
+    unsigned char s;
+
+    for (s = 0; s < ENROLL_SLOTS; s++)
+    {
+        hal_eeprom_read(KEY_EEPROM_ADDR + s * sizeof(enrolled_key),
+                        &enrolled[s], sizeof(enrolled_key));
+
+        /* An erased EEPROM reads as all ones, which is not a good tag. */
+        if (enrolled[s].tag != KEY_EEPROM_TAG) {
+            enrolled[s].key.id = NO_DOG;
+        }
+    }
+}
+
+
+/*
+ * key_store
+ *
+ * Description: Enrolls a dog on the board, replacing the dog with the same ID
+ *              if there is one, or else taking an empty slot. The key can be
+ *              matched right away, and is written to the EEPROM in the
+ *              background.
+ *
+ * Arguments:   key  The new key. The tag does not need to be filled in.
+ *
+ * Returns:     Returns nonzero if the dog was enrolled, or 0 if every slot is
+ *              taken by another dog.
+ *
+ * Notes:       If the last key stored is still being written, this waits for it
+ *              to finish first.
+ */
+unsigned char key_store(const enrolled_key *key)
+{
+    unsigned char s;
+    unsigned char slot = ENROLL_SLOTS;  /* Slot to store into. */
+
+    /* Look for the same dog, keeping track of the first empty slot. */
+    for (s = 0; s < ENROLL_SLOTS; s++)
+    {
+        if (enrolled[s].key.id == key->key.id) {
+            slot = s;
+            break;
+        }
+        if (enrolled[s].key.id == NO_DOG && slot == ENROLL_SLOTS) {
+            slot = s;
+        }
+    }
+
+    if (slot == ENROLL_SLOTS) {
+        return 0;
+    }
+
+    /* The EEPROM is written straight out of the slot, so the last write has to
+     * be done before the slot can change. */
+    while (hal_eeprom_busy())
+    {
+        /* Wait for the last key to be written. */
+    }
+
+    enrolled[slot] = *key;
+    enrolled[slot].tag = KEY_EEPROM_TAG;
+    hal_eeprom_write(KEY_EEPROM_ADDR + slot * sizeof(enrolled_key),
+                     &enrolled[slot], sizeof(enrolled_key));
+
+    return 1;
+}
+#endif
+
+
+/*
+ * key_search
+ *
+ * Description: Finds the enrolled dog whose key is the best match for a
+ *              recorded spectrum. The error for a dog is the sum of the
+ *              absolute differences between the recorded bins and the key,
+ *              each times the weight of the bin. The dog with the smallest
+ *              error wins, as long as the error is below the threshold.
+ *
+ * Arguments:   logs       The (integer) log10 magnitude of each recorded bin.
+ *              bins       The index in the key of each entry of 'logs', or NULL
+ *                         if 'logs' holds every bin of the key in order.
+ *              nbins      The number of entries in 'logs'.
+ *              threshold  The error threshold to use for every dog, or 0 to use
+ *                         each dog's own threshold.
+ *
+ * Returns:     Returns the ID of the best matching dog, or 'NO_DOG' if no dog
+ *              matches.
+ *
+ * Notes:       Once the error for a dog reaches the best error so far (or the
+ *              threshold), it cannot win, so the rest of its bins are skipped.
+ *              If two dogs have the same error, the first one in the table
+ *              wins. The errors are counted in units of 1 / KEY_WEIGHT_ONE, so
+ *              the thresholds are scaled up to match; for the keys in the
+ *              table, this is the same as counting whole bins. A scaled
+ *              threshold past 16 bits is no limit at all, since no error can
+ *              get that big.
+ */
+unsigned char key_search(const unsigned char *logs, const unsigned int *bins,
+                         unsigned int nbins, unsigned int threshold)
+{
+    unsigned char d;                    /* Dog being checked. */
+    unsigned char id;                   /* Its ID. */
+    unsigned int i;                     /* Bin being checked. */
+    unsigned int bin;                   /* Its index in the key. */
+    unsigned int err;                   /* Error for this dog so far. */
+    unsigned int limit;                 /* Error this dog has to stay under. */
+    unsigned int best = 0xFFFF;         /* Error of the best dog so far. */
+    unsigned long scaled;               /* Scaled threshold for this dog. */
+    unsigned char bestid = NO_DOG;
+
+    for (d = 0; d < key_count(); d++)
+    {
+        /* Skip the slots that no dog has been enrolled in. */
+        id = key_id(d);
+        if (id == NO_DOG) {
+            continue;
+        }
+
+        /* The dog has to be under its threshold, and better than the best. */
+        scaled = KEY_WEIGHT_ONE * (unsigned long)((threshold != 0) ?
+                                                  threshold : key_threshold(d));
+        limit = (scaled > 0xFFFF) ? 0xFFFF : scaled;
+        if (best < limit) {
+            limit = best;
+        }
+
+        /* Add up the error, giving up as soon as the dog cannot win. */
+        err = 0;
+        for (i = 0; i < nbins && err < limit; i++)
+        {
+            bin = (bins == NULL) ? i : bins[i];
+            err += abs(logs[i] - key_bin(d, bin)) * key_weight(d, bin);
+        }
+
+        if (err < limit) {
+            best = err;
+            bestid = id;
+        }
+    }
+
+    return bestid;
+}
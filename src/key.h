@@ -0,0 +1,224 @@
+/*
+ * key.h
+ *
+ * Power spectra for the keys to the dog bowl.
+ *
+ * This file describes the table of enrolled dogs. Each entry holds the
+ * magnitude of the power spectrum of the dog's bark, which is compared to the
+ * recorded spectrum in order to identify the dog that barked, along with the
+ * ID of the dog and how close a recording has to be to count as a match.
+ *
+ * Every bin of a key is a log10 magnitude, which fits in 4 bits, so the bins
+ * are packed two to a byte. The table is kept in program memory, so it does not
+ * take up any SRAM; it should only be read with the functions below.
+ *
+ * If built with 'USE_ENROLL', dogs can also be enrolled on the board (see
+ * 'enroll.h'). Those keys come after the ones in the table. They are kept in
+ * SRAM, so that they are as quick to match as the table, and saved to the
+ * EEPROM so that they last through a reset. Each of their bins also has a
+ * weight, so that the bins that vary from bark to bark count for less.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Packed keys in program memory.
+ *      16 Oct 2026     agent               Keys in natural order.
+ *      16 Oct 2026     agent               Added keys enrolled on the board.
+ *      16 Oct 2026     agent               16-bit thresholds.
+ */
+
+#ifndef _KEY_H_
+#define _KEY_H_
+
+
+#include "data.h"
+#include "progmem.h"
+
+
+#define KEY_BINS            (SAMPLE_SIZE / 2 + 1)   /* Bins in each key. */
+#define NO_DOG              0       /* ID returned when nothing matches. */
+
+#ifndef ENROLL_SLOTS
+#define ENROLL_SLOTS        4       /* Dogs that can be enrolled here. */
+#endif
+#ifndef KEY_EEPROM_ADDR
+#define KEY_EEPROM_ADDR     0       /* Where the enrolled dogs are saved. */
+#endif
+
+/* Weight of a bin that counts fully. Bins of the table all have this weight,
+ * and the errors in 'key_search' are counted in units of 1 / KEY_WEIGHT_ONE. */
+#define KEY_WEIGHT_ONE      4
+
+/* Marks a slot in the EEPROM that holds an enrolled dog. This depends on the
+ * size of the keys, so they are dropped if 'SAMPLE_SIZE' changes, and on the
+ * layout of 'enrolled_key', so keys saved with 8-bit thresholds are dropped. */
+#define KEY_EEPROM_TAG      (0xB0 | LOG2_SAMPLE_SIZE)
+
+/* Packs two consecutive bins of a key into a byte, the first in the low 4
+ * bits. */
+#define KEY_PAIR(a, b)      (((a) & 0x0F) | (((b) & 0x0F) << 4))
+
+
+/*
+ * dog_key
+ *
+ * Description: Data type for one enrolled dog in the key table.
+ *
+ * Members:     id         The ID of the dog; never 'NO_DOG'.
+ *              threshold  A recording matches this dog only if the total error
+ *                         over all of the bins is less than this. This takes
+ *                         16 bits, since a key of 513 bins can be off by more
+ *                         than 255 bins and still be a good match.
+ *              bins       The (integer) log10 magnitude of each of the
+ *                         'KEY_BINS' unique bins of the bark, in natural order
+ *                         from bin 0 to bin SAMPLE_SIZE/2, so that a band of
+ *                         frequencies is a run of bins. These are packed two
+ *                         to a byte with 'KEY_PAIR'.
+ */
+typedef struct _dog_key {
+    unsigned char id;
+    unsigned short threshold;
+    unsigned char bins[(KEY_BINS + 1) / 2];
+} dog_key;
+
+
+/*
+ * enrolled_key
+ *
+ * Description: Data type for a dog enrolled on the board. This is also how it
+ *              is laid out in the EEPROM.
+ *
+ * Members:     key      The ID, threshold, and bins of the dog, as in the
+ *                       table.
+ *              weights  How much each bin counts toward the error, from 0 to
+ *                       'KEY_WEIGHT_ONE', packed two to a byte with 'KEY_PAIR'.
+ *              tag      'KEY_EEPROM_TAG' if the slot holds a dog. This is last,
+ *                       so that it is written last.
+ */
+typedef struct _enrolled_key {
+    dog_key key;
+    unsigned char weights[(KEY_BINS + 1) / 2];
+    unsigned char tag;
+} enrolled_key;
+
+
+extern const dog_key keys[] PROGMEM;    /* The enrolled dogs. */
+extern const unsigned char num_keys;    /* Number of entries in 'keys'. */
+
+
+/*
+ * key_count
+ *
+ * Description: Gets the number of keys that can be searched, including the
+ *              slots for dogs enrolled on the board.
+ *
+ * Returns:     Returns the number of keys. Slots with no dog in them have the
+ *              ID 'NO_DOG'.
+ */
+unsigned char key_count(void);
+
+
+/*
+ * key_id
+ *
+ * Description: Gets the ID of an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *
+ * Returns:     Returns the ID of the dog.
+ */
+unsigned char key_id(unsigned char dog);
+
+/*
+ * key_bin
+ *
+ * Description: Gets one bin of the key for an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *              bin  The index of the bin in the key.
+ *
+ * Returns:     Returns the log10 magnitude of the bin.
+ */
+unsigned char key_bin(unsigned char dog, unsigned int bin);
+
+/*
+ * key_threshold
+ *
+ * Description: Gets the error threshold for an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *
+ * Returns:     Returns the threshold, in whole bins of error.
+ */
+unsigned int key_threshold(unsigned char dog);
+
+#ifdef USE_ENROLL
+/*
+ * key_weight
+ *
+ * Description: Gets the weight of one bin of the key for an enrolled dog.
+ *
+ * Arguments:   dog  The index of the dog in the table.
+ *              bin  The index of the bin in the key.
+ *
+ * Returns:     Returns the weight of the bin, from 0 to 'KEY_WEIGHT_ONE'.
+ */
+unsigned char key_weight(unsigned char dog, unsigned int bin);
+
+/*
+ * key_load
+ *
+ * Description: Reads the dogs enrolled on the board from the EEPROM. Slots that
+ *              were never written, or were written for another 'SAMPLE_SIZE',
+ *              are left empty.
+ *
+ * Notes:       This must be called before any keys are searched.
+ */
+void key_load(void);
+
+/*
+ * key_store
+ *
+ * Description: Enrolls a dog on the board, replacing the dog with the same ID
+ *              if there is one, or else taking an empty slot. The key can be
+ *              matched right away, and is written to the EEPROM in the
+ *              background.
+ *
+ * Arguments:   key  The new key. The tag does not need to be filled in.
+ *
+ * Returns:     Returns nonzero if the dog was enrolled, or 0 if every slot is
+ *              taken by another dog.
+ *
+ * Notes:       If the last key stored is still being written, this waits for it
+ *              to finish first.
+ */
+unsigned char key_store(const enrolled_key *key);
+#endif
+
+
+/*
+ * key_search
+ *
+ * Description: Finds the enrolled dog whose key is the best match for a
+ *              recorded spectrum. The error for a dog is the sum of the
+ *              absolute differences between the recorded bins and the key,
+ *              each times the weight of the bin. The dog with the smallest
+ *              error wins, as long as the error is below the threshold.
+ *
+ * Arguments:   logs       The (integer) log10 magnitude of each recorded bin.
+ *              bins       The index in the key of each entry of 'logs', or NULL
+ *                         if 'logs' holds every bin of the key in order.
+ *              nbins      The number of entries in 'logs'.
+ *              threshold  The error threshold to use for every dog, or 0 to use
+ *                         each dog's own threshold.
+ *
+ * Returns:     Returns the ID of the best matching dog, or 'NO_DOG' if no dog
+ *              matches.
+ *
+ * Notes:       Once the error for a dog reaches the best error so far (or the
+ *              threshold), it cannot win, so the rest of its bins are skipped.
+ */
+unsigned char key_search(const unsigned char *logs, const unsigned int *bins,
+                         unsigned int nbins, unsigned int threshold);
+
+
+#endif /* end of include guard: _KEY_H_ */
@@ -5,20 +5,57 @@
  *
  * This file contains the main loop for controlling access to the dog bowl. It
  * acts like a finite state machine, opening the bowl only when an object is
- * nearby and the FFT analysis gets a match. The bowl is then closed once the
- * proximity sensors are no longer active.
+ * nearby and the FFT analysis matches one of the enrolled dogs. The bowl is
+ * then closed once the proximity sensors are no longer active.
+ *
+ * The main loop is driven by events posted by the interrupts (see 'events.h').
+ * While it is waiting and no event is pending, the CPU sleeps.
+ *
+ * If built with 'USE_ENROLL', a new dog can be enrolled with a command over the
+ * UART (see 'enroll.h'). While it is being enrolled, the spectrum of each
+ * recording goes into the new key instead of being matched, and the bowl stays
+ * closed. The dog still has to be at the bowl, so that stray noise does not
+ * end up in its key.
  *
  * Revision History:
  *      05 Jun 2015     Brian Kubisiak      Initial revision.
+ *      16 Oct 2026     agent               Pass FFT exponent to the matcher.
+ *      16 Oct 2026     agent               Select the FFT datapath at build
+ *                                          time.
+ *      16 Oct 2026     agent               Use the real-input FFT.
+ *      16 Oct 2026     agent               Acquire and release ADC buffers.
+ *      16 Oct 2026     agent               Analyze windows from the ADC ring.
+ *      16 Oct 2026     agent               Added the Goertzel matcher.
+ *      16 Oct 2026     agent               Open for any enrolled dog.
+ *      16 Oct 2026     agent               Run on the HAL, so it builds on
+ *                                          hosts.
+ *      16 Oct 2026     agent               Added trace probes.
+ *      16 Oct 2026     agent               Sleep until an event comes in.
+ *      16 Oct 2026     agent               Require a quorum of sensors.
+ *      16 Oct 2026     agent               Added the enrollment mode.
+ *      16 Oct 2026     agent               Added the band matcher.
+ *      16 Oct 2026     agent               Added the DTW matcher.
+ *      16 Oct 2026     agent               Read 16-bit Q15 samples from the
+ *                                          ring.
+ *      16 Oct 2026     agent               Dump the trace while the ADC is
+ *                                          idle.
  */
 
-#include <avr/interrupt.h>
+#include <stddef.h>
 
 #include "adc.h"
+#include "bands.h"
 #include "data.h"
+#include "dtw.h"
+#include "enroll.h"
+#include "events.h"
 #include "fft.h"
+#include "goertzel.h"
+#include "hal.h"
+#include "key.h"
 #include "proximity.h"
 #include "pwm.h"
+#include "trace.h"
 
 
 /*
@@ -26,14 +63,15 @@
  *
  * Description: Data type for representing the current state of the dog bowl. It
  *              can be waiting for input, performing Fourier analysis, opening
- *              the bowl, or reseting the data.
+ *              the bowl, reseting the data, or adding a recording to the key
+ *              of a dog being enrolled.
  *
  * Notes:       This is used by the main loop FSM for determining what to do
  *              with hardware events. To see the transitions, read the
  *              documentation or the switch statement in the main loop.
  */
 typedef enum _state {
-    INIT_STATE, FFT_STATE, OPEN_STATE, RESET_STATE
+    INIT_STATE, FFT_STATE, OPEN_STATE, RESET_STATE, ENROLL_STATE
 } state;
 
 
@@ -41,58 +79,209 @@ typedef enum _state {
  * main
  *
  * Description: The main loop for the program is a finite state machine that
- *              polls the inputs (the data buffer and proximity sensors) to
- *              determine when to transition between states. For a full
- *              description of the FSM, see the documentation.
+ *              waits for events from the interrupts (a recording being ready,
+ *              or the proximity sensors changing) to determine when to
+ *              transition between states. For a full description of the FSM,
+ *              see the documentation.
  *
- * Notes:       This main loop is not very efficient because it polls the inputs
- *              and runs some of the functions several times in a row.
+ * Notes:       Only the states that wait on the hardware (waiting for a
+ *              recording, and waiting for the dog to leave) take events; the
+ *              CPU sleeps in them until an interrupt comes in. The other states
+ *              run straight through. On the board, this never returns; on the
+ *              host, it returns once the simulation is done.
  */
 int main(void)
 {
     state curstate = INIT_STATE;
-    complex *buf;
+    sample *buf = NULL;
+#if defined(USE_BANDS)
+    unsigned char exponent;
+    unsigned char levels[NUM_BANDS];    /* Level of each band. */
+#elif !defined(USE_GOERTZEL)
+    unsigned char exponent;
+    unsigned char logs[KEY_BINS];   /* Log magnitude of each bin. */
+#endif
+    unsigned char dog = NO_DOG;     /* Dog that was identified. */
+    unsigned char ready;            /* Whether there is data to analyze. */
+    unsigned char ev;               /* Event that woke up the main loop. */
+#ifdef ADC_STREAM
+    static sample work[SAMPLE_POINTS];  /* Holds the FFT of a window. */
+    const ring_sample *ring = NULL; /* Ring that the window is in. */
+    unsigned int start = 0;         /* Position of the window's first sample,
+                                     * counted from when the ADC started. */
+#endif
+#ifdef USE_DTW
+    unsigned int laststart = 0;     /* Position of the last window matched. */
+#endif
+#ifdef USE_TRACE
+    state laststate = INIT_STATE;   /* For tracing changes of state. */
+#endif
+
+    hal_init();
+    TRACE_INIT();
+
+#ifdef USE_GOERTZEL
+    /* Pick the bins to check before the ADC starts feeding the matcher. */
+    goertzel_init();
+#endif
+
+#ifdef USE_ENROLL
+    /* Load the dogs enrolled before, and listen for commands. */
+    enroll_init();
+#endif
+
+#ifdef USE_DTW
+    /* No windows have been matched yet. */
+    dtw_reset();
+#endif
 
     /* Initialize the peripherals used by the main loop. */
     init_adc();
     init_prox_gpio();
     init_pwm();
 
-    DDRC = 0xFF;
-
     /* Turn on interrupts. */
-    sei();
+    hal_irq_enable();
 
     /* Loop forever, until reset is applied or power is take away. */
-    for (;;)
+    while (hal_running())
     {
+        /* In the states that wait on the hardware, sleep until an interrupt
+         * posts an event. If the interrupt that woke the CPU up did not post
+         * one, there is nothing to do but go back to sleep. */
+        if (curstate == INIT_STATE || curstate == OPEN_STATE) {
+            /* While the ADC has nothing for the main loop, send out the trace
+             * a line at a time instead of sleeping, so that a recording is
+             * never held up by more than a line. */
+            if (curstate == INIT_STATE && adc_idle() && TRACE_DUMP()) {
+                continue;
+            }
+
+            ev = event_get();
+            if (ev == EV_NONE) {
+                continue;
+            }
+        }
+
         /* Determine the actions to perform as well as the next state based on
          * the current state. */
         switch (curstate)
         {
         case INIT_STATE:
-            /* If data is ready and the proximity sensors are tripped, start the
-             * data analysis. */
-            if (is_data_collected() && is_obj_nearby()) {
+#ifdef USE_ENROLL
+            /* Start enrolling a dog if one was asked for. */
+            enroll_poll();
+#endif
+
+            /* Any event could come with a recording ready, so always check;
+             * this way, a recording is not lost if its own event is. */
+#if defined(USE_GOERTZEL)
+            /* Check for a finished recording. The matcher works on the
+             * samples as they come in, so the decision is already made. */
+            ready = goertzel_result(&dog);
+#elif defined(ADC_STREAM)
+            /* Check for a marked window. It stays in the ring, which the ADC
+             * keeps recording into. */
+            ring = adc_acquire_window(&start);
+            ready = (ring != NULL);
+#else
+            /* Check for a finished recording. The ADC keeps recording into
+             * the other buffers while this one is being worked on. */
+            buf = adc_acquire();
+            ready = (buf != NULL);
+#endif
+
+            /* If data is ready and enough of the proximity sensors are
+             * tripped, start the data analysis. */
+            if (ready && prox_count() >= PROX_QUORUM) {
                 curstate = FFT_STATE;
             }
             /* If the data is ready, but the sensors are not tripped, then we
              * can ignore the noise. Reset the buffer and start waiting again.
              */
-            else if (is_data_collected() && !is_obj_nearby()) {
+            else if (ready) {
                 curstate = RESET_STATE;
             }
             /* Else, data is not collected; keep waiting in this state. */
             break;
         case FFT_STATE:
-            /* Get the buffer of data and perform an FFT on the data. */
-            buf = adc_get_buffer();
-            fft(buf);
-
-            /* Check that the recorded frequency spectrum matches the stored
-             * spectrum. */
-            if (is_fft_match(buf)) {
-                /* If the spectrum matches, open the bowl. */
+            /* Perform an FFT on the data, using whichever datapath the code was
+             * built for. Then check that the recorded frequency spectrum
+             * matches one of the stored spectra. */
+#if defined(USE_GOERTZEL)
+            /* Nothing to do; the dog was found with the recording. */
+#else
+#if defined(ADC_STREAM)
+            /* The first pass of the FFT reads the window straight out of the
+             * ring, so it never has to be copied out. */
+            buf = work;
+            TRACE(TRACE_FFT_BEGIN);
+#ifdef USE_Q15
+            exponent = fft_q15_ring(buf, ring, start, RING_SIZE - 1);
+#else
+            exponent = rfft_ring(buf, ring, start, RING_SIZE - 1);
+#endif
+#elif defined(USE_Q15)
+            TRACE(TRACE_FFT_BEGIN);
+            exponent = fft_q15(buf);
+#else
+            TRACE(TRACE_FFT_BEGIN);
+            exponent = rfft(buf);
+#endif
+            TRACE(TRACE_FFT_END);
+
+            /* Take the log magnitude of each bin (or the level of each band),
+             * in the same order as the keys. After that, the data is not
+             * needed any more. */
+            TRACE(TRACE_MATCH_BEGIN);
+#if defined(USE_BANDS) && defined(USE_Q15)
+            band_levels_q15(buf, exponent, levels);
+#elif defined(USE_BANDS)
+            band_levels(buf, exponent, levels);
+#elif defined(USE_Q15)
+            fft_logs_q15(buf, exponent, logs);
+#else
+            fft_logs(buf, exponent, logs);
+#endif
+
+#ifndef ADC_STREAM
+            /* Done with the data, so let the ADC record into it again. */
+            adc_release(buf);
+#endif
+            buf = NULL;
+
+#ifdef USE_ENROLL
+            /* While a dog is being enrolled, the spectrum goes into its new
+             * key instead. */
+            if (enroll_active()) {
+                TRACE(TRACE_MATCH_END);
+                curstate = ENROLL_STATE;
+                break;
+            }
+#endif
+
+            /* Find the dog that is the closest match. */
+#if defined(USE_DTW)
+            /* The bark is matched over consecutive windows, so start over if
+             * any were skipped since the last one. */
+            if (start - laststart != HOP_SIZE) {
+                dtw_reset();
+            }
+            laststart = start;
+            dog = dtw_update(levels);
+#elif defined(USE_BANDS)
+            dog = band_search(levels);
+#else
+            dog = key_search(logs, NULL, KEY_BINS, 0);
+#endif
+            TRACE(TRACE_MATCH_END);
+#endif
+            hal_decision();
+
+            if (dog != NO_DOG) {
+                /* If the spectrum matches any of the dogs, open the bowl right
+                 * away, then wait for the dog to leave. */
+                pwm_open();
                 curstate = OPEN_STATE;
             }
             else {
@@ -101,8 +290,20 @@ int main(void)
             }
             break;
         case OPEN_STATE:
-            /* Open the bowl after identifying the dog. */
-            pwm_open();
+            /* Throw away anything recorded while the bowl is open. */
+#if defined(USE_GOERTZEL)
+            (void)goertzel_result(&dog);
+#elif defined(ADC_STREAM)
+            while (adc_acquire_window(&start) != NULL)
+            {
+                /* Nothing to do with the window. */
+            }
+#else
+            while ((buf = adc_acquire()) != NULL)
+            {
+                adc_release(buf);
+            }
+#endif
 
             /* Wait until the proximity sensors are no longer tripped before
              * closing the bowl. */
@@ -110,12 +311,25 @@ int main(void)
                 curstate = RESET_STATE;
             }
             break;
+#ifdef USE_ENROLL
+        case ENROLL_STATE:
+            /* Add the recording to the key. Once enough are in, the key is
+             * saved and the dog is enrolled. The bowl stays closed. */
+            (void)enroll_add(logs);
+            curstate = RESET_STATE;
+            break;
+#endif
         case RESET_STATE:
             /* Close the dog bowl. */
             pwm_close();
 
-            /* Reset the data collection. */
-            adc_reset_buffer();
+#ifndef ADC_STREAM
+            /* Give back the data if it was not analyzed. */
+            if (buf != NULL) {
+                adc_release(buf);
+                buf = NULL;
+            }
+#endif
 
             /* Go back to waiting for data. */
             curstate = INIT_STATE;
@@ -125,6 +339,14 @@ int main(void)
             curstate = INIT_STATE;
             break;
         }
+
+#ifdef USE_TRACE
+        /* Record every change of state. */
+        if (curstate != laststate) {
+            TRACE(TRACE_STATE + curstate);
+            laststate = curstate;
+        }
+#endif
     }
 
     return 0;
@@ -0,0 +1,129 @@
+/*
+ * preprocess.c
+ *
+ * Front end for the samples from the ADC.
+ *
+ * This file contains code for cleaning up each sample as the ADC records it,
+ * before it is stored or passed to the matcher. Each sample x[n] goes through
+ * these steps:
+ *      DC level      m[n] = m[n-1] + (x[n] - m[n-1]) / 2^DC_SHIFT
+ *      DC removal    d[n] = x[n] - m[n]
+ *      pre-emphasis  e[n] = d[n] - (15/16) d[n-1]
+ *      window        y[n] = w[n] e[n]
+ * where the window 'w' is a table of 'SAMPLE_SIZE' weights in program memory.
+ * The whole 16-bit sample is used, so that the bits below the top 8 (from a
+ * 10-bit ADC, or from oversampling) are kept for the Q15 datapath. The DC
+ * level only needs the top 8 bits, and is kept with 7 fraction bits below
+ * them; the pre-emphasis is kept with 4 fraction bits, in 32 bits. Nothing in
+ * here is built without 'USE_PREPROCESS'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Take the bias off as unsigned.
+ *      16 Oct 2026     agent               Take all 16 bits of the sample.
+ */
+
+#include "preprocess.h"
+#include "progmem.h"
+
+#ifdef USE_PREPROCESS
+
+/* Largest magnitude of a 16-bit result. */
+#define RESULT_LIMIT    32767L
+
+/* Weights of the window, from 0 to 255, in program memory. */
+extern const unsigned char window[SAMPLE_SIZE] PROGMEM;
+
+static int dc = 0;                  /* DC level, with 7 fraction bits. */
+static long last = 0;               /* Last sample with the DC taken out. */
+#ifndef ADC_STREAM
+static unsigned int pos = 0;        /* Position in the window. */
+#endif
+
+
+/*
+ * preprocess_init
+ *
+ * Description: Forgets the DC level and the state of the filter, so that the
+ *              front end starts over as if no samples had been seen.
+ */
+void preprocess_init(void)
+{
+    dc = 0;
+    preprocess_start();
+}
+
+
+/*
+ * preprocess_start
+ *
+ * Description: Gets ready for a new recording. The window starts over at its
+ *              first weight, and the pre-emphasis filter starts from silence.
+ *              The DC level is kept, since it carries over from one recording
+ *              to the next.
+ */
+void preprocess_start(void)
+{
+    last = 0;
+#ifndef ADC_STREAM
+    pos = 0;
+#endif
+}
+
+
+/*
+ * preprocess_sample
+ *
+ * Description: Runs one sample through the front end: takes out the DC level,
+ *              applies the pre-emphasis filter, and weights the result by the
+ *              next point of the window.
+ *
+ * Arguments:   value  The sample, in offset binary and left-adjusted to 16
+ *                     bits as from the ADC, with the mid-rail bias at 0x8000.
+ *
+ * Returns:     Returns the new sample as a signed 16-bit fraction, scaled the
+ *              same as the sample with the bias taken off. The top 8 bits can
+ *              be used as an 8-bit sample.
+ *
+ * Notes:       This is called by the ADC interrupt for every sample, so it has
+ *              to be fast. At most 'SAMPLE_SIZE' samples should be run through
+ *              after each call to 'preprocess_start'.
+ */
+int preprocess_sample(unsigned int value)
+{
+    long x = (long)value - 0x8000;  /* The sample, with the bias taken off. */
+    long d;                     /* The sample with the DC level taken out. */
+    long e;                     /* After pre-emphasis, with 4 fraction bits. */
+    long y;                     /* The result. */
+
+
+    /* Move the DC level a little toward the top 8 bits of this sample, then
+     * take it out of all 16. */
+    dc += ((int)(x >> 8) * 128 - dc) >> DC_SHIFT;
+    d = x - (long)((dc + 64) >> 7) * 256;
+
+    /* Take away 15/16 of the last sample to flatten out the spectrum. */
+    e = d * 16 - last * 15;
+    last = d;
+
+#ifdef ADC_STREAM
+    /* The windows overlap, so no window is applied here. */
+    y = e >> 4;
+#else
+    /* Weight the sample by the window; the weights have 8 fraction bits. */
+    y = (e * pgm_read_byte(&window[pos])) >> 12;
+    pos++;
+#endif
+
+    /* A loud sample with a big jump can overflow, so clip it. */
+    if (y > RESULT_LIMIT) {
+        y = RESULT_LIMIT;
+    }
+    else if (y < -RESULT_LIMIT) {
+        y = -RESULT_LIMIT;
+    }
+
+    return y;
+}
+
+#endif
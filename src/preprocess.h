@@ -0,0 +1,80 @@
+/*
+ * preprocess.h
+ *
+ * Front end for the samples from the ADC.
+ *
+ * This file contains an interface for cleaning up each sample as the ADC
+ * records it, before it is stored or passed to the matcher. The samples sit on
+ * a DC level from the microphone, and the spectrum of a bark falls off quickly
+ * with frequency. So the DC level is tracked and taken out, the high
+ * frequencies are brought back up with a pre-emphasis filter, and the
+ * recording is multiplied by a window (Hann, or Hamming with
+ * 'PREPROCESS_HAMMING') from a table in 'roots.c'. All of this is done one
+ * sample at a time in the ADC interrupt, so the buffer is ready for the FFT as
+ * soon as the last sample is in, with no extra pass over it.
+ *
+ * The windows overlap in the ring buffer mode ('ADC_STREAM'), so each sample
+ * would need a different weight for each window it is in. There, only the DC
+ * level and the pre-emphasis are done, and the windows are left as they are.
+ *
+ * This is only used if built with 'USE_PREPROCESS'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Take the bias off as unsigned.
+ *      16 Oct 2026     agent               Take all 16 bits of the sample.
+ */
+
+#ifndef _PREPROCESS_H_
+#define _PREPROCESS_H_
+
+
+#include "data.h"
+
+
+#ifndef DC_SHIFT
+#define DC_SHIFT            6       /* Log2 of the samples the DC level is
+                                     * averaged over. */
+#endif
+
+
+/*
+ * preprocess_init
+ *
+ * Description: Forgets the DC level and the state of the filter, so that the
+ *              front end starts over as if no samples had been seen.
+ */
+void preprocess_init(void);
+
+/*
+ * preprocess_start
+ *
+ * Description: Gets ready for a new recording. The window starts over at its
+ *              first weight, and the pre-emphasis filter starts from silence.
+ *              The DC level is kept, since it carries over from one recording
+ *              to the next.
+ */
+void preprocess_start(void);
+
+/*
+ * preprocess_sample
+ *
+ * Description: Runs one sample through the front end: takes out the DC level,
+ *              applies the pre-emphasis filter, and weights the result by the
+ *              next point of the window.
+ *
+ * Arguments:   value  The sample, in offset binary and left-adjusted to 16
+ *                     bits as from the ADC, with the mid-rail bias at 0x8000.
+ *
+ * Returns:     Returns the new sample as a signed 16-bit fraction, scaled the
+ *              same as the sample with the bias taken off. The top 8 bits can
+ *              be used as an 8-bit sample.
+ *
+ * Notes:       This is called by the ADC interrupt for every sample, so it has
+ *              to be fast. At most 'SAMPLE_SIZE' samples should be run through
+ *              after each call to 'preprocess_start'.
+ */
+int preprocess_sample(unsigned int value);
+
+
+#endif /* end of include guard: _PREPROCESS_H_ */
@@ -0,0 +1,35 @@
+/*
+ * progmem.h
+ *
+ * Access to constants stored in program memory.
+ *
+ * On the AVR, constant tables such as the roots of unity and the keys are kept
+ * in flash with 'PROGMEM' rather than being copied into SRAM at startup, and
+ * have to be read with the 'pgm_read_*' functions. This file pulls those in on
+ * the AVR, and defines stand-ins that just read memory for everything else, so
+ * that the same code can run on the build host.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Added 'pgm_read_dword'.
+ */
+
+#ifndef _PROGMEM_H_
+#define _PROGMEM_H_
+
+
+#ifdef __AVR__
+
+#include <avr/pgmspace.h>
+
+#else
+
+#define PROGMEM
+#define pgm_read_byte(addr)     (*(const unsigned char *)(addr))
+#define pgm_read_word(addr)     (*(const unsigned short *)(addr))
+#define pgm_read_dword(addr)    (*(const unsigned long *)(addr))
+
+#endif
+
+
+#endif /* end of include guard: _PROGMEM_H_ */
@@ -9,6 +9,18 @@
  * functions in this file will read the status off the GPIO pins to determine
  * whether or not anything is detected by the ultrasonic rangefinders.
  *
+ * Port A has no pin change interrupts, so the pins are read on the periodic
+ * tick instead. Each sensor is debounced on its own: a sensor only counts as
+ * tripped once its pin has been active for 'PROX_ON_TICKS' ticks in a row, and
+ * only counts as clear once its pin has been inactive for 'PROX_OFF_TICKS'
+ * ticks in a row. The clear time is the longer of the two, so that a dog
+ * moving around at the bowl does not close it. Whenever the debounced sensors
+ * change, an 'EV_PROXIMITY' event is posted to wake up the main loop.
+ *
+ * The debounced sensors, the number of them that are tripped, and the time
+ * that the bowl has been occupied are all kept up to date by the tick, so the
+ * main loop can read any of them without doing any work.
+ *
  * Peripherals Used:
  *      GPIO
  *
@@ -18,19 +30,60 @@
  * Revision History:
  *      05 Jun 2015     Brian Kubisiak      Initial revision.
  *      08 Jun 2015     Brian Kubisiak      Changed polarity of signals.
+ *      16 Oct 2026     agent               Moved the registers to the HAL.
+ *      16 Oct 2026     agent               Read the pins on the tick.
+ *      16 Oct 2026     agent               Debounce each sensor.
  */
 
-#include <avr/io.h>
-
+#include "events.h"
+#include "hal.h"
 #include "proximity.h"
 
-/* Constants for setting the values of the control registers. */
-#define DDR_INPUT   0x00    /* Configure all pins as inputs. */
-#define PORT_PULLUP 0xFF    /* Activate all pull-up resistors. */
-
 /* Constant for masking out the unused pins. */
 #define ACTIVE_PINS 0x55
 
+/* Each sensor is on every other pin, starting with the first one. */
+#define NUM_SENSORS 4
+#define FIRST_PIN   0x01
+
+/* Most ticks that the bowl can be counted as occupied for. */
+#define MAX_OCCUPIED    0xFFFF
+
+/* Debounced sensors that are tripped, and how many of them there are. */
+static volatile unsigned char sensors = 0;
+static volatile unsigned char tripped = 0;
+
+/* Ticks that each pin has disagreed with its debounced sensor for. */
+static unsigned char held[NUM_SENSORS];
+
+/* Ticks since the bowl became occupied. */
+static volatile unsigned int occupied = 0;
+
+
+/*
+ * count_sensors
+ *
+ * Description: Counts the sensors that are tripped in a set of pins.
+ *
+ * Arguments:   pins  The active pins.
+ *
+ * Returns:     Returns the number of sensors in 'pins'.
+ */
+static unsigned char count_sensors(unsigned char pins)
+{
+    unsigned char count = 0;
+    unsigned char pin;
+
+    for (pin = FIRST_PIN; pin & ACTIVE_PINS; pin <<= 2)
+    {
+        if (pins & pin) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
 /*
  * init_prox_gpio
  *
@@ -38,6 +91,7 @@
  *              to read data from the proximity sensors. This process involves:
  *               - Writing a 0 to DDA to set GPIO as input.
  *               - Writing a 1 to PORTA to enable the pull-up resistor.
+ *               - Starting the tick that reads the pins.
  *
  * Notes:       This function assumes that no other peripherals are going to use
  *              PA[0..7] pins; the configuration might not work if this is the
@@ -46,8 +100,14 @@
 void init_prox_gpio(void)
 {
     /* Set the configurations for IO port A. */
-    DDRA  = DDR_INPUT;
-    PORTA = PORT_PULLUP;
+    hal_prox_init();
+
+    /* Believe the pins at the start; there is nothing to debounce yet. */
+    sensors = ACTIVE_PINS & (~hal_prox_read());
+    tripped = count_sensors(sensors);
+
+    /* Check the pins for changes from now on. */
+    hal_tick_init();
 }
 
 
@@ -64,11 +124,100 @@ void init_prox_gpio(void)
  *
  * Notes:       The return value uses the even 4 bits to represent the
  *              rangefinders in each direction, so the number of triggered
- *              rangefinders can also be found from the return value.
+ *              rangefinders can also be found from the return value. The value
+ *              is the debounced one, as of the last tick.
  */
 unsigned char is_obj_nearby(void)
 {
     /* Returns 0 if all pins are inactive, otherwise returns nonzero. */
-    return ACTIVE_PINS & (~PINA);
+    return sensors;
+}
+
+
+/*
+ * prox_count
+ *
+ * Description: Gets the number of rangefinders that are tripped, so that the
+ *              main loop can require more than one of them to agree.
+ *
+ * Returns:     Returns the number of debounced sensors that are tripped, from
+ *              0 to 4.
+ */
+unsigned char prox_count(void)
+{
+    return tripped;
 }
 
+
+/*
+ * prox_occupied
+ *
+ * Description: Gets how long the bowl has been occupied, that is, how long it
+ *              has been since the first sensor was tripped.
+ *
+ * Returns:     Returns the number of ticks since the bowl became occupied, or
+ *              0 if no sensors are tripped. This stops counting at 65535.
+ */
+unsigned int prox_occupied(void)
+{
+    unsigned char sreg;
+    unsigned int ticks;
+
+    /* The count is changed by the tick, so read both bytes of it with
+     * interrupts off. */
+    sreg = hal_irq_save();
+    ticks = occupied;
+    hal_irq_restore(sreg);
+
+    return ticks;
+}
+
+
+/*
+ * prox_tick
+ *
+ * Description: Reads the proximity sensors and debounces them. Each pin that
+ *              disagrees with its debounced sensor has the ticks counted; once
+ *              it has disagreed for long enough, the sensor is flipped. An
+ *              'EV_PROXIMITY' event is posted if any of the debounced sensors
+ *              changed.
+ *
+ * Notes:       This is called from the tick interrupt.
+ */
+void prox_tick(void)
+{
+    unsigned char pins = ACTIVE_PINS & (~hal_prox_read());
+    unsigned char now = sensors;
+    unsigned char pin;
+    unsigned char i;
+
+    for (i = 0, pin = FIRST_PIN; i < NUM_SENSORS; i++, pin <<= 2)
+    {
+        if ((pins ^ now) & pin) {
+            /* The pin has changed; flip the sensor once it stays changed. */
+            held[i]++;
+            if (held[i] >= ((now & pin) ? PROX_OFF_TICKS : PROX_ON_TICKS)) {
+                now ^= pin;
+                held[i] = 0;
+            }
+        }
+        else {
+            /* A glitch that went away; start counting again. */
+            held[i] = 0;
+        }
+    }
+
+    /* Keep track of how long the bowl has been occupied. */
+    if (now == 0) {
+        occupied = 0;
+    }
+    else if (occupied < MAX_OCCUPIED) {
+        occupied++;
+    }
+
+    if (now != sensors) {
+        sensors = now;
+        tripped = count_sensors(now);
+        event_post(EV_PROXIMITY);
+    }
+}
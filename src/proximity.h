@@ -9,6 +9,18 @@
  * functions in this file will read the status off the GPIO pins to determine
  * whether or not anything is detected by the ultrasonic rangefinders.
  *
+ * Port A has no pin change interrupts, so the pins are read on the periodic
+ * tick instead. Each sensor is debounced on its own: a sensor only counts as
+ * tripped once its pin has been active for 'PROX_ON_TICKS' ticks in a row, and
+ * only counts as clear once its pin has been inactive for 'PROX_OFF_TICKS'
+ * ticks in a row. The clear time is the longer of the two, so that a dog
+ * moving around at the bowl does not close it. Whenever the debounced sensors
+ * change, an 'EV_PROXIMITY' event is posted to wake up the main loop.
+ *
+ * The debounced sensors, the number of them that are tripped, and the time
+ * that the bowl has been occupied are all kept up to date by the tick, so the
+ * main loop can read any of them without doing any work.
+ *
  * Peripherals Used:
  *      GPIO
  *
@@ -18,12 +30,31 @@
  * Revision History:
  *      05 Jun 2015     Brian Kubisiak      Initial revision.
  *      08 Jun 2015     Brian Kubisiak      Changed polarity of signals.
+ *      16 Oct 2026     agent               Read the pins on the tick.
+ *      16 Oct 2026     agent               Debounce each sensor.
  */
 
 #ifndef _PROXIMITY_H_
 #define _PROXIMITY_H_
 
 
+/* Ticks that a pin must be active before its sensor counts as tripped. */
+#ifndef PROX_ON_TICKS
+#define PROX_ON_TICKS       3
+#endif
+
+/* Ticks that a pin must be inactive before its sensor counts as clear. */
+#ifndef PROX_OFF_TICKS
+#define PROX_OFF_TICKS      20
+#endif
+
+/* Number of sensors that must be tripped for the main loop to believe that a
+ * dog is at the bowl. */
+#ifndef PROX_QUORUM
+#define PROX_QUORUM         1
+#endif
+
+
 /*
  * init_prox_gpio
  *
@@ -32,6 +63,7 @@
  *               - Writing a 0 to DDA to set GPIO as input.
  *               - Writing a 1 to PORTA to enable the pull-up resistor.
  *               - Writing a 0 to the PUD bit in MCUCR
+ *               - Starting the tick that reads the pins.
  *
  * Notes:       This function assumes that no other peripherals are going to use
  *              PA[0..7] pins; the configuration might not work if this is the
@@ -53,9 +85,43 @@ void init_prox_gpio(void);
  *
  * Notes:       The return value uses the even 4 bits to represent the
  *              rangefinders in each direction, so the number of triggered
- *              rangefinders can also be found from the return value.
+ *              rangefinders can also be found from the return value. The value
+ *              is the debounced one, as of the last tick.
  */
 unsigned char is_obj_nearby(void);
 
+/*
+ * prox_count
+ *
+ * Description: Gets the number of rangefinders that are tripped, so that the
+ *              main loop can require more than one of them to agree.
+ *
+ * Returns:     Returns the number of debounced sensors that are tripped, from
+ *              0 to 4.
+ */
+unsigned char prox_count(void);
+
+/*
+ * prox_occupied
+ *
+ * Description: Gets how long the bowl has been occupied, that is, how long it
+ *              has been since the first sensor was tripped.
+ *
+ * Returns:     Returns the number of ticks since the bowl became occupied, or
+ *              0 if no sensors are tripped. This stops counting at 65535.
+ */
+unsigned int prox_occupied(void);
+
+/*
+ * prox_tick
+ *
+ * Description: Reads the proximity sensors and debounces them. An
+ *              'EV_PROXIMITY' event is posted if any of the debounced sensors
+ *              changed.
+ *
+ * Notes:       This is only called from the hardware abstraction layer.
+ */
+void prox_tick(void);
+
 
 #endif /* end of include guard: _PROXIMITY_H_ */
@@ -15,10 +15,10 @@
  *
  * Revision History:
  *      05 Jun 2015     Brian Kubisiak      Initial revision.
+ *      16 Oct 2026     agent               Moved the registers to the HAL.
  */
 
-#include <avr/io.h>
-
+#include "hal.h"
 #include "pwm.h"
 
 #define BOWL_OPEN   30
@@ -36,9 +36,8 @@
  */
 void init_pwm(void)
 {
-    DDRB = 0x80;    /* Enable output on the PWM pin. */
-    TCCR0A = 0x83;  /* Set pin to fast PWM mode. */
-    TCCR0B = 0x05;  /* Prescale clock by 1024. */
+    /* Set the PWM pin to fast PWM mode. */
+    hal_servo_init();
 
     /* Start out with the bowl closed. */
     pwm_close();
@@ -57,7 +56,7 @@ void init_pwm(void)
 void pwm_open(void)
 {
     /* Set the new PWM compare value. */
-    OCR0A = BOWL_OPEN;
+    hal_servo_set(BOWL_OPEN);
 }
 
 /*
@@ -73,6 +72,6 @@ void pwm_open(void)
 void pwm_close(void)
 {
     /* Set the new PWM compare value. */
-    OCR0A = BOWL_CLOSED;
+    hal_servo_set(BOWL_CLOSED);
 }
 
@@ -0,0 +1,1071 @@
+/*
+ * replay-fft.c
+ *
+ * Replays labeled recordings through the matcher and checks the results.
+ *
+ * This file contains a host-side tool that measures how well the dog bowl tells
+ * dogs apart, and how long it takes to do it. Recordings are cut into windows
+ * the way the ADC would record them: a window starts at the first sample loud
+ * enough to trip the trigger, and the next trigger is looked for after the end
+ * of the window. Each window is run through the same transform and matcher as
+ * the main loop (whichever ones the code was built for), and the dog it matches
+ * is checked against the label of the recording.
+ *
+ * The results are the true accept rate (windows of an enrolled dog that are
+ * matched to that dog), the false accept rate (windows of anything else that
+ * open the bowl), and the time taken per window, including loading the samples
+ * the way the ADC interrupt does (and running them through the front end, if
+ * built with 'USE_PREPROCESS').
+ *
+ * If built with 'USE_DTW', each recording is instead streamed through the ring
+ * buffer the way the ADC records it in the ring buffer mode, starting with the
+ * window that is open when the recording starts. Every window is matched in
+ * turn, and the result for the recording is the first dog found, so each
+ * recording counts as one window in the rates. The barks in the built-in set
+ * are barked twice, since the matcher looks for the whole bark.
+ *
+ * Usage:
+ *      replay-fft [-c baseline | -w baseline] [id file]...
+ * Each recording is given as the ID of the dog in it (0 for anything that is
+ * not an enrolled dog) followed by the file. Files are either WAV (8 or 16-bit
+ * PCM; only the first channel is used) or raw signed 8-bit samples, and are
+ * taken to be at the sample rate of the ADC. With no recordings, a built-in set
+ * is used: the barks of both dogs in 'test-fft.c' at different levels and with
+ * added noise, synthetic barks of other dogs, and mailman noise (hiss, hum, and
+ * bursts).
+ *
+ * With '-w', the results are written to the baseline file. With '-c', they are
+ * checked against it, and the program fails if fewer windows of enrolled dogs
+ * were matched to the right dog, more windows were matched to the wrong dog,
+ * or more windows of anything else were accepted. The counts are the same on
+ * every host. So that the speed can be checked too, a fixed reference workload
+ * (a plain DFT of 'REF_WINDOWS' windows) is timed after each pass, and the
+ * program fails if the median over the passes of the time per window, relative
+ * to that, grew by more than 'SPEED_SLACK'. The time per window in nanoseconds
+ * is kept in the baseline as well, but a change in it only gives a warning,
+ * since it depends on the host.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Run the samples through the front
+ *                                          end.
+ *      16 Oct 2026     agent               Added the band matcher.
+ *      16 Oct 2026     agent               Added the DTW matcher.
+ *      16 Oct 2026     agent               Added the second dog.
+ *      16 Oct 2026     agent               Check counts, and the time relative
+ *                                          to a reference workload.
+ *      16 Oct 2026     agent               Give samples to the front end in
+ *                                          offset binary, like the ADC.
+ *      16 Oct 2026     agent               Keep 16 bits in the Q15 ring.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "adc.h"
+#include "bands.h"
+#include "data.h"
+#include "dtw.h"
+#include "fft.h"
+#include "goertzel.h"
+#include "key.h"
+#include "preprocess.h"
+
+
+/* Smallest sample (in absolute value) that trips the trigger. */
+#define TRIGGER_LEVEL   24
+
+/* Number of times the windows are timed. The relative time is the median
+ * over the passes; the time per window is from the fastest pass. */
+#define PASSES          100
+
+/* Most sets of recordings that are reported separately. */
+#define MAX_SETS        16
+
+/* How much slower than the baseline a window can get, relative to the
+ * reference workload, before failing. */
+#define SPEED_SLACK     1.5
+
+/* Windows in the reference workload. */
+#define REF_WINDOWS     256
+
+/* A sample of a recording as the ADC gives it: biased to mid-rail, in offset
+ * binary, and left-adjusted to 16 bits. */
+#define ADC_VALUE(x)    ((unsigned int)((x) + 128) << 8)
+
+/* A sample as the ADC interrupt stores it, as 8 bits or as the top of a 16-bit
+ * fraction. With the front end, the samples have to be taken in order. */
+#ifdef USE_PREPROCESS
+#define SAMPLE8(x)      ((char)(preprocess_sample(ADC_VALUE(x)) >> 8))
+#define SAMPLE16(x)     preprocess_sample(ADC_VALUE(x))
+#else
+#define SAMPLE8(x)      ((char)(ADC_SIGNED(ADC_VALUE(x)) >> 8))
+#define SAMPLE16(x)     ADC_SIGNED(ADC_VALUE(x))
+#endif
+
+/* Barks in the built-in set. For the DTW matcher, a bark is two pulses with a
+ * hop of silence between them, so the matcher has a rhythm to follow; each
+ * pulse is one window long. */
+#ifdef USE_DTW
+#define BARKS           2
+#define BARK_GAP        HOP_SIZE
+#else
+#define BARKS           1
+#define BARK_GAP        0
+#endif
+#define BARK_LENGTH     (BARKS * SAMPLE_SIZE + (BARKS - 1) * BARK_GAP)
+
+/* Sample 'i' of a bark, as the position in the pulse that it falls in. Any
+ * position past the end of the pulse is in the gap. */
+#define PULSE(i)        ((i) % (SAMPLE_SIZE + BARK_GAP))
+
+#ifndef M_PI
+#define M_PI            3.14159265358979323846
+#endif
+
+
+/*
+ * recording
+ *
+ * Description: Data type for one labeled recording.
+ *
+ * Members:     set      Name of the set that the recording is reported in.
+ *              dog      ID of the dog in the recording, or 'NO_DOG'.
+ *              samples  The samples of the recording.
+ *              length   The number of samples.
+ */
+typedef struct _recording {
+    const char *set;
+    unsigned char dog;
+    char *samples;
+    unsigned long length;
+} recording;
+
+/*
+ * set_result
+ *
+ * Description: Data type for the results of one set of recordings.
+ *
+ * Members:     name      Name of the set.
+ *              windows   Number of windows replayed.
+ *              accepted  Number of windows that opened the bowl.
+ */
+typedef struct _set_result {
+    const char *name;
+    unsigned long windows;
+    unsigned long accepted;
+} set_result;
+
+/*
+ * totals
+ *
+ * Description: Data type for the results over all of the recordings, as
+ *              written to a baseline.
+ *
+ * Members:     dogwin    Windows of enrolled dogs.
+ *              dogok     Windows of enrolled dogs matched to the right dog.
+ *              wrong     Windows of enrolled dogs matched to the wrong dog.
+ *              otherwin  Windows of anything else.
+ *              otherok   Windows of anything else that opened the bowl.
+ *              relative  Time per window over the time per reference window.
+ *              ns        Time per window, in nanoseconds.
+ */
+typedef struct _totals {
+    unsigned long dogwin;
+    unsigned long dogok;
+    unsigned long wrong;
+    unsigned long otherwin;
+    unsigned long otherok;
+    double relative;
+    double ns;
+} totals;
+
+/* The recordings being replayed. */
+static recording *recs = NULL;
+static unsigned int numrecs = 0;
+
+/* Number of enrolled dogs in the built-in set. */
+#define NUM_DOGS        2
+
+/* The barks from 'test-fft.c', which the keys in 'key.c' were made from; dog
+ * d + 1 barks 'barks[d]'. */
+static const char barks[NUM_DOGS][64] = {
+    {   97, 46,  0,  0,  0,  0, 44, 49, 13,  0, 20, 36, 23,  3,  0,  0,
+         5, 36,  8,  0,  0, 33, 58,  3,  0,  0,  3, 61, 67, 26,  0,  0,
+         0,  0, 26, 28, 15,  0,  0,  5, 18,  0,  0,  0,  3, 31,  8,  0,
+         0,  3, 56, 49,  0,  0,  0,  5, 51, 28,  8,  0,  0,  0,  3, 28 },
+    {   56, 85, 34,  0,  0, 29,102, 10,  1,  0,  2,111,  0,  0,  0,  0,
+       111,  1,  0,  0,  0,101, 11,  0,  0,  0, 84, 24,  0,  0,  0, 63,
+        35,  0,  0,  0, 43, 42,  0,  0,  0, 27, 44,  0,  0,  4, 16, 40,
+         0,  0, 12, 11, 33,  0,  0, 15, 10, 23,  0,  0, 15, 13, 14,  0 },
+};
+
+/* Names of the sets of each dog's recordings. */
+static const char *const dog_sets[NUM_DOGS] = { "dog 1", "dog 2" };
+
+
+/*
+ * now
+ *
+ * Description: Reads a monotonic clock for timing the matcher.
+ *
+ * Returns:     Returns the current time in nanoseconds.
+ */
+static unsigned long long now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * add_recording
+ *
+ * Description: Adds a recording to the list to replay. The recording takes
+ *              ownership of the samples.
+ *
+ * Arguments:   set      Name of the set to report it in.
+ *              dog      ID of the dog in it, or 'NO_DOG'.
+ *              samples  The samples, allocated with 'malloc'.
+ *              length   The number of samples.
+ */
+static void add_recording(const char *set, unsigned char dog, char *samples,
+                          unsigned long length)
+{
+    recs = (recording *)realloc(recs, (numrecs + 1) * sizeof(recording));
+    if (recs == NULL) {
+        perror("realloc");
+        exit(-1);
+    }
+
+    recs[numrecs].set = set;
+    recs[numrecs].dog = dog;
+    recs[numrecs].samples = samples;
+    recs[numrecs].length = length;
+    numrecs++;
+}
+
+/*
+ * enrolled
+ *
+ * Description: Checks whether the matcher that was built in has an entry for
+ *              a dog. The band and DTW matchers have tables of their own.
+ *
+ * Arguments:   dog  ID of the dog.
+ *
+ * Returns:     Returns nonzero if the dog is enrolled.
+ */
+static unsigned char enrolled(unsigned char dog)
+{
+    unsigned char i;
+
+#if defined(USE_DTW)
+    for (i = 0; i < num_dtw_templates; i++)
+    {
+        if (dtw_templates[i].id == dog) {
+            return 1;
+        }
+    }
+#elif defined(USE_BANDS)
+    for (i = 0; i < num_band_keys; i++)
+    {
+        if (band_keys[i].id == dog) {
+            return 1;
+        }
+    }
+#else
+    for (i = 0; i < num_keys; i++)
+    {
+        if (keys[i].id == dog) {
+            return 1;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * clip
+ *
+ * Description: Rounds a value to the nearest sample the ADC could give.
+ *
+ * Arguments:   x  The value to round.
+ *
+ * Returns:     Returns the value rounded and clipped to a signed char.
+ */
+static char clip(double x)
+{
+    x = floor(x + 0.5);
+    if (x > 127) {
+        return 127;
+    }
+    if (x < -128) {
+        return -128;
+    }
+
+    return (char)x;
+}
+
+/*
+ * make_corpus
+ *
+ * Description: Adds the built-in recordings. Every recording is one window
+ *              long (or, for the DTW matcher, the barks are 'BARK_LENGTH'
+ *              samples long), and loud enough to trip the trigger right away.
+ *              The noise comes from a fixed generator, so that every run is
+ *              the same.
+ */
+static void make_corpus(void)
+{
+    static const double gains[] = { 0.7, 0.85, 1.0, 1.15, 1.3 };
+    static const double hiss[] = { 0, 2, 4, 8, 16 };
+    static const double levels[] = { 32, 64, 127 };
+    unsigned long seed = 12345;
+    unsigned int g, h, f, d, s, i;
+    char *x;
+    double t, v;
+
+
+    /* The dogs the keys were made from, louder and softer, and with noise
+     * added. A dog that the matcher has no entry for counts as any other. */
+    for (d = 0; d < NUM_DOGS; d++)
+    {
+        for (g = 0; g < sizeof(gains) / sizeof(gains[0]); g++)
+        {
+            for (h = 0; h < sizeof(hiss) / sizeof(hiss[0]); h++)
+            {
+                x = (char *)calloc(BARK_LENGTH, 1);
+                for (i = 0; i < BARK_LENGTH; i++)
+                {
+                    seed = seed * 1103515245UL + 12345UL;
+                    v = ((double)((seed >> 16) & 0xFF) - 128) / 128;
+                    x[i] = clip(gains[g] * ((PULSE(i) < sizeof(barks[d])) ?
+                                            barks[d][PULSE(i)] : 0) +
+                                hiss[h] * v);
+                }
+                add_recording(dog_sets[d], enrolled(d + 1) ? d + 1 : NO_DOG,
+                              x, BARK_LENGTH);
+            }
+        }
+    }
+
+    /* Other dogs: decaying harmonic bursts at different pitches. Like the
+     * recorded bark, the bottom half of the wave is cut off. */
+    for (f = 2; f < 10; f++)
+    {
+        for (d = 2; d <= 8; d *= 2)
+        {
+            x = (char *)calloc(BARK_LENGTH, 1);
+            for (i = 0; i < BARK_LENGTH; i++)
+            {
+                if (PULSE(i) >= SAMPLE_SIZE) {
+                    continue;
+                }
+                t = (double)PULSE(i) / SAMPLE_SIZE;
+                v = 100 * exp(-d * t) * (sin(2 * M_PI * f * t)
+                    + 0.5 * sin(2 * M_PI * 2 * f * t)
+                    + 0.25 * sin(2 * M_PI * 3 * f * t));
+                x[i] = clip((v > 0) ? v : 0);
+            }
+            x[0] = TRIGGER_LEVEL;
+            add_recording("other dogs", NO_DOG, x, BARK_LENGTH);
+        }
+    }
+
+    /* The mailman: hiss at different levels. */
+    for (s = 0; s < sizeof(levels) / sizeof(levels[0]); s++)
+    {
+        for (i = 0; i < 8; i++)
+        {
+            x = (char *)malloc(SAMPLE_SIZE);
+            for (d = 0; d < SAMPLE_SIZE; d++)
+            {
+                seed = seed * 1103515245UL + 12345UL;
+                v = ((double)((seed >> 16) & 0xFF) - 128) / 128;
+                x[d] = clip(levels[s] * v);
+            }
+            x[0] = clip(levels[s]);
+            add_recording("mailman", NO_DOG, x, SAMPLE_SIZE);
+        }
+    }
+
+    /* Hum at different frequencies. */
+    for (f = 1; f < SAMPLE_SIZE / 2; f = 2 * f + 1)
+    {
+        x = (char *)malloc(SAMPLE_SIZE);
+        for (i = 0; i < SAMPLE_SIZE; i++)
+        {
+            x[i] = clip(100 * cos(2 * M_PI * f * i / SAMPLE_SIZE));
+        }
+        add_recording("mailman", NO_DOG, x, SAMPLE_SIZE);
+    }
+
+    /* Short bursts of noise, like a door or footsteps. */
+    for (s = 1; s <= 4; s++)
+    {
+        x = (char *)calloc(SAMPLE_SIZE, 1);
+        for (i = 0; i < s * SAMPLE_SIZE / 8; i++)
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            v = ((double)((seed >> 16) & 0xFF) - 128) / 128;
+            x[i] = clip(100 * v);
+        }
+        x[0] = 100;
+        add_recording("mailman", NO_DOG, x, SAMPLE_SIZE);
+    }
+}
+
+/*
+ * load_file
+ *
+ * Description: Reads a recording from a file. WAV files with 8 or 16-bit PCM
+ *              samples are converted to signed 8-bit samples, keeping only the
+ *              first channel; any other file is taken to be raw signed 8-bit
+ *              samples.
+ *
+ * Arguments:   path    Name of the file to read.
+ *              length  Filled in with the number of samples.
+ *
+ * Returns:     Returns the samples, allocated with 'malloc'. Exits on errors.
+ */
+static char *load_file(const char *path, unsigned long *length)
+{
+    FILE *f;
+    unsigned char *data;
+    char *x;
+    unsigned long n, pos, size, body = 0, bytes = 0, frame, i;
+    unsigned int fmt = 0, channels = 0, bits = 0;
+
+
+    /* Read in the whole file. */
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(-1);
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (unsigned char *)malloc(n + 1);
+    x = (char *)malloc(n + 1);
+    if (data == NULL || x == NULL || fread(data, 1, n, f) != n) {
+        perror(path);
+        exit(-1);
+    }
+    fclose(f);
+
+    /* Anything that is not a WAV file is raw samples. */
+    if (n < 12 || memcmp(data, "RIFF", 4) != 0 ||
+        memcmp(data + 8, "WAVE", 4) != 0) {
+        memcpy(x, data, n);
+        free(data);
+        *length = n;
+        return x;
+    }
+
+    /* Find the format and the samples. */
+    for (pos = 12; pos + 8 <= n; pos += 8 + size + (size & 1))
+    {
+        size = data[pos+4] | (data[pos+5] << 8) | ((unsigned long)data[pos+6]
+               << 16) | ((unsigned long)data[pos+7] << 24);
+
+        if (memcmp(data + pos, "fmt ", 4) == 0 && size >= 16) {
+            fmt = data[pos+8] | (data[pos+9] << 8);
+            channels = data[pos+10] | (data[pos+11] << 8);
+            bits = data[pos+22] | (data[pos+23] << 8);
+        }
+        else if (memcmp(data + pos, "data", 4) == 0) {
+            body = pos + 8;
+            bytes = (size < n - body) ? size : n - body;
+            break;
+        }
+    }
+
+    if (fmt != 1 || channels == 0 || (bits != 8 && bits != 16) || body == 0) {
+        fprintf(stderr, "%s: not an 8 or 16-bit PCM WAV file\n", path);
+        exit(-1);
+    }
+
+    /* Take the top 8 bits of the first channel of each frame. */
+    frame = channels * bits / 8;
+    for (i = 0; i < bytes / frame; i++)
+    {
+        if (bits == 8) {
+            x[i] = (int)data[body + i * frame] - 128;
+        }
+        else {
+            x[i] = (char)data[body + i * frame + 1];
+        }
+    }
+
+    free(data);
+    *length = bytes / frame;
+    return x;
+}
+
+
+#ifndef USE_DTW
+/*
+ * match_window
+ *
+ * Description: Runs one window through the matcher that the code was built
+ *              for, loading the samples the same way as the ADC interrupt.
+ *
+ * Arguments:   x  The 'SAMPLE_SIZE' samples of the window.
+ *
+ * Returns:     Returns the ID of the dog that matched, or 'NO_DOG'.
+ */
+static unsigned char match_window(const char *x)
+{
+    unsigned char dog = NO_DOG;
+    unsigned int i;
+#ifdef USE_BANDS
+    unsigned char levels[NUM_BANDS];
+#endif
+#if defined(USE_GOERTZEL)
+
+#ifdef USE_PREPROCESS
+    preprocess_start();
+#endif
+    goertzel_start();
+    for (i = 0; i < SAMPLE_SIZE; i++)
+    {
+        goertzel_update(SAMPLE8(x[i]));
+    }
+    goertzel_finish();
+    (void)goertzel_result(&dog);
+#elif defined(USE_Q15)
+    static complex_q15 buf[SAMPLE_SIZE];
+    unsigned char exponent;
+
+#ifdef USE_PREPROCESS
+    preprocess_start();
+#endif
+    for (i = 0; i < SAMPLE_SIZE; i++)
+    {
+        buf[i].real = SAMPLE16(x[i]);
+        buf[i].imag = 0;
+    }
+    exponent = fft_q15(buf);
+#ifdef USE_BANDS
+    band_levels_q15(buf, exponent, levels);
+    dog = band_search(levels);
+#else
+    dog = fft_match_q15(buf, exponent);
+#endif
+#else
+    static complex buf[SAMPLE_SIZE / 2];
+    unsigned char exponent;
+
+#ifdef USE_PREPROCESS
+    preprocess_start();
+#endif
+    for (i = 0; i < SAMPLE_SIZE / 2; i++)
+    {
+        buf[i].real = SAMPLE8(x[2*i]);
+        buf[i].imag = SAMPLE8(x[2*i + 1]);
+    }
+    exponent = rfft(buf);
+#ifdef USE_BANDS
+    band_levels(buf, exponent, levels);
+    dog = band_search(levels);
+#else
+    dog = fft_match(buf, exponent);
+#endif
+#endif
+
+    return dog;
+}
+#else
+/*
+ * match_stream
+ *
+ * Description: Streams a recording through the ring buffer the way the ADC
+ *              does in the ring buffer mode, and runs every window through the
+ *              DTW matcher as it finishes. The ring starts out silent, so the
+ *              first window is the one that is open when the recording starts;
+ *              the recording is then padded with silence until the last window
+ *              that starts inside it.
+ *
+ * Arguments:   rec    The recording to stream.
+ *              count  Incremented for each window that is matched.
+ *
+ * Returns:     Returns the ID of the first dog that matched, or 'NO_DOG'.
+ */
+static unsigned char match_stream(const recording *rec, unsigned long *count)
+{
+    static ring_sample ring[RING_SIZE];
+#ifdef USE_Q15
+    static complex_q15 buf[SAMPLE_SIZE];
+#else
+    static complex buf[SAMPLE_SIZE / 2];
+#endif
+    unsigned char levels[NUM_BANDS];
+    unsigned char exponent;
+    unsigned char dog = NO_DOG;
+    unsigned long pos;          /* Samples written to the ring. */
+
+
+    memset(ring, 0, sizeof(ring));
+#ifdef USE_PREPROCESS
+    preprocess_start();
+#endif
+    dtw_reset();
+
+    for (pos = 1; dog == NO_DOG && pos < rec->length + SAMPLE_SIZE; pos++)
+    {
+#ifdef USE_Q15
+        ring[(pos - 1) & (RING_SIZE - 1)] = (pos <= rec->length) ?
+            SAMPLE16(rec->samples[pos - 1]) : SAMPLE16(0);
+#else
+        ring[(pos - 1) & (RING_SIZE - 1)] = (pos <= rec->length) ?
+            SAMPLE8(rec->samples[pos - 1]) : SAMPLE8(0);
+#endif
+
+        /* A window finishes every 'HOP_SIZE' samples. */
+        if (pos % HOP_SIZE != 0) {
+            continue;
+        }
+
+#ifdef USE_Q15
+        exponent = fft_q15_ring(buf, ring, pos - SAMPLE_SIZE, RING_SIZE - 1);
+        band_levels_q15(buf, exponent, levels);
+#else
+        exponent = rfft_ring(buf, ring, pos - SAMPLE_SIZE, RING_SIZE - 1);
+        band_levels(buf, exponent, levels);
+#endif
+        dog = dtw_update(levels);
+        (*count)++;
+    }
+
+    return dog;
+}
+#endif
+
+
+/* Where the reference workload leaves its results, so that they are not
+ * optimized out. */
+static volatile long reference_sink;
+
+/*
+ * reference_pass
+ *
+ * Description: Times the reference workload: a plain DFT, in integers, of
+ *              'REF_WINDOWS' windows of noise. This does not depend on how
+ *              the matcher was built, so the time of a window relative to it
+ *              changes much less from host to host than the time itself.
+ *
+ * Returns:     Returns the time per reference window, in nanoseconds.
+ */
+static double reference_pass(void)
+{
+    static int cosine[SAMPLE_SIZE];
+    static char x[REF_WINDOWS][SAMPLE_SIZE];
+    unsigned long seed = 54321;
+    unsigned long long start;
+    long re, im, power;
+    unsigned int w, k, n;
+
+    for (n = 0; n < SAMPLE_SIZE; n++)
+    {
+        cosine[n] = (int)floor(127 * cos(2 * M_PI * n / SAMPLE_SIZE) + 0.5);
+    }
+    for (w = 0; w < REF_WINDOWS; w++)
+    {
+        for (n = 0; n < SAMPLE_SIZE; n++)
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            x[w][n] = (char)((seed >> 16) & 0xFF);
+        }
+    }
+
+    start = now();
+    for (w = 0; w < REF_WINDOWS; w++)
+    {
+        power = 0;
+        for (k = 0; k <= SAMPLE_SIZE / 2; k++)
+        {
+            re = 0;
+            im = 0;
+            for (n = 0; n < SAMPLE_SIZE; n++)
+            {
+                re += x[w][n] * cosine[(k * n) % SAMPLE_SIZE];
+                im += x[w][n] *
+                      cosine[(k * n + 3 * SAMPLE_SIZE / 4) % SAMPLE_SIZE];
+            }
+            power += (re >> 8) * (re >> 8) + (im >> 8) * (im >> 8);
+        }
+        reference_sink = power;
+    }
+
+    return (double)(now() - start) / REF_WINDOWS;
+}
+
+
+/*
+ * compare_doubles
+ *
+ * Description: Compares two doubles for 'qsort'.
+ *
+ * Arguments:   a  The first double.
+ *              b  The second double.
+ *
+ * Returns:     Returns less than, equal to, or greater than 0 if the first is
+ *              less than, equal to, or greater than the second.
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+/*
+ * read_baseline
+ *
+ * Description: Reads the results from a baseline file.
+ *
+ * Arguments:   path  Name of the baseline file.
+ *              base  Filled in with the results.
+ *
+ * Returns:     Returns 0 if all of the results were read, or -1 if not.
+ */
+static int read_baseline(const char *path, totals *base)
+{
+    FILE *f;
+    char name[32];
+    double value;
+    int found = 0;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    while (fscanf(f, "%31s %lf", name, &value) == 2)
+    {
+        if (strcmp(name, "dog_windows") == 0) {
+            base->dogwin = (unsigned long)value;
+            found |= 1;
+        }
+        else if (strcmp(name, "true_accepts") == 0) {
+            base->dogok = (unsigned long)value;
+            found |= 2;
+        }
+        else if (strcmp(name, "misidentified") == 0) {
+            base->wrong = (unsigned long)value;
+            found |= 4;
+        }
+        else if (strcmp(name, "other_windows") == 0) {
+            base->otherwin = (unsigned long)value;
+            found |= 8;
+        }
+        else if (strcmp(name, "false_accepts") == 0) {
+            base->otherok = (unsigned long)value;
+            found |= 16;
+        }
+        else if (strcmp(name, "relative_time") == 0) {
+            base->relative = value;
+            found |= 32;
+        }
+        else if (strcmp(name, "ns_per_window") == 0) {
+            base->ns = value;
+            found |= 64;
+        }
+    }
+    fclose(f);
+
+    if (found != 127) {
+        fprintf(stderr, "%s: missing results\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * main
+ *
+ * Description: Cuts the recordings into windows, replays them through the
+ *              matcher, and prints the results. The results can also be
+ *              written to or checked against a baseline.
+ *
+ * Returns:     Returns 0 on successful completion, 1 if the results are worse
+ *              than the baseline, or -1 if an error occurs.
+ */
+int main(int argc, char *argv[])
+{
+#ifndef USE_DTW
+    char (*windows)[SAMPLE_SIZE] = NULL;    /* Triggered windows. */
+#endif
+    unsigned int *owner = NULL;             /* Recording of each window. */
+    unsigned long numwin = 0;
+    unsigned char *result;                  /* Dog matched in each window. */
+    set_result sets[MAX_SETS];
+    unsigned int numsets = 0;
+    const char *check = NULL, *write = NULL;
+    totals res = { 0, 0, 0, 0, 0, 0, 0 }, base;
+    unsigned long long start, t, best = 0;
+    double ref, bestref = 0;
+    double ratio[PASSES];                   /* Relative time of each pass. */
+    unsigned long count = 0;                /* Windows matched in a pass. */
+    unsigned long pos, i;
+    unsigned int r, s, p;
+    int a;
+    double ta, fa;
+    int status = 0;
+    FILE *f;
+
+
+    /* Read the options, then the recordings. */
+    for (a = 1; a + 1 < argc && argv[a][0] == '-'; a += 2)
+    {
+        if (strcmp(argv[a], "-c") == 0) {
+            check = argv[a + 1];
+        }
+        else if (strcmp(argv[a], "-w") == 0) {
+            write = argv[a + 1];
+        }
+        else {
+            break;
+        }
+    }
+    if ((argc - a) % 2 != 0) {
+        fprintf(stderr,
+                "usage: %s [-c baseline | -w baseline] [id file]...\n",
+                argv[0]);
+        return -1;
+    }
+
+    if (a == argc) {
+        make_corpus();
+    }
+    for (; a < argc; a += 2)
+    {
+        char *x = load_file(argv[a + 1], &pos);
+
+        add_recording(argv[a + 1], atoi(argv[a]), x, pos);
+    }
+
+#ifdef USE_DTW
+    /* Each recording is streamed whole, and gives one result. */
+    owner = (unsigned int *)malloc(numrecs * sizeof(unsigned int));
+    if (owner == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    for (r = 0; r < numrecs; r++)
+    {
+        owner[r] = r;
+    }
+    numwin = numrecs;
+#else
+    /* Cut the recordings into windows where the trigger would fire. Windows
+     * that run off the end of a recording are padded with silence. */
+    for (r = 0; r < numrecs; r++)
+    {
+        for (pos = 0; pos < recs[r].length; pos++)
+        {
+            if (abs(recs[r].samples[pos]) < TRIGGER_LEVEL) {
+                continue;
+            }
+
+            windows = (char (*)[SAMPLE_SIZE])realloc(windows,
+                          (numwin + 1) * SAMPLE_SIZE);
+            owner = (unsigned int *)realloc(owner,
+                          (numwin + 1) * sizeof(unsigned int));
+            if (windows == NULL || owner == NULL) {
+                perror("realloc");
+                return -1;
+            }
+
+            for (i = 0; i < SAMPLE_SIZE; i++)
+            {
+                windows[numwin][i] = (pos < recs[r].length) ?
+                                     recs[r].samples[pos] : 0;
+                pos++;
+            }
+            owner[numwin] = r;
+            numwin++;
+            pos--;
+        }
+    }
+#endif
+
+    if (numwin == 0) {
+        fprintf(stderr, "nothing in the recordings trips the trigger\n");
+        return -1;
+    }
+    result = (unsigned char *)malloc(numwin);
+    if (result == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    /* Replay the windows, keeping the time of each pass relative to the
+     * reference workload, which is run after each pass so that both see the
+     * host in the same state. The median of these is the relative time; the
+     * fastest pass gives the time per window. */
+#ifdef USE_GOERTZEL
+    goertzel_init();
+#endif
+    for (p = 0; p < PASSES; p++)
+    {
+#ifdef USE_PREPROCESS
+        /* Every pass starts with no DC level, so they all see the same. */
+        preprocess_init();
+#endif
+        count = 0;
+        start = now();
+        for (i = 0; i < numwin; i++)
+        {
+#ifdef USE_DTW
+            result[i] = match_stream(&recs[i], &count);
+#else
+            result[i] = match_window(windows[i]);
+            count++;
+#endif
+        }
+        t = now() - start;
+
+        if (p == 0 || t < best) {
+            best = t;
+        }
+
+        ref = reference_pass();
+        if (p == 0 || ref < bestref) {
+            bestref = ref;
+        }
+        ratio[p] = (double)t / count / ref;
+    }
+
+    /* Tally up the results for each set, and over all of them. */
+    for (i = 0; i < numwin; i++)
+    {
+        const recording *rec = &recs[owner[i]];
+
+        for (s = 0; s < numsets && strcmp(sets[s].name, rec->set) != 0; s++)
+        {
+            /* Keep looking for the set. */
+        }
+        if (s == numsets && numsets < MAX_SETS) {
+            sets[s].name = rec->set;
+            sets[s].windows = 0;
+            sets[s].accepted = 0;
+            numsets++;
+        }
+        if (s < numsets) {
+            sets[s].windows++;
+            sets[s].accepted += (result[i] != NO_DOG);
+        }
+
+        if (rec->dog != NO_DOG) {
+            res.dogwin++;
+            res.dogok += (result[i] == rec->dog);
+            res.wrong += (result[i] != NO_DOG && result[i] != rec->dog);
+        }
+        else {
+            res.otherwin++;
+            res.otherok += (result[i] != NO_DOG);
+        }
+    }
+
+    ta = (res.dogwin != 0) ? (double)res.dogok / res.dogwin : 1;
+    fa = (res.otherwin != 0) ? (double)res.otherok / res.otherwin : 0;
+    res.ns = (double)best / count;
+    qsort(ratio, PASSES, sizeof(ratio[0]), compare_doubles);
+    res.relative = ratio[PASSES / 2];
+
+    /* Print out the results. */
+    printf("%d-point windows, %s matcher, %s datapath\n", SAMPLE_SIZE,
+#if defined(USE_GOERTZEL)
+           "goertzel",
+#elif defined(USE_DTW)
+           "dtw",
+#elif defined(USE_BANDS)
+           "bands",
+#else
+           "fft",
+#endif
+#ifdef USE_Q15
+           "q15"
+#else
+           "8-bit"
+#endif
+           );
+    printf("%-20s %8s %8s %8s\n", "set", "windows", "accepted", "rate");
+    for (s = 0; s < numsets; s++)
+    {
+        printf("%-20s %8lu %8lu %7.1f%%\n", sets[s].name, sets[s].windows,
+               sets[s].accepted, 100.0 * sets[s].accepted / sets[s].windows);
+    }
+    printf("true accept rate   %7.2f%% (%lu of %lu, %lu misidentified)\n",
+           100 * ta, res.dogok, res.dogwin, res.wrong);
+    printf("false accept rate  %7.2f%% (%lu of %lu)\n", 100 * fa, res.otherok,
+           res.otherwin);
+    printf("time per window    %7.0f ns (%.0f windows/s)\n", res.ns,
+           1e9 / res.ns);
+    printf("relative time      %7.3f (reference window %.0f ns)\n",
+           res.relative, bestref);
+
+    /* Save the results as the new baseline. */
+    if (write != NULL) {
+        f = fopen(write, "w");
+        if (f == NULL) {
+            perror(write);
+            return -1;
+        }
+        fprintf(f, "dog_windows %lu\ntrue_accepts %lu\nmisidentified %lu\n"
+                   "other_windows %lu\nfalse_accepts %lu\n"
+                   "relative_time %.4f\nns_per_window %.0f\n",
+                res.dogwin, res.dogok, res.wrong, res.otherwin, res.otherok,
+                res.relative, res.ns);
+        fclose(f);
+    }
+
+    /* Compare the results to the baseline. */
+    if (check != NULL) {
+        if (read_baseline(check, &base) != 0) {
+            return -1;
+        }
+
+        if (res.dogwin != base.dogwin || res.otherwin != base.otherwin) {
+            printf("FAIL: baseline is for %lu and %lu windows\n", base.dogwin,
+                   base.otherwin);
+            status = 1;
+        }
+        if (res.dogok < base.dogok) {
+            printf("FAIL: true accepts dropped from %lu\n", base.dogok);
+            status = 1;
+        }
+        if (res.wrong > base.wrong) {
+            printf("FAIL: misidentified windows rose from %lu\n", base.wrong);
+            status = 1;
+        }
+        if (res.otherok > base.otherok) {
+            printf("FAIL: false accepts rose from %lu\n", base.otherok);
+            status = 1;
+        }
+        if (res.relative > base.relative * SPEED_SLACK) {
+            printf("FAIL: relative time rose from %.3f\n", base.relative);
+            status = 1;
+        }
+        if (res.ns > base.ns * SPEED_SLACK) {
+            printf("warning: time per window rose from %.0f ns, which may "
+                   "just be the host\n", base.ns);
+        }
+        if (status == 0) {
+            printf("no regressions from %s\n", check);
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,180 @@
+/*
+ * roots.c
+ *
+ * Constants representing the roots of unity.
+ *
+ * This file contains arrays of the nth roots of unity, both as 8-bit and as
+ * Q15 complex numbers, along with the table of bit-reversed positions used to
+ * put the output of the FFT in order, and the window used by the front end
+ * (with 'USE_PREPROCESS'). The total number of roots is determined by the
+ * constant 'SAMPLE_SIZE', which should be defined in the 'data.h' header file
+ * (or at compile time in the Makefile). The arrays are stored in program
+ * memory, so they have to be read with the 'pgm_read_*' functions.
+ *
+ * The tables are worked out by the compiler, so that changing 'SAMPLE_SIZE'
+ * only needs a rebuild. The preprocessor writes out one entry for each
+ * position, with the bit-reversed order done by integer arithmetic, and GCC
+ * folds the calls to '__builtin_cos', '__builtin_sin', and '__builtin_round'
+ * on those constants into plain numbers. Any power of two from 4 to
+ * 'MAX_ROOTS' can be used.
+ *
+ * Revision History:
+ *      04 Jun 2015     Brian Kubisiak      Initial revision.
+ *      16 Oct 2026     agent               Added Q15 roots.
+ *      16 Oct 2026     agent               Moved the roots to program memory.
+ *      16 Oct 2026     agent               Worked out by the compiler instead
+ *                                          of genroots.py.
+ *      16 Oct 2026     agent               Added the bit-reversal table.
+ *      16 Oct 2026     agent               Added the window for the front end.
+ */
+
+
+#include "data.h"
+#include "progmem.h"
+
+
+/* Largest number of roots that the tables can be built with. */
+#define MAX_ROOTS   1024
+
+#if SAMPLE_SIZE < 4 || SAMPLE_SIZE > MAX_ROOTS || \
+    (SAMPLE_SIZE & (SAMPLE_SIZE - 1)) != 0
+#error "SAMPLE_SIZE must be a power of two from 4 to MAX_ROOTS"
+#endif
+
+#if (1 << LOG2_SAMPLE_SIZE) != SAMPLE_SIZE
+#error "LOG2_SAMPLE_SIZE does not match SAMPLE_SIZE"
+#endif
+
+#define PI          3.14159265358979323846
+
+/* Reverses the low 'bits' bits of 'x', by reversing all 16 bits and shifting
+ * the ones that are wanted back down. */
+#define REV1(x)     ((((x) & 0x5555U) << 1) | (((x) >> 1) & 0x5555U))
+#define REV2(x)     ((((x) & 0x3333U) << 2) | (((x) >> 2) & 0x3333U))
+#define REV4(x)     ((((x) & 0x0F0FU) << 4) | (((x) >> 4) & 0x0F0FU))
+#define REV8(x)     ((((x) & 0x00FFU) << 8) | (((x) >> 8) & 0x00FFU))
+#define BITREV(x, bits) (REV8(REV4(REV2(REV1(x)))) >> (16 - (bits)))
+
+/* Power of the first root that goes at position 'p'. The first half of the
+ * table is in bit-reversed order, and the second half holds the negatives of
+ * the first half in the same order. */
+#define HALF        (SAMPLE_SIZE / 2)
+#define POWER(p)    (BITREV((unsigned)(p) % HALF, LOG2_SAMPLE_SIZE - 1) + \
+                     (unsigned)(p) / HALF * HALF)
+#define ANGLE(p)    (2 * PI * POWER(p) / SAMPLE_SIZE)
+
+/* A root scaled up to fit a part with the given largest value, rounded to the
+ * nearest integer. */
+#define ROOT(p, max)    { \
+        .real = __builtin_round((max) * __builtin_cos(ANGLE(p))), \
+        .imag = __builtin_round((max) * __builtin_sin(ANGLE(p))) }
+
+/* The position 'p' reversed over all of the bits of a 'SAMPLE_SIZE' index. */
+#define REVERSED(p, unused)     BITREV((unsigned)(p), LOG2_SAMPLE_SIZE)
+
+/* The weight of a window at position 'p', scaled up to 255. A Hamming window
+ * is a Hann window raised up off of zero at the ends. */
+#ifdef PREPROCESS_HAMMING
+#define WINDOW(p, unused)   __builtin_round(255 * (0.54 - 0.46 * \
+                                __builtin_cos(2 * PI * (p) / SAMPLE_SIZE)))
+#else
+#define WINDOW(p, unused)   __builtin_round(255 * (0.5 - 0.5 * \
+                                __builtin_cos(2 * PI * (p) / SAMPLE_SIZE)))
+#endif
+
+/* Writes out the entry 'f(p, x)' for position 'p' and the positions after
+ * it. */
+#define TABLE2(f, p, x)     f(p, x), f((p) + 1, x)
+#define TABLE4(f, p, x)     TABLE2(f, p, x), TABLE2(f, (p) + 2, x)
+#define TABLE8(f, p, x)     TABLE4(f, p, x), TABLE4(f, (p) + 4, x)
+#define TABLE16(f, p, x)    TABLE8(f, p, x), TABLE8(f, (p) + 8, x)
+#define TABLE32(f, p, x)    TABLE16(f, p, x), TABLE16(f, (p) + 16, x)
+#define TABLE64(f, p, x)    TABLE32(f, p, x), TABLE32(f, (p) + 32, x)
+#define TABLE128(f, p, x)   TABLE64(f, p, x), TABLE64(f, (p) + 64, x)
+#define TABLE256(f, p, x)   TABLE128(f, p, x), TABLE128(f, (p) + 128, x)
+#define TABLE512(f, p, x)   TABLE256(f, p, x), TABLE256(f, (p) + 256, x)
+#define TABLE1024(f, p, x)  TABLE512(f, p, x), TABLE512(f, (p) + 512, x)
+
+/* Writes out a whole table of 'SAMPLE_SIZE' entries. */
+#if SAMPLE_SIZE == 4
+#define TABLE(f, x)         TABLE4(f, 0, x)
+#elif SAMPLE_SIZE == 8
+#define TABLE(f, x)         TABLE8(f, 0, x)
+#elif SAMPLE_SIZE == 16
+#define TABLE(f, x)         TABLE16(f, 0, x)
+#elif SAMPLE_SIZE == 32
+#define TABLE(f, x)         TABLE32(f, 0, x)
+#elif SAMPLE_SIZE == 64
+#define TABLE(f, x)         TABLE64(f, 0, x)
+#elif SAMPLE_SIZE == 128
+#define TABLE(f, x)         TABLE128(f, 0, x)
+#elif SAMPLE_SIZE == 256
+#define TABLE(f, x)         TABLE256(f, 0, x)
+#elif SAMPLE_SIZE == 512
+#define TABLE(f, x)         TABLE512(f, 0, x)
+#else
+#define TABLE(f, x)         TABLE1024(f, 0, x)
+#endif
+
+
+/*
+ * root
+ *
+ * Description: This array contains the nth roots of unity for calculating the
+ *              FFT. The roots in this array contain an 8-bit real part and an
+ *              8-bit imaginary part. The roots are organized in a modified
+ *              bit-reversed order in order to make the accesses easier.
+ *
+ * Notes:       Due to the ordering of the roots, if the ith root is at
+ *              'root[j]', then its negative is at 'root[j + SAMPLE_SIZE/2]'.
+ */
+const complex root[SAMPLE_SIZE] PROGMEM = {
+    TABLE(ROOT, 127)
+};
+
+
+/*
+ * root_q15
+ *
+ * Description: This array contains the same roots of unity as 'root', in the
+ *              same order, but with each part stored as a Q15 fraction for the
+ *              16-bit FFT.
+ */
+const complex_q15 root_q15[SAMPLE_SIZE] PROGMEM = {
+    TABLE(ROOT, 32767)
+};
+
+
+/*
+ * bitrev
+ *
+ * Description: This array holds each 'SAMPLE_SIZE' index with its bits
+ *              reversed. Point i of the output of an FFT belongs at position
+ *              'bitrev[i]', so this is the table of pairs to swap to put the
+ *              output in natural order.
+ *
+ * Notes:       Reversing 2i over all of the bits is the same as reversing i
+ *              over one bit less, so the even entries serve for the half-size
+ *              transform in 'rfft'.
+ */
+const bitrev_index bitrev[SAMPLE_SIZE] PROGMEM = {
+    TABLE(REVERSED, 0)
+};
+
+
+#ifdef USE_PREPROCESS
+/*
+ * window
+ *
+ * Description: This array holds the weights that the front end multiplies a
+ *              recording by, from 0 to 255. It is a Hann window, or a Hamming
+ *              window if built with 'PREPROCESS_HAMMING'.
+ *
+ * Notes:       The window is periodic rather than symmetric: the weight that
+ *              would come after the last one is the same as the first. This is
+ *              the one that leaks the least in an FFT of 'SAMPLE_SIZE' points.
+ */
+const unsigned char window[SAMPLE_SIZE] PROGMEM = {
+    TABLE(WINDOW, 0)
+};
+#endif
@@ -0,0 +1,272 @@
+/*
+ * sram-plan.c
+ *
+ * Plan of the SRAM used by the board build.
+ *
+ * This file contains a host-side tool that adds up the SRAM that the dog bowl
+ * needs on the board, for the window size and options that it was built with
+ * (the same 'OPTIONS' as the board build). Every variable in SRAM is listed,
+ * module by module, sized the way avr-gcc lays it out (16-bit ints and
+ * pointers, no padding): the buffers that grow with the window, the small
+ * variables, and the strings and constants that are not in program memory.
+ * The stack is added on top of that, as the arrays in the frame of 'main', the
+ * frames of the deepest chain of calls under it, and the frame of an interrupt
+ * (they do not nest). The plan is printed, and the program fails if it does
+ * not fit in the SRAM of the ATmega2560, so that the board build stops before
+ * it makes an image that would run its stack into its buffers.
+ *
+ * The roots of unity, the table of bit-reversed positions, the window, the
+ * table of logs, and the keys are all in program memory, so none of them are
+ * in the plan.
+ *
+ * Once the image is linked, the board build runs this again with '-s' and the
+ * size of the '.data' and '.bss' sections from 'avr-size'. That size replaces
+ * the variables in the plan, and the program fails if it is more than the plan
+ * has, since then the plan is missing something. The stack frames are only
+ * estimates; the trace (see 'trace_dump') reports the deepest the stack has
+ * really gone on the board, to check them by.
+ *
+ * Usage:
+ *      sram-plan [-s bytes]
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               List every variable and the stack,
+ *                                          and check against the linked image.
+ *      16 Oct 2026     agent               16-bit ring and front end for Q15.
+ *      16 Oct 2026     agent               16-bit key thresholds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adc.h"
+#include "bands.h"
+#include "data.h"
+#include "dtw.h"
+#include "events.h"
+#include "goertzel.h"
+#include "key.h"
+#include "trace.h"
+
+
+/* SRAM of the ATmega2560. */
+#define SRAM_SIZE       8192
+
+/* Sizes of the types that are different on the board. */
+#define AVR_INT         2
+#define AVR_LONG        4
+#define AVR_POINTER     2
+
+/* An enrolled dog, with its 16-bit threshold. */
+#define AVR_ENROLLED_KEY    (1 + AVR_INT + (KEY_BINS + 1) / 2 + \
+                             (KEY_BINS + 1) / 2 + 1)
+
+/* Proximity sensors, as in 'proximity.c'. */
+#define NUM_SENSORS     4
+
+/* Stack used by a call on the board: the 3-byte return address of the
+ * ATmega2560, and the call-saved registers (r2 to r17, r28, and r29) that a
+ * function with a lot of work to do pushes. */
+#define CALL_FRAME      (3 + 18)
+
+/* Calls under 'main' in the deepest chain: the matcher, the FFT (or the
+ * enrolling code), a pass of the FFT, and a helper such as 'ilog10'. */
+#define CALL_DEPTH      4
+
+/* Locals of a function in that chain that do not fit in registers. The biggest
+ * is the key being made when enrolling, which is added on its own. */
+#define CALL_LOCALS     8
+
+/* Stack used by an interrupt: the return address, SREG, r0, r1, RAMPZ, EIND,
+ * and the 12 registers that a called function may change, then the frames of
+ * the two calls it makes ('adc_sample_ready', then the front end or the
+ * Goertzel update). */
+#define ISR_FRAME       (3 + 5 + 12 + 2 * (CALL_FRAME + CALL_LOCALS))
+
+/* Locals of 'main' besides its arrays. */
+#define MAIN_LOCALS     16
+
+/* Most entries in the plan. */
+#define MAX_ENTRIES     40
+
+
+/*
+ * entry
+ *
+ * Description: Data type for one variable, or part of the stack, in the plan.
+ *
+ * Members:     name   What the entry is, and where it is.
+ *              bytes  The size of the entry on the board.
+ *              stack  Nonzero if the entry is on the stack.
+ */
+typedef struct _entry {
+    const char *name;
+    unsigned long bytes;
+    unsigned char stack;
+} entry;
+
+static entry plan[MAX_ENTRIES];
+static unsigned int numentries = 0;
+
+
+/*
+ * add_entry
+ *
+ * Description: Adds a variable, or part of the stack, to the plan.
+ *
+ * Arguments:   name   What the entry is, and where it is.
+ *              bytes  The size of the entry on the board.
+ *              stack  Nonzero if the entry is on the stack.
+ */
+static void add_entry(const char *name, unsigned long bytes,
+                      unsigned char stack)
+{
+    if (numentries < MAX_ENTRIES) {
+        plan[numentries].name = name;
+        plan[numentries].bytes = bytes;
+        plan[numentries].stack = stack;
+        numentries++;
+    }
+    else {
+        fprintf(stderr, "too many entries in the plan\n");
+        exit(-1);
+    }
+}
+
+
+/*
+ * main
+ *
+ * Description: Adds up the plan for the options that this was built with and
+ *              prints it out, checking it against the size of the variables
+ *              in the linked image if that is given.
+ *
+ * Returns:     Returns 0 if the plan fits in SRAM, 1 if it does not or if the
+ *              image has more variables than the plan, or -1 if the arguments
+ *              are wrong.
+ */
+int main(int argc, char *argv[])
+{
+    unsigned long statics = 0, stack = 0, total;
+    long measured = -1;             /* Size of the variables in the image. */
+    unsigned int i;
+    int status = 0;
+
+
+    if (argc == 3 && strcmp(argv[1], "-s") == 0) {
+        measured = atol(argv[2]);
+    }
+    else if (argc != 1) {
+        fprintf(stderr, "usage: %s [-s bytes]\n", argv[0]);
+        return -1;
+    }
+
+    /* The samples, as the ADC records them, and the ADC's bookkeeping. */
+#ifdef ADC_STREAM
+    add_entry("adc.c: ring", RING_SIZE * sizeof(ring_sample), 0);
+    add_entry("adc.c: windows", NUM_WINDOWS * AVR_INT + 3 * AVR_INT + 3, 0);
+    add_entry("mainloop.c: work", SAMPLE_POINTS * sizeof(sample), 0);
+#else
+    add_entry("adc.c: databuf", NUM_BUFFERS * SAMPLE_POINTS * sizeof(sample),
+              0);
+    add_entry("adc.c: buffers", NUM_BUFFERS + AVR_INT + 3, 0);
+#endif
+    add_entry("adc.c: overruns", AVR_INT, 0);
+#ifdef USE_PREPROCESS
+#ifdef ADC_STREAM
+    add_entry("preprocess.c: dc, last", AVR_INT + AVR_LONG, 0);
+#else
+    add_entry("preprocess.c: dc, last, pos", 2 * AVR_INT + AVR_LONG, 0);
+#endif
+#endif
+
+    /* What the matcher works on. */
+#if defined(USE_GOERTZEL)
+    add_entry("goertzel.c: state",
+              GOERTZEL_BINS * (2 * AVR_INT + 4 * AVR_LONG) + 1, 0);
+    add_entry("goertzel.c: dist (init)", KEY_BINS * AVR_INT, 1);
+#elif defined(USE_BANDS)
+    add_entry("mainloop.c: levels", NUM_BANDS, 1);
+#else
+    add_entry("mainloop.c: logs", KEY_BINS, 1);
+#endif
+#ifdef USE_DTW
+    add_entry("dtw.c: cost, start, now",
+              2 * num_dtw_templates * DTW_MAX_FRAMES * AVR_INT + AVR_INT, 0);
+#endif
+
+    /* The number of entries in each table, which are plain constants. */
+    add_entry("key.c, bands.c, dtw.c: counts", 3, 0);
+
+    /* Dogs enrolled on the board, and the messages sent back. */
+#ifdef USE_ENROLL
+    add_entry("key.c: enrolled", ENROLL_SLOTS * AVR_ENROLLED_KEY, 0);
+    add_entry("enroll.c: sum, sumsq", 2 * KEY_BINS * AVR_INT, 0);
+    add_entry("enroll.c: state", 4 + AVR_INT, 0);
+    add_entry("enroll.c: strings",
+              sizeof("enroll ") + sizeof("\r\n") + sizeof("bark ") +
+              sizeof(" of ") + sizeof("enrolled ") + sizeof(" threshold ") +
+              sizeof("no room for "), 0);
+    add_entry("enroll.c: key being made", AVR_ENROLLED_KEY, 1);
+#endif
+
+    /* The rest of the modules. */
+    add_entry("events.c: queue", EVENT_QUEUE_SIZE + 2 + AVR_INT, 0);
+    add_entry("proximity.c: sensors", NUM_SENSORS + 2 + AVR_INT, 0);
+#ifdef ADC_TIMER
+    add_entry("hal_avr.c: oversum", AVR_INT + 1, 0);
+#endif
+    add_entry("hal_avr.c: EEPROM write", AVR_POINTER + 2 * AVR_INT, 0);
+
+#ifdef USE_TRACE
+    add_entry("trace.c: trace_ring", TRACE_SIZE * (AVR_INT + 1) + 1, 0);
+    add_entry("trace.c: trace_dump", AVR_INT + 1, 0);
+    add_entry("trace.c: hex", sizeof("0123456789abcdef"), 0);
+#endif
+
+    /* The stack. */
+    add_entry("mainloop.c: main", MAIN_LOCALS + CALL_FRAME, 1);
+    add_entry("calls under main", CALL_DEPTH * (CALL_FRAME + CALL_LOCALS), 1);
+    add_entry("interrupt", ISR_FRAME, 1);
+
+    /* Print out the plan. */
+    printf("SRAM plan for %d-point windows\n", SAMPLE_SIZE);
+    for (i = 0; i < numentries; i++)
+    {
+        printf("  %-32s %6lu%s\n", plan[i].name, plan[i].bytes,
+               plan[i].stack ? " (stack)" : "");
+        if (plan[i].stack) {
+            stack += plan[i].bytes;
+        }
+        else {
+            statics += plan[i].bytes;
+        }
+    }
+    printf("  %-32s %6lu\n", "variables", statics);
+    printf("  %-32s %6lu\n", "stack", stack);
+
+    /* The image knows best how big the variables are. */
+    if (measured >= 0) {
+        printf("  %-32s %6ld\n", "variables in the image", measured);
+        if ((unsigned long)measured > statics) {
+            printf("FAIL: the image has %lu bytes of variables that are not "
+                   "in the plan\n", measured - statics);
+            status = 1;
+        }
+        statics = measured;
+    }
+
+    total = statics + stack;
+    printf("  %-32s %6lu of %d (%lu%%)\n", "total", total, SRAM_SIZE,
+           100 * total / SRAM_SIZE);
+
+    if (total > SRAM_SIZE) {
+        printf("FAIL: over by %lu bytes; use a smaller window, fewer "
+               "buffers, or the 8-bit datapath\n", total - SRAM_SIZE);
+        status = 1;
+    }
+
+    return status;
+}
@@ -0,0 +1,1283 @@
+/*
+ * test-butterfly.c
+ *
+ * This file contains a differential test of the assembly radix-4 kernel in
+ * 'fft_avr.S' against the C kernel 'fft_clusters4' in 'fft.c', which is the
+ * reference. The build host cannot run AVR code, so the test includes a small
+ * simulator of the ATmega2560: it reads the assembly source itself (expanding
+ * its macros), and runs it instruction by instruction on a model of the
+ * registers, the flags, the SRAM, and the flash with the table of roots in it.
+ *
+ * Random blocks of points, within the block floating point limit of a radix-4
+ * pass, are run through both kernels for every size and stride that the FFT
+ * uses. The test checks that every output point and the peak are identical,
+ * that the kernel follows the avr-gcc calling convention (the call-saved
+ * registers and the stack pointer are restored, and r1 is zero), and that
+ * nothing outside the block was written. It also prints the number of clocks
+ * the kernel takes on the largest block. Any mismatches are printed to stdout,
+ * and the program exits with a nonzero status if there were any.
+ *
+ * Only the instructions that the kernel uses are simulated, and only the C and
+ * Z flags, since those are the only ones it reads (in the branches, and in the
+ * adds, subtracts, and shifts with carry). Anything else in the source is an
+ * error, so the kernel cannot quietly grow past the simulator. Before the
+ * kernel is run, each of those instructions is checked on its own against the
+ * results and flags given for it in the AVR instruction set manual, with the
+ * edge cases that the kernel relies on (the shift and carry of 'FMULS', the
+ * zero flag carried through 'SBC' and 'SBCI', 'NEG' of -128, and unsigned
+ * compares), so that the simulator is not only checked against itself.
+ *
+ * The simulator does not show that the source assembles; 'make check' also
+ * runs it through avr-gcc when that is installed.
+ *
+ * Usage:
+ *      test-butterfly [fft_avr.S]
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Only simulate what the kernel
+ *                                          uses, and test each instruction.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "data.h"
+#include "fft.h"
+#include "progmem.h"
+
+
+/* The roots of unity, from 'roots.c'. */
+extern const complex root[SAMPLE_SIZE] PROGMEM;
+
+/* Number of random blocks for each size and stride. */
+#define TRIALS          200
+
+/* Largest magnitude of the input to a radix-4 pass ('BFP_LIMIT4' in
+ * 'fft.c'). */
+#define INPUT_LIMIT     21
+
+/* Memory of the simulated ATmega2560. */
+#define SRAM_START      0x0200
+#define SRAM_END        0x2200
+#define STACK_TOP       (SRAM_END - 1)
+#define STACK_BYTES     64          /* Kept out of the check for stray
+                                     * writes. */
+#define DATA_ADDR       0x0400      /* Where the block is put. */
+#define ROOT_ADDR       0x10F0      /* Where 'root' is put in flash; the low
+                                     * byte carries as the roots are indexed. */
+#define FLASH_SIZE      (ROOT_ADDR + sizeof(root))
+#define FILL            0xA5        /* Everything else in SRAM. */
+
+/* Limits on the assembly source. */
+#define MAX_LINE        256
+#define MAX_INSNS       1024
+#define MAX_LABELS      256
+#define MAX_MACROS      8
+#define MAX_MACRO_LINES 32
+#define MAX_PARAMS      4
+#define MAX_STEPS       10000000L   /* Gives up on a kernel that never
+                                     * returns. */
+
+/* Entry point of the kernel. */
+#define ENTRY           "fft_clusters4_avr"
+
+/* Where a branch goes in the instruction tests. */
+#define BRANCHED        100
+
+
+/* The simulated instructions. */
+enum opcode {
+    OP_ADC, OP_ADD, OP_ADIW, OP_BREQ, OP_BRSH, OP_CLR, OP_CP, OP_DEC,
+    OP_FMULS, OP_LD, OP_LDD, OP_LDI, OP_LPM, OP_LSL, OP_LSR, OP_MOV, OP_MOVW,
+    OP_NEG, OP_POP, OP_PUSH, OP_RET, OP_RJMP, OP_ROL, OP_ROR, OP_SBC, OP_SBCI,
+    OP_SBRC, OP_ST, OP_STD, OP_SUB, OP_SUBI, NUM_OPS
+};
+
+static const char *const mnemonics[NUM_OPS] = {
+    "adc", "add", "adiw", "breq", "brsh", "clr", "cp", "dec",
+    "fmuls", "ld", "ldd", "ldi", "lpm", "lsl", "lsr", "mov", "movw",
+    "neg", "pop", "push", "ret", "rjmp", "rol", "ror", "sbc", "sbci",
+    "sbrc", "st", "std", "sub", "subi"
+};
+
+/* How a pointer register is used by a load or store. */
+enum ptrmode {
+    PTR_PLAIN, PTR_POSTINC, PTR_PREDEC, PTR_DISP
+};
+
+
+/*
+ * insn
+ *
+ * Description: Data type for one instruction of the assembled kernel.
+ *
+ * Members:     op      The instruction.
+ *              rd      The first register operand, or the pointer register
+ *                      (26, 28, or 30) of a store.
+ *              rr      The second register operand, or the pointer register of
+ *                      a load.
+ *              k       The immediate operand, or the displacement.
+ *              mode    How the pointer register is used.
+ *              target  The label of a branch, until it is resolved.
+ *              dest    The index of the instruction a branch goes to.
+ *              line    The line of the source it came from.
+ */
+typedef struct _insn {
+    enum opcode op;
+    int rd, rr, k;
+    enum ptrmode mode;
+    char target[32];
+    int dest;
+    int line;
+} insn;
+
+/*
+ * label
+ *
+ * Description: Data type for a label in the assembled kernel.
+ *
+ * Members:     name   The name of the label, or its number for a local label.
+ *              index  The index of the instruction that follows it.
+ */
+typedef struct _label {
+    char name[32];
+    int index;
+} label;
+
+/*
+ * macro
+ *
+ * Description: Data type for a '.macro' in the source.
+ *
+ * Members:     name     The name of the macro.
+ *              params   The names of its parameters.
+ *              nparams  The number of parameters.
+ *              body     The lines of the macro.
+ *              nlines   The number of lines.
+ */
+typedef struct _macro {
+    char name[32];
+    char params[MAX_PARAMS][16];
+    int nparams;
+    char body[MAX_MACRO_LINES][MAX_LINE];
+    int nlines;
+} macro;
+
+static insn insns[MAX_INSNS];
+static int numinsns = 0;
+static label labels[MAX_LABELS];
+static int numlabels = 0;
+static macro macros[MAX_MACROS];
+static int nummacros = 0;
+
+/* State of the simulated processor. */
+static unsigned char reg[32];
+static unsigned char sram[SRAM_END];
+static unsigned char flash[FLASH_SIZE];
+static unsigned int sp;
+static int flag_c, flag_z;
+static unsigned long cycles;
+
+/* File and line of the source being assembled, for errors. */
+static const char *srcpath;
+static int srcline;
+
+
+/*
+ * fail
+ *
+ * Description: Reports an error in the source or in running it, and exits.
+ *
+ * Arguments:   what  What went wrong.
+ *              line  The line of the source, or 0 if there is none.
+ */
+static void fail(const char *what, int line)
+{
+    if (line > 0) {
+        printf("%s:%d: %s\n", srcpath, line, what);
+    }
+    else {
+        printf("%s\n", what);
+    }
+    exit(1);
+}
+
+
+/*
+ * trim
+ *
+ * Description: Strips the white space from both ends of a string, in place.
+ *
+ * Arguments:   s  The string.
+ *
+ * Returns:     Returns the first character that is not white space.
+ */
+static char *trim(char *s)
+{
+    char *end;
+
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+
+    return s;
+}
+
+
+/*
+ * parse_reg
+ *
+ * Description: Parses a register operand, 'r0' to 'r31'.
+ *
+ * Arguments:   s  The operand.
+ *
+ * Returns:     Returns the number of the register.
+ */
+static int parse_reg(const char *s)
+{
+    char *end;
+    long n;
+
+    if (s[0] != 'r') {
+        fail("expected a register", srcline);
+    }
+    n = strtol(s + 1, &end, 10);
+    if (*end != '\0' || end == s + 1 || n < 0 || n > 31) {
+        fail("bad register", srcline);
+    }
+
+    return (int)n;
+}
+
+
+/*
+ * parse_imm
+ *
+ * Description: Parses an immediate operand: a number, or the low or high byte
+ *              of the address of 'root' in flash.
+ *
+ * Arguments:   s  The operand.
+ *
+ * Returns:     Returns the value of the operand.
+ */
+static int parse_imm(const char *s)
+{
+    char *end;
+    long n;
+
+    if (strcmp(s, "lo8(root)") == 0) {
+        return ROOT_ADDR & 0xFF;
+    }
+    if (strcmp(s, "hi8(root)") == 0) {
+        return ROOT_ADDR >> 8;
+    }
+    n = strtol(s, &end, 0);
+    if (*end != '\0' || end == s) {
+        fail("bad immediate", srcline);
+    }
+
+    return (int)n;
+}
+
+
+/*
+ * parse_ptr
+ *
+ * Description: Parses the pointer operand of a load or store: 'X', 'X+', '-X',
+ *              or 'Y+q', and the same for Y and Z.
+ *
+ * Arguments:   s   The operand.
+ *              in  The instruction to fill in the mode and displacement of.
+ *
+ * Returns:     Returns the number of the low register of the pointer.
+ */
+static int parse_ptr(const char *s, insn *in)
+{
+    int base;
+
+    in->mode = PTR_PLAIN;
+    in->k = 0;
+    if (*s == '-') {
+        in->mode = PTR_PREDEC;
+        s++;
+    }
+    switch (*s)
+    {
+    case 'X':   base = 26;  break;
+    case 'Y':   base = 28;  break;
+    case 'Z':   base = 30;  break;
+    default:    fail("expected X, Y, or Z", srcline);  return 0;
+    }
+    s++;
+    if (*s == '+') {
+        if (in->mode == PTR_PREDEC) {
+            fail("bad pointer", srcline);
+        }
+        if (s[1] == '\0') {
+            in->mode = PTR_POSTINC;
+        }
+        else {
+            in->mode = PTR_DISP;
+            in->k = parse_imm(s + 1);
+        }
+    }
+    else if (*s != '\0') {
+        fail("bad pointer", srcline);
+    }
+
+    return base;
+}
+
+
+/*
+ * add_label
+ *
+ * Description: Adds a label at the next instruction.
+ *
+ * Arguments:   name  The name of the label.
+ */
+static void add_label(const char *name)
+{
+    if (numlabels >= MAX_LABELS || strlen(name) >= sizeof(labels[0].name)) {
+        fail("too many labels", srcline);
+    }
+    strcpy(labels[numlabels].name, name);
+    labels[numlabels].index = numinsns;
+    numlabels++;
+}
+
+
+static void assemble_line(char *line);
+
+/*
+ * expand_macro
+ *
+ * Description: Assembles the lines of a macro, with its parameters replaced
+ *              by the arguments.
+ *
+ * Arguments:   m     The macro.
+ *              args  The arguments, separated by commas.
+ */
+static void expand_macro(const macro *m, char *args)
+{
+    char *arg[MAX_PARAMS];
+    char text[MAX_LINE];
+    char *a;
+    int nargs = 0;
+    int i, p;
+
+
+    for (a = strtok(args, ","); a != NULL; a = strtok(NULL, ","))
+    {
+        if (nargs >= MAX_PARAMS) {
+            fail("too many macro arguments", srcline);
+        }
+        arg[nargs++] = trim(a);
+    }
+    if (nargs != m->nparams) {
+        fail("wrong number of macro arguments", srcline);
+    }
+
+    for (i = 0; i < m->nlines; i++)
+    {
+        const char *s = m->body[i];
+        char *out = text;
+
+        /* Replace each '\param' with its argument. */
+        while (*s != '\0' && out < text + MAX_LINE - 16)
+        {
+            if (*s == '\\') {
+                for (p = 0; p < m->nparams; p++)
+                {
+                    size_t len = strlen(m->params[p]);
+
+                    if (strncmp(s + 1, m->params[p], len) == 0 &&
+                        !isalnum((unsigned char)s[1 + len])) {
+                        out += sprintf(out, "%s", arg[p]);
+                        s += 1 + len;
+                        break;
+                    }
+                }
+                if (p == m->nparams) {
+                    fail("unknown macro parameter", srcline);
+                }
+            }
+            else {
+                *out++ = *s++;
+            }
+        }
+        *out = '\0';
+        assemble_line(text);
+    }
+}
+
+
+/*
+ * assemble_line
+ *
+ * Description: Assembles one line of source, after the comments are gone.
+ *              Directives are skipped, labels are noted, and macros are
+ *              expanded.
+ *
+ * Arguments:   line  The line; it is changed in place.
+ */
+static void assemble_line(char *line)
+{
+    char *s = trim(line);
+    char *mnemonic, *ops, *op1, *op2;
+    insn *in;
+    int i;
+
+    /* Labels, which may be followed by an instruction. */
+    for (i = 0; s[i] != '\0' && !isspace((unsigned char)s[i]); i++)
+    {
+        if (s[i] == ':') {
+            s[i] = '\0';
+            add_label(s);
+            s = trim(s + i + 1);
+            break;
+        }
+    }
+    if (*s == '\0' || *s == '.') {
+        return;
+    }
+
+    mnemonic = s;
+    while (*s != '\0' && !isspace((unsigned char)*s)) {
+        s++;
+    }
+    if (*s != '\0') {
+        *s++ = '\0';
+    }
+    ops = trim(s);
+
+    for (i = 0; i < nummacros; i++)
+    {
+        if (strcmp(mnemonic, macros[i].name) == 0) {
+            expand_macro(&macros[i], ops);
+            return;
+        }
+    }
+
+    if (numinsns >= MAX_INSNS) {
+        fail("too many instructions", srcline);
+    }
+    in = &insns[numinsns];
+    memset(in, 0, sizeof(*in));
+    in->line = srcline;
+    for (i = 0; i < NUM_OPS; i++)
+    {
+        if (strcmp(mnemonic, mnemonics[i]) == 0) {
+            break;
+        }
+    }
+    if (i == NUM_OPS) {
+        fail("instruction is not simulated", srcline);
+    }
+    in->op = (enum opcode)i;
+
+    op1 = ops;
+    op2 = strchr(ops, ',');
+    if (op2 != NULL) {
+        *op2++ = '\0';
+        op2 = trim(op2);
+    }
+    op1 = trim(op1);
+
+    switch (in->op)
+    {
+    case OP_RET:
+        break;
+    case OP_BREQ: case OP_BRSH: case OP_RJMP:
+        if (strlen(op1) >= sizeof(in->target)) {
+            fail("bad label", srcline);
+        }
+        strcpy(in->target, op1);
+        break;
+    case OP_CLR: case OP_DEC: case OP_LSL: case OP_LSR: case OP_NEG:
+    case OP_POP: case OP_PUSH: case OP_ROL: case OP_ROR:
+        in->rd = parse_reg(op1);
+        break;
+    case OP_LDI: case OP_SUBI: case OP_SBCI:
+        in->rd = parse_reg(op1);
+        in->k = parse_imm(op2 != NULL ? op2 : "");
+        if (in->rd < 16) {
+            fail("immediate needs r16 to r31", srcline);
+        }
+        break;
+    case OP_ADIW:
+        in->rd = parse_reg(op1);
+        in->k = parse_imm(op2 != NULL ? op2 : "");
+        if (in->rd < 24 || (in->rd & 1) || in->k < 0 || in->k > 63) {
+            fail("bad adiw", srcline);
+        }
+        break;
+    case OP_SBRC:
+        in->rd = parse_reg(op1);
+        in->k = parse_imm(op2 != NULL ? op2 : "");
+        break;
+    case OP_LD: case OP_LDD: case OP_LPM:
+        in->rd = parse_reg(op1);
+        in->rr = parse_ptr(op2 != NULL ? op2 : "", in);
+        if ((in->op == OP_LDD) != (in->mode == PTR_DISP) ||
+            (in->mode == PTR_DISP && (in->rr == 26 || in->k > 63)) ||
+            (in->op == OP_LPM && (in->rr != 30 || in->mode == PTR_PREDEC))) {
+            fail("bad load", srcline);
+        }
+        break;
+    case OP_ST: case OP_STD:
+        in->rd = parse_ptr(op1, in);
+        in->rr = parse_reg(op2 != NULL ? op2 : "");
+        if ((in->op == OP_STD) != (in->mode == PTR_DISP) ||
+            (in->mode == PTR_DISP && (in->rd == 26 || in->k > 63))) {
+            fail("bad store", srcline);
+        }
+        break;
+    default:
+        in->rd = parse_reg(op1);
+        in->rr = parse_reg(op2 != NULL ? op2 : "");
+        if (in->op == OP_FMULS && (in->rd < 16 || in->rd > 23 ||
+                                   in->rr < 16 || in->rr > 23)) {
+            fail("fmuls needs r16 to r23", srcline);
+        }
+        if (in->op == OP_MOVW && ((in->rd | in->rr) & 1)) {
+            fail("movw needs even registers", srcline);
+        }
+        break;
+    }
+
+    numinsns++;
+}
+
+
+/*
+ * find_label
+ *
+ * Description: Finds where a branch goes. Local labels are numbers, and are
+ *              referred to as 'Nf' for the next one or 'Nb' for the last one.
+ *
+ * Arguments:   name   The target of the branch.
+ *              from   The index of the branch.
+ *
+ * Returns:     Returns the index of the instruction at the label.
+ */
+static int find_label(const char *name, int from)
+{
+    char local[32];
+    size_t len = strlen(name);
+    int found = -1;
+    int i;
+
+    if (len > 1 && isdigit((unsigned char)name[0]) &&
+        (name[len - 1] == 'f' || name[len - 1] == 'b')) {
+        strcpy(local, name);
+        local[len - 1] = '\0';
+        for (i = 0; i < numlabels; i++)
+        {
+            if (strcmp(labels[i].name, local) != 0) {
+                continue;
+            }
+            if (name[len - 1] == 'f' && labels[i].index > from) {
+                return labels[i].index;
+            }
+            if (name[len - 1] == 'b' && labels[i].index <= from) {
+                found = labels[i].index;
+            }
+        }
+        return found;
+    }
+
+    for (i = 0; i < numlabels; i++)
+    {
+        if (strcmp(labels[i].name, name) == 0) {
+            return labels[i].index;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ * assemble
+ *
+ * Description: Reads the assembly source, strips the comments, collects the
+ *              macros, assembles everything else, and resolves the branches.
+ *
+ * Arguments:   path  The file with the source.
+ */
+static void assemble(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE];
+    macro *m = NULL;
+    int incomment = 0;
+    int i;
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+
+    srcpath = path;
+    srcline = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char *s, *c;
+
+        srcline++;
+
+        /* Block comments, which can run over several lines. */
+        for (s = line; *s != '\0'; )
+        {
+            if (incomment) {
+                c = strstr(s, "*/");
+                memset(s, ' ', (c != NULL) ? (size_t)(c + 2 - s) : strlen(s));
+                if (c != NULL) {
+                    incomment = 0;
+                }
+                s = (c != NULL) ? c + 2 : s + strlen(s);
+            }
+            else if ((c = strstr(s, "/*")) != NULL) {
+                incomment = 1;
+                s = c;
+            }
+            else {
+                break;
+            }
+        }
+        if ((c = strchr(line, ';')) != NULL) {
+            *c = '\0';
+        }
+        s = trim(line);
+
+        if (strncmp(s, ".macro", 6) == 0) {
+            char *p;
+
+            if (nummacros >= MAX_MACROS) {
+                fail("too many macros", srcline);
+            }
+            m = &macros[nummacros++];
+            memset(m, 0, sizeof(*m));
+            p = strtok(s + 6, " \t,");
+            if (p == NULL) {
+                fail("macro has no name", srcline);
+            }
+            snprintf(m->name, sizeof(m->name), "%s", p);
+            while ((p = strtok(NULL, " \t,")) != NULL &&
+                   m->nparams < MAX_PARAMS)
+            {
+                snprintf(m->params[m->nparams++], sizeof(m->params[0]),
+                         "%s", p);
+            }
+        }
+        else if (strncmp(s, ".endm", 5) == 0) {
+            m = NULL;
+        }
+        else if (m != NULL) {
+            if (m->nlines >= MAX_MACRO_LINES) {
+                fail("macro is too long", srcline);
+            }
+            strcpy(m->body[m->nlines++], s);
+        }
+        else {
+            assemble_line(s);
+        }
+    }
+    fclose(f);
+
+    for (i = 0; i < numinsns; i++)
+    {
+        if (insns[i].target[0] != '\0') {
+            insns[i].dest = find_label(insns[i].target, i);
+            if (insns[i].dest < 0) {
+                fail("branch to an unknown label", insns[i].line);
+            }
+        }
+    }
+}
+
+
+/*
+ * mem_addr
+ *
+ * Description: Checks that a load or store is in SRAM.
+ *
+ * Arguments:   addr  The address.
+ *              line  The line of the source doing it.
+ *
+ * Returns:     Returns the address.
+ */
+static unsigned int mem_addr(unsigned int addr, int line)
+{
+    if (addr < SRAM_START || addr >= SRAM_END) {
+        fail("access outside of SRAM", line);
+    }
+
+    return addr;
+}
+
+
+/*
+ * pointer
+ *
+ * Description: Works out the address of a load or store, updating the pointer
+ *              register for a post-increment or pre-decrement.
+ *
+ * Arguments:   in  The load or store.
+ *              p   The low register of the pointer.
+ *
+ * Returns:     Returns the address.
+ */
+static unsigned int pointer(const insn *in, int p)
+{
+    unsigned int addr = reg[p] | (reg[p + 1] << 8);
+    unsigned int next = addr;
+
+    if (in->mode == PTR_PREDEC) {
+        addr = next = (addr - 1) & 0xFFFF;
+    }
+    else if (in->mode == PTR_POSTINC) {
+        next = (addr + 1) & 0xFFFF;
+    }
+    else if (in->mode == PTR_DISP) {
+        addr = (addr + in->k) & 0xFFFF;
+    }
+    reg[p] = next & 0xFF;
+    reg[p + 1] = next >> 8;
+
+    return addr;
+}
+
+
+/*
+ * arith
+ *
+ * Description: Adds or subtracts two bytes with the carry, setting the flags.
+ *
+ * Arguments:   a       The first operand.
+ *              b       The second operand.
+ *              carry   The carry (or borrow) in.
+ *              sub     Nonzero to subtract 'b' from 'a'.
+ *              keep_z  Nonzero if Z can only be cleared, as for 'sbc'.
+ *
+ * Returns:     Returns the result.
+ */
+static unsigned char arith(unsigned char a, unsigned char b, int carry, int sub,
+                           int keep_z)
+{
+    unsigned int r = sub ? (unsigned int)a - b - carry
+                         : (unsigned int)a + b + carry;
+    unsigned char res = r & 0xFF;
+
+    flag_c = (r > 0xFF);
+    flag_z = keep_z ? (flag_z && res == 0) : (res == 0);
+
+    return res;
+}
+
+
+/*
+ * step
+ *
+ * Description: Runs one instruction of the kernel.
+ *
+ * Arguments:   pc  The index of the instruction.
+ *
+ * Returns:     Returns the index of the next instruction, or -1 after 'RET'.
+ */
+static int step(int pc)
+{
+    const insn *in = &insns[pc];
+    int next = pc + 1;
+    int r;
+
+    cycles++;
+
+    switch (in->op)
+    {
+    case OP_ADC:
+        reg[in->rd] = arith(reg[in->rd], reg[in->rr], flag_c, 0, 0);
+        break;
+    case OP_ADD:
+        reg[in->rd] = arith(reg[in->rd], reg[in->rr], 0, 0, 0);
+        break;
+    case OP_ADIW:
+        r = (reg[in->rd] | (reg[in->rd + 1] << 8)) + in->k;
+        flag_c = (r > 0xFFFF);
+        flag_z = ((r & 0xFFFF) == 0);
+        reg[in->rd] = r & 0xFF;
+        reg[in->rd + 1] = (r >> 8) & 0xFF;
+        cycles++;
+        break;
+    case OP_BREQ: case OP_BRSH:
+        if ((in->op == OP_BREQ && flag_z) || (in->op == OP_BRSH && !flag_c)) {
+            next = in->dest;
+            cycles++;
+        }
+        break;
+    case OP_CLR:
+        reg[in->rd] = 0;
+        flag_z = 1;
+        break;
+    case OP_CP:
+        arith(reg[in->rd], reg[in->rr], 0, 1, 0);
+        break;
+    case OP_DEC:
+        reg[in->rd]--;
+        flag_z = (reg[in->rd] == 0);
+        break;
+    case OP_FMULS:
+        r = (signed char)reg[in->rd] * (signed char)reg[in->rr];
+        flag_c = (r >> 15) & 1;
+        r = (r << 1) & 0xFFFF;
+        flag_z = (r == 0);
+        reg[0] = r & 0xFF;
+        reg[1] = r >> 8;
+        cycles++;
+        break;
+    case OP_LD: case OP_LDD:
+        reg[in->rd] = sram[mem_addr(pointer(in, in->rr), in->line)];
+        cycles += (in->mode == PTR_PREDEC) ? 2 : 1;
+        break;
+    case OP_LDI:
+        reg[in->rd] = in->k & 0xFF;
+        break;
+    case OP_LPM:
+        r = pointer(in, in->rr);
+        if (r >= (int)FLASH_SIZE) {
+            fail("read outside of the simulated flash", in->line);
+        }
+        reg[in->rd] = flash[r];
+        cycles += 2;
+        break;
+    case OP_LSL:
+        reg[in->rd] = arith(reg[in->rd], reg[in->rd], 0, 0, 0);
+        break;
+    case OP_LSR: case OP_ROR:
+        r = reg[in->rd];
+        reg[in->rd] = (r >> 1) | ((in->op == OP_ROR && flag_c) ? 0x80 : 0);
+        flag_c = r & 1;
+        flag_z = (reg[in->rd] == 0);
+        break;
+    case OP_MOV:
+        reg[in->rd] = reg[in->rr];
+        break;
+    case OP_MOVW:
+        reg[in->rd] = reg[in->rr];
+        reg[in->rd + 1] = reg[in->rr + 1];
+        break;
+    case OP_NEG:
+        reg[in->rd] = arith(0, reg[in->rd], 0, 1, 0);
+        break;
+    case OP_POP:
+        sp++;
+        reg[in->rd] = sram[mem_addr(sp, in->line)];
+        cycles++;
+        break;
+    case OP_PUSH:
+        sram[mem_addr(sp, in->line)] = reg[in->rd];
+        sp--;
+        cycles++;
+        break;
+    case OP_RET:
+        sp += 3;
+        cycles += 4;
+        next = -1;
+        break;
+    case OP_RJMP:
+        next = in->dest;
+        cycles++;
+        break;
+    case OP_ROL:
+        reg[in->rd] = arith(reg[in->rd], reg[in->rd], flag_c, 0, 0);
+        break;
+    case OP_SBC:
+        reg[in->rd] = arith(reg[in->rd], reg[in->rr], flag_c, 1, 1);
+        break;
+    case OP_SBCI:
+        reg[in->rd] = arith(reg[in->rd], in->k & 0xFF, flag_c, 1, 1);
+        break;
+    case OP_SBRC:
+        if (!(reg[in->rd] & (1 << in->k))) {
+            next = pc + 2;
+            cycles++;
+        }
+        break;
+    case OP_ST: case OP_STD:
+        sram[mem_addr(pointer(in, in->rd), in->line)] = reg[in->rr];
+        cycles++;
+        break;
+    case OP_SUB:
+        reg[in->rd] = arith(reg[in->rd], reg[in->rr], 0, 1, 0);
+        break;
+    case OP_SUBI:
+        reg[in->rd] = arith(reg[in->rd], in->k & 0xFF, 0, 1, 0);
+        break;
+    default:
+        fail("instruction is not simulated", in->line);
+        break;
+    }
+
+    return next;
+}
+
+
+/*
+ * run
+ *
+ * Description: Runs the kernel from its entry point until it returns, as if it
+ *              were called with 'CALL' (which pushes three bytes of return
+ *              address on the ATmega2560).
+ */
+static void run(void)
+{
+    int pc = find_label(ENTRY, 0);
+    unsigned int base = sp;
+    long steps;
+
+    if (pc < 0) {
+        fail("no " ENTRY " in the source", 0);
+    }
+    sp -= 3;
+    cycles = 0;
+
+    for (steps = 0; steps < MAX_STEPS; steps++)
+    {
+        if (pc >= numinsns) {
+            fail("ran off the end of the kernel", 0);
+        }
+        pc = step(pc);
+        if (pc < 0) {
+            if (sp != base) {
+                fail("returned with the stack out of balance", 0);
+            }
+            return;
+        }
+    }
+
+    fail("the kernel did not return", 0);
+}
+
+
+/*
+ * unit
+ *
+ * Description: Data type for a test of one instruction. The operands 'a' and
+ *              'b' are put in r22 and r23, and also in r24 and r25 for 'ADIW'.
+ *
+ * Members:     text  The instruction, as it would be in the source.
+ *              a     The value put in r22 and r24.
+ *              b     The value put in r23 and r25.
+ *              c, z  The flags before the instruction.
+ *              out   The register with the result.
+ *              wide  Nonzero if the result is the pair at 'out'.
+ *              want  The result.
+ *              wc    C after the instruction.
+ *              wz    Z after the instruction.
+ *              next  Where it goes next: 1 for the next instruction, 2 if it
+ *                    skips one, or 'BRANCHED' if it branches.
+ */
+typedef struct _unit {
+    const char *text;
+    unsigned char a, b;
+    unsigned char c, z;
+    unsigned char out, wide;
+    unsigned int want;
+    unsigned char wc, wz;
+    int next;
+} unit;
+
+/* The results and flags of each instruction, from the AVR instruction set
+ * manual. */
+static const unit units[] = {
+    /* FMULS: r1:r0 is the product shifted left, and C is bit 15 of the
+     * product before the shift. -1 * -1 overflows to -1. */
+    { "fmuls r22, r23", 0x40, 0x40, 0, 0,  0, 1, 0x2000, 0, 0, 1 },
+    { "fmuls r22, r23", 0x40, 0xC0, 0, 0,  0, 1, 0xE000, 1, 0, 1 },
+    { "fmuls r22, r23", 0x80, 0x7F, 0, 0,  0, 1, 0x8100, 1, 0, 1 },
+    { "fmuls r22, r23", 0x80, 0x80, 0, 1,  0, 1, 0x8000, 0, 0, 1 },
+    { "fmuls r22, r23", 0x00, 0x80, 1, 0,  0, 1, 0x0000, 0, 1, 1 },
+    /* ADD and ADC: C is the carry out of bit 7. */
+    { "add r22, r23",   0xFF, 0x01, 0, 0, 22, 0, 0x00,   1, 1, 1 },
+    { "add r22, r23",   0x7F, 0x01, 1, 1, 22, 0, 0x80,   0, 0, 1 },
+    { "adc r22, r23",   0x00, 0x00, 1, 1, 22, 0, 0x01,   0, 0, 1 },
+    { "adc r22, r23",   0xFF, 0x00, 1, 0, 22, 0, 0x00,   1, 1, 1 },
+    /* SUB and SUBI: C is set if the second operand is bigger, unsigned. */
+    { "sub r22, r23",   0x01, 0x02, 0, 1, 22, 0, 0xFF,   1, 0, 1 },
+    { "sub r22, r23",   0x05, 0x05, 1, 0, 22, 0, 0x00,   0, 1, 1 },
+    { "subi r22, 0x80", 0x00, 0x00, 0, 0, 22, 0, 0x80,   1, 0, 1 },
+    { "subi r22, 0x80", 0x90, 0x00, 1, 0, 22, 0, 0x10,   0, 0, 1 },
+    /* SBC and SBCI: Z is only cleared, never set, so that it holds for the
+     * whole multi-byte result. */
+    { "sbc r22, r23",   0x00, 0x00, 0, 1, 22, 0, 0x00,   0, 1, 1 },
+    { "sbc r22, r23",   0x00, 0x00, 0, 0, 22, 0, 0x00,   0, 0, 1 },
+    { "sbc r22, r23",   0x00, 0x00, 1, 1, 22, 0, 0xFF,   1, 0, 1 },
+    { "sbc r22, r23",   0x05, 0x04, 1, 1, 22, 0, 0x00,   0, 1, 1 },
+    { "sbci r23, 0xFF", 0x00, 0xFF, 0, 1, 23, 0, 0x00,   0, 1, 1 },
+    { "sbci r23, 0xFF", 0x00, 0xFF, 0, 0, 23, 0, 0x00,   0, 0, 1 },
+    { "sbci r23, 0xFF", 0x00, 0x12, 0, 1, 23, 0, 0x13,   1, 0, 1 },
+    { "sbci r23, 0xFF", 0x00, 0x12, 1, 1, 23, 0, 0x12,   1, 0, 1 },
+    /* NEG: -128 stays -128, and C is set unless the result is 0. */
+    { "neg r22",        0x80, 0x00, 0, 1, 22, 0, 0x80,   1, 0, 1 },
+    { "neg r22",        0x01, 0x00, 0, 1, 22, 0, 0xFF,   1, 0, 1 },
+    { "neg r22",        0x00, 0x00, 1, 0, 22, 0, 0x00,   0, 1, 1 },
+    /* CP leaves its operands alone, and BRSH is an unsigned compare. */
+    { "cp r22, r23",    0x05, 0x03, 1, 1, 22, 0, 0x05,   0, 0, 1 },
+    { "cp r22, r23",    0x03, 0x05, 0, 1, 22, 0, 0x03,   1, 0, 1 },
+    { "cp r22, r23",    0x80, 0x7F, 1, 1, 22, 0, 0x80,   0, 0, 1 },
+    { "cp r22, r23",    0x7F, 0x7F, 1, 0, 22, 0, 0x7F,   0, 1, 1 },
+    { "brsh 1f",        0x00, 0x00, 0, 0, 22, 0, 0x00,   0, 0, BRANCHED },
+    { "brsh 1f",        0x00, 0x00, 1, 1, 22, 0, 0x00,   1, 1, 1 },
+    { "breq 1f",        0x00, 0x00, 1, 1, 22, 0, 0x00,   1, 1, BRANCHED },
+    { "breq 1f",        0x00, 0x00, 0, 0, 22, 0, 0x00,   0, 0, 1 },
+    /* ADIW: C is the carry out of bit 15, and Z is for all 16 bits. */
+    { "adiw r24, 2",    0xFF, 0x00, 1, 1, 24, 1, 0x0101, 0, 0, 1 },
+    { "adiw r24, 2",    0xFF, 0xFF, 0, 0, 24, 1, 0x0001, 1, 0, 1 },
+    { "adiw r24, 2",    0xFE, 0xFF, 0, 0, 24, 1, 0x0000, 1, 1, 1 },
+    /* Shifts: C gets the bit shifted out, and ROR and ROL shift C in. */
+    { "lsr r22",        0x01, 0x00, 0, 0, 22, 0, 0x00,   1, 1, 1 },
+    { "lsr r22",        0x80, 0x00, 1, 1, 22, 0, 0x40,   0, 0, 1 },
+    { "ror r22",        0x02, 0x00, 1, 1, 22, 0, 0x81,   0, 0, 1 },
+    { "ror r22",        0x01, 0x00, 0, 0, 22, 0, 0x00,   1, 1, 1 },
+    { "lsl r22",        0x80, 0x00, 0, 0, 22, 0, 0x00,   1, 1, 1 },
+    { "rol r22",        0x00, 0x00, 1, 1, 22, 0, 0x01,   0, 0, 1 },
+    /* DEC and CLR leave C alone. */
+    { "dec r22",        0x01, 0x00, 1, 0, 22, 0, 0x00,   1, 1, 1 },
+    { "dec r22",        0x00, 0x00, 0, 1, 22, 0, 0xFF,   0, 0, 1 },
+    { "clr r22",        0x5A, 0x00, 1, 0, 22, 0, 0x00,   1, 1, 1 },
+    /* SBRC skips the next instruction if the bit is clear. */
+    { "sbrc r22, 7",    0x80, 0x00, 0, 0, 22, 0, 0x80,   0, 0, 1 },
+    { "sbrc r22, 7",    0x7F, 0x00, 1, 1, 22, 0, 0x7F,   1, 1, 2 },
+    /* Moves do not touch the flags. */
+    { "mov r22, r23",   0x00, 0x80, 1, 0, 22, 0, 0x80,   1, 0, 1 },
+    { "movw r24, r22",  0x34, 0x12, 0, 1, 24, 1, 0x1234, 0, 1, 1 },
+    { "ldi r22, 0xA5",  0x00, 0x00, 0, 1, 22, 0, 0xA5,   0, 1, 1 },
+};
+
+
+/*
+ * test_instructions
+ *
+ * Description: Runs each instruction test in 'units' on its own, with junk in
+ *              the other registers, and checks the result, the flags, and
+ *              where it went next.
+ *
+ * Returns:     Returns the number of tests that failed.
+ */
+static unsigned long test_instructions(void)
+{
+    char line[MAX_LINE];
+    unsigned long errors = 0;
+    unsigned int i, got;
+    int r, next;
+
+    srcpath = "test";
+    for (i = 0; i < sizeof(units) / sizeof(units[0]); i++)
+    {
+        const unit *u = &units[i];
+
+        for (r = 0; r < 32; r++)
+        {
+            reg[r] = rand();
+        }
+        reg[22] = reg[24] = u->a;
+        reg[23] = reg[25] = u->b;
+        flag_c = u->c;
+        flag_z = u->z;
+
+        /* Assemble it as the only instruction, with its label after it. */
+        numinsns = 0;
+        strcpy(line, u->text);
+        assemble_line(line);
+        insns[0].dest = BRANCHED;
+        next = step(0);
+        numinsns = 0;
+
+        got = reg[u->out];
+        if (u->wide) {
+            got |= reg[u->out + 1] << 8;
+        }
+        if (got != u->want || flag_c != u->wc || flag_z != u->wz ||
+            next != u->next) {
+            printf("%s with %02X, %02X, C %d, Z %d: got %X, C %d, Z %d, "
+                   "next %d; want %X, C %d, Z %d, next %d\n", u->text, u->a,
+                   u->b, u->c, u->z, got, flag_c, flag_z, next, u->want,
+                   u->wc, u->wz, u->next);
+            errors++;
+        }
+    }
+
+    printf("%u instructions: %lu failed\n", i, errors);
+
+    return errors;
+}
+
+
+/*
+ * random_part
+ *
+ * Description: Picks a random part of an input point, within the limit for a
+ *              radix-4 pass. The limits themselves come up more often than
+ *              the rest, since they are where overflow would show.
+ *
+ * Returns:     Returns the part.
+ */
+static char random_part(void)
+{
+    switch (rand() % 8)
+    {
+    case 0:     return INPUT_LIMIT;
+    case 1:     return -INPUT_LIMIT;
+    default:    return rand() % (2 * INPUT_LIMIT + 1) - INPUT_LIMIT;
+    }
+}
+
+
+/*
+ * check
+ *
+ * Description: Runs one random block through both kernels and compares them.
+ *
+ * Arguments:   n       The number of points in the block.
+ *              stride  The stride of the radix-4 pass.
+ *
+ * Returns:     Returns the number of mismatches.
+ */
+static unsigned long check(unsigned int n, unsigned int stride)
+{
+    static complex data[SAMPLE_SIZE];
+    unsigned char saved[32];
+    unsigned char clusters = n / (2 * stride) - 1;
+    unsigned char peak = rand() % (INPUT_LIMIT + 1);
+    unsigned char want;
+    unsigned int addr = DATA_ADDR + 4 * stride;
+    unsigned long errors = 0;
+    unsigned int i;
+
+    /* The same block in the simulated SRAM and on the host. */
+    memset(sram, FILL, sizeof(sram));
+    for (i = 0; i < n; i++)
+    {
+        data[i].real = random_part();
+        data[i].imag = random_part();
+        sram[DATA_ADDR + 2*i] = data[i].real;
+        sram[DATA_ADDR + 2*i + 1] = data[i].imag;
+    }
+
+    /* Call it the way avr-gcc would, with junk in every other register. */
+    for (i = 0; i < 32; i++)
+    {
+        reg[i] = rand();
+    }
+    reg[1] = 0;
+    reg[24] = addr & 0xFF;
+    reg[25] = addr >> 8;
+    reg[22] = clusters;
+    reg[20] = stride & 0xFF;
+    reg[21] = stride >> 8;
+    reg[18] = peak;
+    memcpy(saved, reg, sizeof(saved));
+    sp = STACK_TOP;
+
+    run();
+    want = fft_clusters4(data + 2 * stride, clusters, stride, peak);
+
+    for (i = 0; i < n; i++)
+    {
+        if ((char)sram[DATA_ADDR + 2*i] != data[i].real ||
+            (char)sram[DATA_ADDR + 2*i + 1] != data[i].imag) {
+            printf("n = %u, stride %u, point %u: got %d%+di, want %d%+di\n",
+                   n, stride, i, (signed char)sram[DATA_ADDR + 2*i],
+                   (signed char)sram[DATA_ADDR + 2*i + 1], data[i].real,
+                   data[i].imag);
+            errors++;
+        }
+    }
+    if (reg[24] != want) {
+        printf("n = %u, stride %u: got peak %u, want %u\n", n, stride,
+               reg[24], want);
+        errors++;
+    }
+
+    /* The calling convention, and stray writes. */
+    for (i = 2; i < 32; i++)
+    {
+        if ((i <= 17 || i == 28 || i == 29) && reg[i] != saved[i]) {
+            printf("n = %u, stride %u: r%u was not restored\n", n, stride, i);
+            errors++;
+        }
+    }
+    if (reg[1] != 0 || sp != STACK_TOP) {
+        printf("n = %u, stride %u: r1 or SP is wrong on return\n", n, stride);
+        errors++;
+    }
+    for (i = SRAM_START; i < SRAM_END - STACK_BYTES; i++)
+    {
+        if ((i < DATA_ADDR || i >= DATA_ADDR + 2*n) && sram[i] != FILL) {
+            printf("n = %u, stride %u: wrote outside the block at 0x%04X\n",
+                   n, stride, i);
+            errors++;
+            break;
+        }
+    }
+
+    return errors;
+}
+
+
+/*
+ * main
+ *
+ * Description: Assembles the kernel, then checks it against the C kernel on
+ *              random blocks of every size up to 'SAMPLE_SIZE', at every
+ *              stride that leaves a cluster after the first. The clocks for
+ *              the largest block are printed at each stride.
+ *
+ * Arguments:   argc  The number of arguments.
+ *              argv  The path of the assembly source, if not 'fft_avr.S'.
+ *
+ * Returns:     Returns 0 if every output matched, 1 otherwise.
+ */
+int main(int argc, char *argv[])
+{
+    unsigned long errors = 0;
+    unsigned long blocks = 0;
+    unsigned int n, stride;
+    int t;
+
+    srand(1);
+    errors += test_instructions();
+
+    assemble((argc > 1) ? argv[1] : "fft_avr.S");
+    memcpy(flash + ROOT_ADDR, root, sizeof(root));
+
+    for (n = 8; n <= SAMPLE_SIZE; n *= 2)
+    {
+        for (stride = 2; 4 * stride <= n; stride *= 2)
+        {
+            for (t = 0; t < TRIALS; t++)
+            {
+                errors += check(n, stride);
+                blocks++;
+            }
+
+            if (n == SAMPLE_SIZE) {
+                printf("%u points, stride %u: %lu clocks, %.1f per butterfly\n",
+                       n, stride, cycles,
+                       (double)cycles / (n - 2 * stride));
+            }
+        }
+    }
+
+    printf("%lu blocks: %lu mismatches\n", blocks, errors);
+
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+ * test-enroll.c
+ *
+ * This file contains a test of enrolling a dog on the board at a window size
+ * where there are no built-in keys. It is built with 'USE_ENROLL' at 1024
+ * points, where a key has 513 bins, so a good threshold is far more than 8
+ * bits. A dog is enrolled from 'ENROLL_BARKS' noisy barks, each run through
+ * 'rfft' and 'fft_logs' as on the board, by sending the 'e<id>' command to
+ * 'enroll_rx' and handing the logs to 'enroll_add'. The test then checks
+ * that the threshold needed more than 8 bits, that new barks of the same dog
+ * match the key, and that they still match after the key is read back from
+ * the EEPROM. The
+ * hardware used by the enrolling code is stubbed out: the UART prints to
+ * stdout, and the EEPROM is an array. Any failures are printed to stdout, and
+ * the program exits with a nonzero status if there were any.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "data.h"
+#include "enroll.h"
+#include "events.h"
+#include "fft.h"
+#include "hal.h"
+#include "key.h"
+
+
+/* ID of the dog that is enrolled. */
+#define TEST_DOG        7
+
+/* Pitch of the dog's bark, in bins, and the number of harmonics in it,
+ * including the fundamental. */
+#define BARK_F0         37.0
+#define HARMONICS       6
+
+/* Number of new barks to match. */
+#define TRIALS          100
+
+/* Size of the stubbed EEPROM. */
+#define EEPROM_SIZE     4096
+
+/* Largest sample of a bark, and of the noise added to it. */
+#define BARK_AMP        90.0
+#define NOISE_AMP       6.0
+
+
+/* The stubbed EEPROM, which starts out erased. */
+static unsigned char eeprom[EEPROM_SIZE];
+
+/* State of the random number generator. */
+static unsigned long seed = 1;
+
+
+/* Stubs for the hardware used by 'enroll.c' and 'key.c'. */
+void hal_uart_init(void)
+{
+}
+
+void hal_uart_putc(char c)
+{
+    if (c != '\r') {
+        putchar(c);
+    }
+}
+
+unsigned char hal_irq_save(void)
+{
+    return 0;
+}
+
+void hal_irq_restore(unsigned char state)
+{
+    (void)state;
+}
+
+void hal_eeprom_read(unsigned int addr, void *data, unsigned int len)
+{
+    memcpy(data, &eeprom[addr], len);
+}
+
+void hal_eeprom_write(unsigned int addr, const void *data, unsigned int len)
+{
+    memcpy(&eeprom[addr], data, len);
+}
+
+unsigned char hal_eeprom_busy(void)
+{
+    return 0;
+}
+
+void event_post(unsigned char ev)
+{
+    (void)ev;
+}
+
+
+/*
+ * uniform
+ *
+ * Description: Gets a random number, with its own generator so that the test
+ *              is the same on every host.
+ *
+ * Returns:     Returns a number from -1 to 1.
+ */
+static double uniform(void)
+{
+    seed = (1103515245UL * seed + 12345UL) & 0x7FFFFFFFUL;
+    return (double)seed / 0x3FFFFFFFUL - 1.0;
+}
+
+
+/*
+ * bark_logs
+ *
+ * Description: Makes a noisy bark and takes its log spectrum. The bark is a
+ *              fundamental and its harmonics, falling off with frequency,
+ *              with the pitch, the level of each harmonic, and its phase
+ *              changing a little from bark to bark.
+ *
+ * Arguments:   logs  Filled in with the 'KEY_BINS' log magnitudes of the bark.
+ */
+static void bark_logs(unsigned char *logs)
+{
+    double amp[HARMONICS];
+    double phase[HARMONICS];
+    double total = 0;                   /* Sum of the harmonic levels. */
+    double f;                           /* Pitch of this bark. */
+    double x;
+    complex data[SAMPLE_POINTS];
+    char *samples = (char *)data;       /* Real samples, packed in pairs. */
+    unsigned int h;
+    unsigned int n;
+
+    f = BARK_F0 * (1.0 + 0.01 * uniform());
+    for (h = 0; h < HARMONICS; h++)
+    {
+        total += 1.0 / (h + 1);
+    }
+    for (h = 0; h < HARMONICS; h++)
+    {
+        amp[h] = BARK_AMP / (total * (h + 1)) * (1.0 + 0.2 * uniform());
+        phase[h] = M_PI * uniform();
+    }
+
+    for (n = 0; n < SAMPLE_SIZE; n++)
+    {
+        x = NOISE_AMP * uniform();
+        for (h = 0; h < HARMONICS; h++)
+        {
+            x += amp[h] * cos(2 * M_PI * f * (h + 1) * n / SAMPLE_SIZE +
+                              phase[h]);
+        }
+        samples[n] = (char)floor(x + 0.5);
+    }
+
+    fft_logs(data, rfft(data), logs);
+}
+
+
+/*
+ * check_matches
+ *
+ * Description: Matches new barks of the enrolled dog.
+ *
+ * Arguments:   when  What is being checked, for the messages.
+ *
+ * Returns:     Returns the number of failures.
+ */
+static unsigned int check_matches(const char *when)
+{
+    unsigned char logs[KEY_BINS];
+    unsigned int t;
+    unsigned int failures = 0;
+    unsigned char id;
+
+    for (t = 0; t < TRIALS; t++)
+    {
+        bark_logs(logs);
+        id = key_search(logs, NULL, KEY_BINS, 0);
+        if (id != TEST_DOG) {
+            printf("%s: bark %u matched %d rather than %d\n", when, t, id,
+                   TEST_DOG);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+
+int main(void)
+{
+    unsigned char logs[KEY_BINS];
+    unsigned int b;
+    unsigned int failures = 0;
+    unsigned char done = 0;
+
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    enroll_init();
+
+    enroll_rx('e');
+    enroll_rx('0' + TEST_DOG);
+    enroll_rx('\n');
+    enroll_poll();
+
+    for (b = 0; b < ENROLL_BARKS; b++)
+    {
+        bark_logs(logs);
+        done = enroll_add(logs);
+    }
+    if (!done || key_id(key_count() - ENROLL_SLOTS) != TEST_DOG) {
+        printf("dog %d was not enrolled\n", TEST_DOG);
+        return 1;
+    }
+
+    /* A threshold this small would not need the 16 bits. */
+    if (key_threshold(key_count() - ENROLL_SLOTS) <= 255) {
+        printf("threshold %u fits in 8 bits\n",
+               key_threshold(key_count() - ENROLL_SLOTS));
+        failures++;
+    }
+
+    failures += check_matches("enrolled");
+
+    /* The key has to come back the same after a reset. */
+    enroll_init();
+    failures += check_matches("reloaded");
+
+    printf("%u failures in %u barks\n", failures, 2 * TRIALS);
+    return failures != 0;
+}
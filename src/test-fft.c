@@ -1,13 +1,26 @@
 /*
  * test-fft.c
  *
- * This file contains code to run a simple test of the FFT. It will create a
- * couple of simple data sets, run the FFT on the sets, then print out the
- * magnitude response for each set. This magnitude response can then be examined
- * visually to verify the FFT.
+ * This file contains code to run a simple test of the FFT. It runs the FFT on
+ * the bark of each dog in the key table, then prints out the magnitude
+ * response for each one. This magnitude response can then be examined
+ * visually to verify the FFT. The output is the integer logs that the matcher
+ * takes, in the same order as the keys, so it can also be pasted into 'key.c'.
+ * If built with 'USE_PREPROCESS', the data is run through the front end first,
+ * which gives the keys for that front end. The first key is the first bark
+ * itself, so the program checks that the two are the same bin for bin, and
+ * that each bark matches its own dog; any mismatches are printed to stderr,
+ * and the program exits with a nonzero status if there were any.
  *
  * Revision History:
  *      04 Jun 2015     Brian Kubisiak      Initial revision.
+ *      16 Oct 2026     agent               Apply the FFT block exponent.
+ *      16 Oct 2026     agent               Use the real-input FFT.
+ *      16 Oct 2026     agent               Print the bins in natural order.
+ *      16 Oct 2026     agent               Run the data through the front end.
+ *      16 Oct 2026     agent               Added the second dog's bark.
+ *      16 Oct 2026     agent               Print the matcher's logs, and
+ *                                          check the barks against the keys.
  */
 
 #include <stdlib.h>
@@ -16,25 +29,55 @@
 
 #include "data.h"
 #include "fft.h"
+#include "key.h"
+#include "preprocess.h"
+
+
+/* Times the data is run through the front end, so that the DC level settles
+ * the way it does on the board after a few recordings. */
+#define SETTLE_PASSES   8
+
+/* Number of barks, one for each dog in 'key.c'. */
+#define NUM_BARKS       2
+
+/* The barks that the keys are made from, in the same order as the table. The
+ * first is a recorded bark; the second is a higher, sharper yip. Both have the
+ * bottom half of the wave cut off, like the microphone does. */
+static const char barks[NUM_BARKS][SAMPLE_SIZE] = {
+    {   97, 46,  0,  0,  0,  0, 44, 49, 13,  0, 20, 36, 23,  3,  0,  0,
+         5, 36,  8,  0,  0, 33, 58,  3,  0,  0,  3, 61, 67, 26,  0,  0,
+         0,  0, 26, 28, 15,  0,  0,  5, 18,  0,  0,  0,  3, 31,  8,  0,
+         0,  3, 56, 49,  0,  0,  0,  5, 51, 28,  8,  0,  0,  0,  3, 28 },
+    {   56, 85, 34,  0,  0, 29,102, 10,  1,  0,  2,111,  0,  0,  0,  0,
+       111,  1,  0,  0,  0,101, 11,  0,  0,  0, 84, 24,  0,  0,  0, 63,
+        35,  0,  0,  0, 43, 42,  0,  0,  0, 27, 44,  0,  0,  4, 16, 40,
+         0,  0, 12, 11, 33,  0,  0, 15, 10, 23,  0,  0, 15, 13, 14,  0 },
+};
 
 
 /*
  * main
  *
- * Description: This function creates an array of data with a known FFT, then
- *              calls the FFT function on the data. The magnitude of the data is
- *              then printed to stdout for checking the validity.
- *
- * Returns:     Returns 0 on successful completion, or -1 if an error occurs.
+ * Description: This function takes the FFT of each bark, then prints out the
+ *              log magnitude of each bin for checking the validity, with a
+ *              blank line between the barks. Each bark is then checked
+ *              against the keys.
  *
- * Notes:       Right now, this just tests a single dataset. This should be
- *              changed eventually. It is difficult to find good test sets since
- *              the resulting frequency data is not in the correct order.
+ * Returns:     Returns 0 on successful completion, or -1 if an error occurs or
+ *              a bark does not match its key.
  */
 int main(void)
 {
     complex *testdata;
+    unsigned char exponent;
+    unsigned char logs[KEY_BINS];   /* Log magnitude of each bin. */
+    int failures = 0;               /* Bins and barks that do not match. */
+    int dog;
     int i;
+#ifdef USE_PREPROCESS
+    char clean[SAMPLE_SIZE];
+    int pass;
+#endif
 
     /* Allocate a zeroed-out buffer, checking the allocation for failure. */
     testdata = (complex *)calloc(SAMPLE_SIZE, sizeof(complex));
@@ -43,86 +86,73 @@ int main(void)
         return -1;
     }
 
-    /* Set only a single data point to be nonzero. This is essentially taking
-     * the FFT of a delta function. */
-    testdata[0].real = 97;
-    testdata[1].real = 46;
-    testdata[2].real = 0;
-    testdata[3].real = 0;
-    testdata[4].real = 0;
-    testdata[5].real = 0;
-    testdata[6].real = 44;
-    testdata[7].real = 49;
-    testdata[8].real = 13;
-    testdata[9].real = 0;
-    testdata[10].real = 20;
-    testdata[11].real = 36;
-    testdata[12].real = 23;
-    testdata[13].real = 3;
-    testdata[14].real = 0;
-    testdata[15].real = 0;
-    testdata[16].real = 5;
-    testdata[17].real = 36;
-    testdata[18].real = 8;
-    testdata[19].real = 0;
-    testdata[20].real = 0;
-    testdata[21].real = 33;
-    testdata[22].real = 58;
-    testdata[23].real = 3;
-    testdata[24].real = 0;
-    testdata[25].real = 0;
-    testdata[26].real = 3;
-    testdata[27].real = 61;
-    testdata[28].real = 67;
-    testdata[29].real = 26;
-    testdata[30].real = 0;
-    testdata[31].real = 0;
-    testdata[32].real = 0;
-    testdata[33].real = 0;
-    testdata[34].real = 26;
-    testdata[35].real = 28;
-    testdata[36].real = 15;
-    testdata[37].real = 0;
-    testdata[38].real = 0;
-    testdata[39].real = 5;
-    testdata[40].real = 18;
-    testdata[41].real = 0;
-    testdata[42].real = 0;
-    testdata[43].real = 0;
-    testdata[44].real = 3;
-    testdata[45].real = 31;
-    testdata[46].real = 8;
-    testdata[47].real = 0;
-    testdata[48].real = 0;
-    testdata[49].real = 3;
-    testdata[50].real = 56;
-    testdata[51].real = 49;
-    testdata[52].real = 0;
-    testdata[53].real = 0;
-    testdata[54].real = 0;
-    testdata[55].real = 5;
-    testdata[56].real = 51;
-    testdata[57].real = 28;
-    testdata[58].real = 8;
-    testdata[59].real = 0;
-    testdata[60].real = 0;
-    testdata[61].real = 0;
-    testdata[62].real = 3;
-    testdata[63].real = 28;
-
-    /* Take the FFT of the data. */
-    fft(testdata);
-
-    /* Print out the magnitude of the result. */
-    for (i = 0; i < SAMPLE_SIZE; i++)
+    for (dog = 0; dog < NUM_BARKS; dog++)
     {
-        int mag = testdata[i].real * testdata[i].real
-                + testdata[i].imag * testdata[i].imag;
+        for (i = 0; i < SAMPLE_SIZE; i++)
+        {
+            testdata[i].real = barks[dog][i];
+            testdata[i].imag = 0;
+        }
+
+#ifdef USE_PREPROCESS
+        /* Clean up the samples the way the ADC interrupt does, keeping the
+         * last pass. The front end takes the samples as the ADC gives them,
+         * in offset binary and left-adjusted to 16 bits. */
+        preprocess_init();
+        for (pass = 0; pass < SETTLE_PASSES; pass++)
+        {
+            preprocess_start();
+            for (i = 0; i < SAMPLE_SIZE; i++)
+            {
+                clean[i] = preprocess_sample(
+                    (unsigned int)(testdata[i].real + 128) << 8) >> 8;
+            }
+        }
+        for (i = 0; i < SAMPLE_SIZE; i++)
+        {
+            testdata[i].real = clean[i];
+        }
+#endif
+
+        /* Pack the real samples two to a point for the real-input FFT. */
+        for (i = 0; i < SAMPLE_SIZE / 2; i++)
+        {
+            testdata[i].real = testdata[2*i].real;
+            testdata[i].imag = testdata[2*i + 1].real;
+        }
+
+        /* Take the FFT of the data, and the log magnitude of each bin, scaled
+         * by the block exponent, just as the matcher does. The logs are in
+         * the same order as the keys. */
+        exponent = rfft(testdata);
+        fft_logs(testdata, exponent, logs);
+
+        if (dog != 0) {
+            printf("\n");
+        }
+        for (i = 0; i < KEY_BINS; i++)
+        {
+            printf("%d\n", logs[i]);
+        }
 
-        printf("%d\n", (char)log10(mag));
+        /* The first key is this bark itself, so it has to match bin for bin;
+         * any other bark only has to match its own dog. */
+        for (i = 0; i < KEY_BINS && dog == 0; i++)
+        {
+            if (logs[i] != key_bin(dog, i)) {
+                fprintf(stderr, "bark %d bin %d is %d, but the key has %d\n",
+                        dog + 1, i, logs[i], key_bin(dog, i));
+                failures++;
+            }
+        }
+        if (key_search(logs, NULL, KEY_BINS, 0) != key_id(dog)) {
+            fprintf(stderr, "bark %d does not match dog %d\n", dog + 1,
+                    key_id(dog));
+            failures++;
+        }
     }
 
     free(testdata);
 
-    return 0;
+    return (failures == 0) ? 0 : -1;
 }
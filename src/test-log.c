@@ -0,0 +1,170 @@
+/*
+ * test-log.c
+ *
+ * This file contains a test of the integer logs used by the FFT matchers. It
+ * runs every 16-bit magnitude through 'ilog10' and 'ilog2_half' with each
+ * shift that the matchers can use, and checks that the results are the same
+ * as taking the logs with floating point. The Q15 matchers pass in 32-bit
+ * sums, so the rest of the 32-bit range is checked too: every magnitude next
+ * to a power of two, a power of ten, or the middle of an octave (where the
+ * results change), and a set of random magnitudes. Any mismatches are printed
+ * to stdout, and the program exits with a nonzero status if there were any.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Test 'ilog2_half' too.
+ *      16 Oct 2026     agent               Test 32-bit magnitudes.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "data.h"
+
+
+/* Range of shifts to test. The 8-bit FFTs use shifts of 0 and up, while the
+ * Q15 FFT can also use shifts down to -16. */
+#define MIN_SHIFT   -16
+#define MAX_SHIFT   40
+
+/* Largest magnitude to test every value up to. */
+#define MAX_MAG     0xFFFFUL
+
+/* Largest magnitude that the logs take. */
+#define MAX_MAG32   0xFFFFFFFFUL
+
+/* Number of random 32-bit magnitudes to test at each shift. */
+#define RANDOM_MAGS 100000
+
+/* Largest power of ten that is next to a tested magnitude. */
+#define MAX_POW10   22
+
+
+/*
+ * check
+ *
+ * Description: Compares 'ilog10' against the floating point log10, and
+ *              'ilog2_half' against twice the floating point log2, for one
+ *              magnitude and shift. The floating point log of values less
+ *              than 1 is clamped to 0, since the integer logs do not return
+ *              negative values, and log10 is clamped to 19 from 2^64 up.
+ *
+ * Arguments:   mag    The magnitude.
+ *              shift  The power of two to scale it by.
+ *
+ * Returns:     Returns the number of mismatches, 0 to 2.
+ */
+static unsigned long check(unsigned long mag, int shift)
+{
+    unsigned long errors = 0;
+    unsigned char got, want;
+    double val;
+
+    /* This is what the matcher used to compute, up to where 'ilog10' is
+     * clamped. */
+    val = ldexp(mag, shift);
+    want = (val < 1) ? 0 : (val >= ldexp(1, 64)) ? 19 : (char)log10(val);
+    got = ilog10(mag, shift);
+
+    if (got != want) {
+        printf("mag %lu shift %d: got %u, want %u\n", mag, shift, got, want);
+        errors++;
+    }
+
+    /* This is what the band matcher needs. */
+    want = (val < 1) ? 0 : (unsigned char)floor(2 * log2(val));
+    got = ilog2_half(mag, shift);
+
+    if (got != want) {
+        printf("mag %lu shift %d: got %u, want %u half octaves\n", mag, shift,
+               got, want);
+        errors++;
+    }
+
+    return errors;
+}
+
+
+/*
+ * check_near
+ *
+ * Description: Checks the magnitudes just below, at, and just above a value,
+ *              as long as they are in the 32-bit range.
+ *
+ * Arguments:   center  The value, which may have a fraction.
+ *              shift   The power of two to scale the magnitudes by.
+ *
+ * Returns:     Returns the number of mismatches.
+ */
+static unsigned long check_near(double center, int shift)
+{
+    unsigned long errors = 0;
+    double mag;
+
+    if (center > MAX_MAG32 + 1.0) {
+        return 0;
+    }
+
+    for (mag = floor(center) - 1; mag <= floor(center) + 1; mag++)
+    {
+        if (mag >= 0 && mag <= MAX_MAG32) {
+            errors += check((unsigned long)mag, shift);
+        }
+    }
+
+    return errors;
+}
+
+
+/*
+ * main
+ *
+ * Description: Checks every 16-bit magnitude, the magnitudes next to every
+ *              power of two, power of ten, and half octave, and a set of
+ *              random 32-bit magnitudes, at every shift in the tested range.
+ *
+ * Arguments:   None.
+ *
+ * Returns:     Returns 0 if every value matched, 1 otherwise.
+ */
+int main(void)
+{
+    unsigned long mag;
+    unsigned long errors = 0;
+    int shift;
+    int i;
+
+    srand(1);
+
+    for (shift = MIN_SHIFT; shift <= MAX_SHIFT; shift++)
+    {
+        for (mag = 0; mag <= MAX_MAG; mag++)
+        {
+            errors += check(mag, shift);
+        }
+
+        /* Where the results step up, over the whole 32-bit range. */
+        for (i = 0; i <= 32; i++)
+        {
+            errors += check_near(ldexp(1, i), shift);
+            errors += check_near(ldexp(M_SQRT2, i), shift);
+        }
+        for (i = 0; i <= MAX_POW10; i++)
+        {
+            errors += check_near(ldexp(pow(10, i), -shift), shift);
+        }
+
+        /* And everywhere else, with every number of leading zeros. */
+        for (i = 0; i < RANDOM_MAGS; i++)
+        {
+            mag = ((unsigned long)rand() << 16 ^ (unsigned long)rand()) &
+                  MAX_MAG32;
+            errors += check(mag >> (i % 32), shift);
+        }
+    }
+
+    printf("%lu mismatches\n", errors);
+
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * test-roots.c
+ *
+ * This file contains a test of the roots of unity that the compiler works out
+ * in 'roots.c'. It works out each root again at run time with floating point,
+ * putting them in the same modified bit-reversed order by looping over the
+ * bits, and checks that both the 8-bit and the Q15 tables match exactly. The
+ * table of bit-reversed positions is checked the same way, as is the window for
+ * the front end if built with 'USE_PREPROCESS'. Any mismatches are printed to
+ * stdout, and the program exits with a nonzero status if there were any.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Check the bit-reversal table.
+ *      16 Oct 2026     agent               Check the window.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "data.h"
+#include "progmem.h"
+
+
+/* The tables under test, from 'roots.c'. They are only in program memory on the
+ * board, so they can be read directly here. */
+extern const complex root[SAMPLE_SIZE] PROGMEM;
+extern const complex_q15 root_q15[SAMPLE_SIZE] PROGMEM;
+extern const bitrev_index bitrev[SAMPLE_SIZE] PROGMEM;
+#ifdef USE_PREPROCESS
+extern const unsigned char window[SAMPLE_SIZE] PROGMEM;
+#endif
+
+
+/*
+ * bitreverse
+ *
+ * Description: Reverses the order of the low bits of a number.
+ *
+ * Arguments:   x     The number to reverse.
+ *              bits  The number of low bits to reverse.
+ *
+ * Returns:     Returns the low 'bits' bits of 'x' in reverse order.
+ */
+static unsigned int bitreverse(unsigned int x, unsigned int bits)
+{
+    unsigned int out = 0;
+    unsigned int i;
+
+    for (i = 0; i < bits; i++)
+    {
+        out = (out << 1) | ((x >> i) & 1);
+    }
+
+    return out;
+}
+
+
+/*
+ * main
+ *
+ * Description: Compares every entry of 'root' and 'root_q15' against the root
+ *              worked out with floating point. The first half of the tables
+ *              holds the roots in bit-reversed order, and the second half holds
+ *              their negatives in the same order. Every entry of 'bitrev' is
+ *              checked against the position reversed over all of the bits,
+ *              and every weight of 'window' against the Hann (or Hamming)
+ *              window.
+ *
+ * Arguments:   None.
+ *
+ * Returns:     Returns 0 if every root matched, 1 otherwise.
+ */
+int main(void)
+{
+    unsigned int i;
+    unsigned int power;
+    unsigned long errors = 0;
+    double angle;
+    long real, imag;
+#ifdef USE_PREPROCESS
+    long weight;
+#endif
+
+    for (i = 0; i < SAMPLE_SIZE; i++)
+    {
+        if (bitrev[i] != bitreverse(i, LOG2_SAMPLE_SIZE)) {
+            printf("bitrev[%u]: got %u, want %u\n", i, (unsigned int)bitrev[i],
+                   bitreverse(i, LOG2_SAMPLE_SIZE));
+            errors++;
+        }
+
+        power = bitreverse(i % (SAMPLE_SIZE / 2), LOG2_SAMPLE_SIZE - 1);
+        if (i >= SAMPLE_SIZE / 2) {
+            power += SAMPLE_SIZE / 2;
+        }
+        angle = 2 * M_PI * power / SAMPLE_SIZE;
+
+        real = lround(127 * cos(angle));
+        imag = lround(127 * sin(angle));
+        if (root[i].real != real || root[i].imag != imag) {
+            printf("root[%u]: got %d%+di, want %ld%+ldi\n", i, root[i].real,
+                   root[i].imag, real, imag);
+            errors++;
+        }
+
+        real = lround(32767 * cos(angle));
+        imag = lround(32767 * sin(angle));
+        if (root_q15[i].real != real || root_q15[i].imag != imag) {
+            printf("root_q15[%u]: got %d%+di, want %ld%+ldi\n", i,
+                   root_q15[i].real, root_q15[i].imag, real, imag);
+            errors++;
+        }
+
+#ifdef USE_PREPROCESS
+#ifdef PREPROCESS_HAMMING
+        weight = lround(255 * (0.54 - 0.46 * cos(2 * M_PI * i / SAMPLE_SIZE)));
+#else
+        weight = lround(255 * (0.5 - 0.5 * cos(2 * M_PI * i / SAMPLE_SIZE)));
+#endif
+        if (window[i] != weight) {
+            printf("window[%u]: got %u, want %ld\n", i,
+                   (unsigned int)window[i], weight);
+            errors++;
+        }
+#endif
+    }
+
+    printf("%u roots: %lu mismatches\n", SAMPLE_SIZE, errors);
+
+    return (errors == 0) ? 0 : 1;
+}
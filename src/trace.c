@@ -0,0 +1,135 @@
+/*
+ * trace.c
+ *
+ * Timing trace of the hot paths of the dog bowl.
+ *
+ * This file contains the ring that the trace probes write into, and the code
+ * for dumping it over the UART. The probes themselves are macros in 'trace.h',
+ * so that they cost as little as possible. Nothing in here is built without
+ * 'USE_TRACE'.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Report the stack peak.
+ *      16 Oct 2026     agent               Dump a line at a time.
+ */
+
+#include "hal.h"
+#include "trace.h"
+
+#ifdef USE_TRACE
+
+#if (TRACE_SIZE & (TRACE_SIZE - 1)) != 0 || TRACE_SIZE > 256
+#error "TRACE_SIZE must be a power of two, up to 256"
+#endif
+
+trace_entry trace_ring[TRACE_SIZE];
+unsigned char trace_pos = 0;
+
+
+/*
+ * put_hex
+ *
+ * Description: Writes a number over the UART in hexadecimal.
+ *
+ * Arguments:   value   The number to write.
+ *              digits  The number of digits to write.
+ */
+static void put_hex(unsigned long value, unsigned char digits)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    while (digits > 0)
+    {
+        digits--;
+        hal_uart_putc(hex[(value >> (4 * digits)) & 0x0F]);
+    }
+}
+
+
+/*
+ * trace_init
+ *
+ * Description: Starts the timer and the UART, and empties the trace.
+ */
+void trace_init(void)
+{
+    unsigned int i;
+
+    hal_trace_init();
+    hal_uart_init();
+
+    for (i = 0; i < TRACE_SIZE; i++)
+    {
+        trace_ring[i].event = TRACE_NONE;
+    }
+    trace_pos = 0;
+}
+
+
+/*
+ * trace_dump
+ *
+ * Description: Writes out the next line of the trace over the UART, oldest
+ *              event first, emptying its slot. Each event is written as a line
+ *              with the event code, the timestamp, and the time since the
+ *              event before it, all in hexadecimal. Once the events run out,
+ *              one more line is written with 'sp' and the most stack used
+ *              since reset, in hexadecimal bytes, to check the SRAM plan by.
+ *
+ * Returns:     Returns nonzero if a line was written, or zero if there was
+ *              nothing left to write.
+ *
+ * Notes:       This waits for each character of the line to be sent, which is
+ *              about 1.2 ms for the longest line at 115200 baud, so the trace
+ *              is written a line at a time while the main loop is idle. The
+ *              oldest event in the ring is the one in the slot that would be
+ *              written next.
+ */
+unsigned char trace_dump(void)
+{
+    static trace_time last;         /* Time of the last event written. */
+    static unsigned char written = 0;   /* Events written since 'sp'. */
+    unsigned int i;
+    unsigned char slot = trace_pos;
+
+    for (i = 0; i < TRACE_SIZE; i++)
+    {
+        if (trace_ring[slot].event != TRACE_NONE)
+        {
+            put_hex(trace_ring[slot].event, 2);
+            hal_uart_putc(' ');
+            put_hex(trace_ring[slot].time, 2 * sizeof(trace_time));
+            hal_uart_putc(' ');
+
+            /* The timer wraps, so take the difference in its own width. */
+            put_hex(written ? (trace_time)(trace_ring[slot].time - last) : 0,
+                    2 * sizeof(trace_time));
+            hal_uart_putc('\r');
+            hal_uart_putc('\n');
+
+            last = trace_ring[slot].time;
+            written = 1;
+            trace_ring[slot].event = TRACE_NONE;
+            return 1;
+        }
+
+        slot = (slot + 1) & (TRACE_SIZE - 1);
+    }
+
+    /* Finish off the events that were written with the stack peak. */
+    if (written) {
+        hal_uart_putc('s');
+        hal_uart_putc('p');
+        hal_uart_putc(' ');
+        put_hex(hal_stack_peak(), 2 * sizeof(unsigned int));
+        hal_uart_putc('\r');
+        hal_uart_putc('\n');
+        written = 0;
+        return 1;
+    }
+
+    return 0;
+}
+
+#endif
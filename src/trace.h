@@ -0,0 +1,127 @@
+/*
+ * trace.h
+ *
+ * Timing trace of the hot paths of the dog bowl.
+ *
+ * This file contains macros for recording when the main loop reaches certain
+ * points, such as the start and end of the FFT and the matcher, or a change of
+ * state. Each probe writes an event code and a timestamp into a ring in RAM,
+ * which holds the last 'TRACE_SIZE' events. The ring can be dumped over the
+ * UART with 'TRACE_DUMP'.
+ *
+ * On the board, the timestamp is Timer5, which counts clock cycles (see
+ * 'TRACE_PRESCALE'), so a probe only takes a few cycles: a read of the timer
+ * and two stores. On the host, it is a monotonic clock in nanoseconds. Either
+ * way, the timestamps wrap around, so only the differences between nearby
+ * events mean anything; on the board at 16 MHz, Timer5 wraps every 4 ms.
+ *
+ * The main loop dumps the trace a line at a time, and only while the ADC has
+ * no recording waiting or on the way (see 'adc_idle'), so that the trace does
+ * not hold up the analysis of a recording by more than a line.
+ *
+ * The trace is only built in with 'USE_TRACE'. Without it, all of the macros
+ * compile to nothing.
+ *
+ * Revision History:
+ *      16 Oct 2026     agent               Initial revision.
+ *      16 Oct 2026     agent               Report the stack peak.
+ *      16 Oct 2026     agent               Dump a line at a time.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+
+#include "hal.h"
+
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE          64      /* Events kept; must be a power of two. */
+#endif
+
+/* Event codes. A change of state is recorded as 'TRACE_STATE' plus the number
+ * of the new state. */
+#define TRACE_NONE          0x00    /* Empty slot in the ring. */
+#define TRACE_FFT_BEGIN     0x01    /* Starting the FFT. */
+#define TRACE_FFT_END       0x02    /* Done with the FFT. */
+#define TRACE_MATCH_BEGIN   0x03    /* Starting to match against the keys. */
+#define TRACE_MATCH_END     0x04    /* Done matching. */
+#define TRACE_STATE         0x10    /* Entered a new state of the main loop. */
+
+
+#ifdef USE_TRACE
+
+/*
+ * trace_entry
+ *
+ * Description: Data type for one event in the trace.
+ *
+ * Members:     time   The timer value when the event happened.
+ *              event  The event code, or 'TRACE_NONE' for an empty slot.
+ */
+typedef struct _trace_entry {
+    trace_time time;
+    unsigned char event;
+} trace_entry;
+
+
+extern trace_entry trace_ring[TRACE_SIZE];  /* The last events. */
+extern unsigned char trace_pos;             /* Slot for the next event. */
+
+
+/*
+ * TRACE
+ *
+ * Description: Records an event in the trace, along with the time.
+ *
+ * Arguments:   ev  The event code.
+ *
+ * Notes:       This is not safe to use from interrupts, since it would collide
+ *              with a probe in the main loop.
+ */
+#define TRACE(ev)                                                           \
+    do {                                                                    \
+        trace_ring[trace_pos].time = HAL_TRACE_TIME();                      \
+        trace_ring[trace_pos].event = (ev);                                 \
+        trace_pos = (trace_pos + 1) & (TRACE_SIZE - 1);                     \
+    } while (0)
+
+#define TRACE_INIT()        trace_init()
+#define TRACE_DUMP()        trace_dump()
+
+
+/*
+ * trace_init
+ *
+ * Description: Starts the timer and the UART, and empties the trace.
+ */
+void trace_init(void);
+
+/*
+ * trace_dump
+ *
+ * Description: Writes out the next line of the trace over the UART, oldest
+ *              event first, emptying its slot. Each event is written as a line
+ *              with the event code, the timestamp, and the time since the
+ *              event before it, all in hexadecimal. Once the events run out,
+ *              one more line is written with 'sp' and the most stack used
+ *              since reset (see 'hal_stack_peak').
+ *
+ * Returns:     Returns nonzero if a line was written, or zero if there was
+ *              nothing left to write.
+ *
+ * Notes:       This waits for each character of the line to be sent, so it
+ *              should only be called when there is time to spare.
+ */
+unsigned char trace_dump(void);
+
+#else
+
+#define TRACE(ev)
+#define TRACE_INIT()
+#define TRACE_DUMP()        0
+
+#endif
+
+
+#endif /* end of include guard: _TRACE_H_ */